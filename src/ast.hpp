@@ -0,0 +1,792 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+#include "evaluator.hpp"
+#include "function.hpp"
+#include "helpers.hpp"
+#include "lexer.hpp"
+#include "interpolation.hpp"
+#include "statement.hpp"
+
+/**
+ * @brief One variable, as the resolver sees it: a declaration, which every reference to the
+ * variable points to. Scopes follow the engine: top-level code runs at depth 0, a function's
+ * parameters and body at depth 1, and every if block one deeper than the code around it. A
+ * variable is visible from its declaration to the end of the block it's declared in; functions
+ * also see every global.
+ */
+struct Binding {
+    enum class Kind {
+        Global,     // Declared at depth 0
+        Local,      // Declared inside a block or a function
+        Parameter,  // A function's parameter
+        Element,    // x, or a column name, in the condition of a filter() pipe stage
+        Column      // A field of a CSV record, declared from the file's header by a 'read' without 'into'
+    };
+
+    std::string name;
+    Kind kind = Kind::Global;
+    int depth = 0;  // Scope depth of the declaration
+    int line = 0;  // Line of the declaration (the func line for parameters, the read line for columns)
+    int slot = -1;  // Index among the variables of its function, or of the top-level code; -1 for elements
+    const Function* function = nullptr;  // The function it belongs to; nullptr for top-level code
+    ValueType type = ValueType::Unknown;  // Of every value it's given (see TypeInference)
+};
+
+/**
+ * @brief An expression node. Operands, arguments and elements are its children, in source order.
+ * Pipe: the piped value, then one Call or Filter per stage (the value is the stage's implicit first argument).
+ * Interpolation: one child per ${} expression; 'text' is the literal's body, as Program::findInterpolation() takes it.
+ */
+struct Expr {
+    enum class Kind { Literal, Interpolation, Input, Variable, FunctionRef, Unary, Binary, Call, Index, Array, Pipe, Filter, Error };
+
+    Kind kind = Kind::Error;
+    std::string text;  // Variable or callee name, operator, interpolation body or error message
+    EvalResult value;  // Literal
+    std::vector<std::unique_ptr<Expr>> children;
+    const Binding* binding = nullptr;  // Variable: nullptr if no declaration is visible
+    const Function* function = nullptr;  // Call or FunctionRef of a script function; a call without one is a host call
+    ValueType type = ValueType::Unknown;  // Of its value (see TypeInference)
+
+    Expr(Kind kind, std::string text) : kind(kind), text(std::move(text)) {}
+};
+
+// One statement; 'statement' is the compiled line, with its kind, text and flags
+struct Stmt {
+    const Statement* statement = nullptr;
+    int line = 0;
+    int depth = 0;  // Scope depth the statement runs at
+
+    // The variables it declares or writes: var/assign: the target; csv: the reader;
+    // read: the reader, then the fields; select: the index, then the value
+    std::vector<const Binding*> targets;
+
+    // var/assign: the value (the call, for spawn); send: the channel, then the value;
+    // select: the channels, then the timeout (when statement->args[3] isn't empty)
+    std::vector<std::unique_ptr<Expr>> exprs;
+
+    std::vector<Stmt> body;  // If: the block, one deeper
+    int function = -1;  // FunctionDef: index in SyntaxTree::functions
+    bool typed = false;  // It runs as typed code (see TypedCode)
+
+    StatementKind kind() const { return statement->kind; }
+};
+
+// A function definition: its parameters and body, resolved on their own
+struct FunctionNode {
+    const Function* function = nullptr;  // nullptr for a repeated definition, which is never called
+    std::string name;
+    int line = 0;
+    std::vector<const Binding*> parameters;
+    std::vector<Stmt> body;
+    int slotCount = 0;  // Parameters and locals
+};
+
+/**
+ * @brief The syntax tree of a Program, built once it's compiled.
+ * Lines become statements, nested by their blocks; comments, empty lines and STYLE lines are
+ * left out. GOTO still jumps by line, so statements keep theirs. The engine runs the compiled
+ * lines; the tree is for the passes that analyze and compile them.
+ */
+class SyntaxTree {
+public:
+    std::vector<Stmt> body;  // Top-level code; a FunctionDef only refers to its FunctionNode
+    std::vector<FunctionNode> functions;
+    int slotCount = 0;  // Variables of the top-level code, globals and block locals
+
+    static std::unique_ptr<SyntaxTree> build(const std::vector<Statement>& statements,
+                                             const std::map<std::string, Function>& functions);
+
+    // Prints the tree, one node per line, children indented
+    void dump(std::ostream& out) const;
+
+    // Every binding, in the order they were declared
+    const std::deque<Binding>& bindings() const { return allBindings; }
+
+private:
+    friend class SyntaxTreeBuilder;
+    friend class TypeInference;
+    std::deque<Binding> allBindings;  // A deque, so bindings never move
+
+    void dumpStatement(std::ostream& out, const Stmt& stmt, int indent) const;
+    static void dumpExpression(std::ostream& out, const Expr& expr, int indent);
+    static std::string describe(const Binding* binding);
+};
+
+/**
+ * @brief Parses one expression, as the engine evaluates it: the Evaluator's operators and
+ * precedences, with calls, indexing, array literals, interpolated strings, input and pipes.
+ * A syntax error makes the whole expression one Error node.
+ */
+class ExpressionParser {
+public:
+    static std::unique_ptr<Expr> parse(std::string_view text) {
+        ExpressionParser parser(text);
+        try {
+            std::unique_ptr<Expr> expr = parser.parsePipe();
+            Token rest = parser.lexer.next();
+            if (rest.kind != Token::Kind::End) {
+                throw std::runtime_error("Syntax Error: Unexpected '" + std::string(parser.lexer.text(rest)) + "'");
+            }
+            return expr;
+        } catch (const std::exception& e) {
+            return std::make_unique<Expr>(Expr::Kind::Error, e.what());
+        }
+    }
+
+private:
+    std::string_view source;
+    Lexer lexer;
+
+    explicit ExpressionParser(std::string_view text) : source(text), lexer(text) {}
+
+    static int precedence(std::string_view op) {
+        if (op == "||") return 1;
+        if (op == "&&") return 2;
+        if (op == "==" || op == "!=") return 3;
+        if (op == "<" || op == ">" || op == "<=" || op == ">=") return 4;
+        if (op == "+" || op == "-") return 5;
+        if (op == "*" || op == "/" || op == "%") return 6;
+        return 0;
+    }
+
+    // The binary operator that comes next, without consuming it; empty if there's none
+    std::string_view peekOperator() const {
+        Lexer copy = lexer;
+        Token first = copy.next();
+        if (first.kind != Token::Kind::Symbol) {
+            return {};
+        }
+        Token second = copy.next();
+        char c = source[first.offset];
+        char d = second.kind == Token::Kind::Symbol && !second.spaceBefore ? source[second.offset] : 0;
+        if ((d == '=' && std::strchr("=!<>", c) != nullptr) || (c == '&' && d == '&') || (c == '|' && d == '|')) {
+            return source.substr(first.offset, 2);
+        }
+        if (c == '-' && d == '>') {
+            return {};  // A pipe
+        }
+        return std::strchr("+-*/%<>", c) != nullptr ? source.substr(first.offset, 1) : std::string_view();
+    }
+
+    bool atPipe() const {
+        Lexer copy = lexer;
+        Token first = copy.next();
+        Token second = copy.next();
+        return copy.isSymbol(first, '-') && copy.isSymbol(second, '>') && !second.spaceBefore;
+    }
+
+    void expect(char symbol) {
+        if (!lexer.accept(symbol)) {
+            throw std::runtime_error(std::string("Syntax Error: Expected '") + symbol + "'");
+        }
+    }
+
+    // value -> stage -> stage ...
+    std::unique_ptr<Expr> parsePipe() {
+        std::unique_ptr<Expr> value = parseBinary(1);
+        if (!atPipe()) {
+            return value;
+        }
+        auto pipe = std::make_unique<Expr>(Expr::Kind::Pipe, "->");
+        pipe->children.push_back(std::move(value));
+        while (atPipe()) {
+            lexer.next();
+            lexer.next();
+            Token name = lexer.next();
+            if (name.kind != Token::Kind::Word) {
+                throw std::runtime_error("Syntax Error: Expected a function name after '->'");
+            }
+            std::string stageName(lexer.text(name));
+            bool isFilter = stageName == "filter" || stageName == "where";
+            auto stage = std::make_unique<Expr>(isFilter ? Expr::Kind::Filter : Expr::Kind::Call, stageName);
+            if (lexer.accept('(')) {
+                parseList(')', stage->children);
+            }
+            pipe->children.push_back(std::move(stage));
+        }
+        return pipe;
+    }
+
+    // Operators of at least 'minimum' precedence, all left-associative
+    std::unique_ptr<Expr> parseBinary(int minimum) {
+        std::unique_ptr<Expr> lhs = parseUnary();
+        for (std::string_view op = peekOperator(); !op.empty() && precedence(op) >= minimum; op = peekOperator()) {
+            lexer.next();
+            if (op.length() == 2) lexer.next();
+            auto binary = std::make_unique<Expr>(Expr::Kind::Binary, std::string(op));
+            binary->children.push_back(std::move(lhs));
+            binary->children.push_back(parseBinary(precedence(op) + 1));
+            lhs = std::move(binary);
+        }
+        return lhs;
+    }
+
+    // ! binds tighter than any binary operator. A sign right before a number is part of it.
+    std::unique_ptr<Expr> parseUnary() {
+        Token token = lexer.peek();
+        if (lexer.isSymbol(token, '!') && peekOperator().empty()) {
+            lexer.next();
+            auto unary = std::make_unique<Expr>(Expr::Kind::Unary, "!");
+            unary->children.push_back(parseUnary());
+            return unary;
+        }
+        if (lexer.isSymbol(token, '-') || lexer.isSymbol(token, '+')) {
+            lexer.next();
+            Token number = lexer.peek();
+            if (number.kind == Token::Kind::Number && !number.spaceBefore) {
+                lexer.next();
+                return parsePostfix(numberLiteral(source.substr(token.offset, number.offset + number.length - token.offset)));
+            }
+            auto unary = std::make_unique<Expr>(Expr::Kind::Unary, std::string(1, source[token.offset]));
+            unary->children.push_back(parseUnary());
+            return unary;
+        }
+        return parsePostfix(parsePrimary());
+    }
+
+    // Indexing: a[i], a[i][j]
+    std::unique_ptr<Expr> parsePostfix(std::unique_ptr<Expr> expr) {
+        while (lexer.accept('[')) {
+            auto index = std::make_unique<Expr>(Expr::Kind::Index, "[]");
+            index->children.push_back(std::move(expr));
+            index->children.push_back(parsePipe());
+            expect(']');
+            expr = std::move(index);
+        }
+        return expr;
+    }
+
+    std::unique_ptr<Expr> parsePrimary() {
+        Token token = lexer.next();
+        std::string_view text = lexer.text(token);
+        switch (token.kind) {
+        case Token::Kind::Number:
+            return numberLiteral(text);
+        case Token::Kind::String:
+            return stringLiteral(text);
+        case Token::Kind::Word: {
+            if (token.keyword == Keyword::True || token.keyword == Keyword::False) {
+                auto literal = std::make_unique<Expr>(Expr::Kind::Literal, std::string(text));
+                literal->value = EvalResult::fromBool(token.keyword == Keyword::True);
+                return literal;
+            }
+            if (token.keyword == Keyword::Input) {
+                return std::make_unique<Expr>(Expr::Kind::Input, "input");
+            }
+            if (token.keyword != Keyword::None && !(token.keyword == Keyword::Select && lexer.isSymbol(lexer.peek(), '('))) {
+                throw std::runtime_error("Syntax Error: Unexpected keyword '" + std::string(text) + "'");
+            }
+            if (lexer.accept('(')) {
+                auto call = std::make_unique<Expr>(Expr::Kind::Call, std::string(text));
+                parseList(')', call->children);
+                return call;
+            }
+            return std::make_unique<Expr>(Expr::Kind::Variable, std::string(text));
+        }
+        case Token::Kind::Symbol:
+            if (text == "(") {
+                std::unique_ptr<Expr> inner = parseBinary(1);
+                expect(')');
+                return inner;
+            }
+            if (text == "[") {
+                auto array = std::make_unique<Expr>(Expr::Kind::Array, "[]");
+                parseList(']', array->children);
+                return array;
+            }
+            throw std::runtime_error("Syntax Error: Unexpected '" + std::string(text) + "'");
+        case Token::Kind::End:
+            break;
+        }
+        throw std::runtime_error("Syntax Error: Expected a value");
+    }
+
+    // Comma-separated expressions up to 'close'; the opening bracket was consumed
+    void parseList(char close, std::vector<std::unique_ptr<Expr>>& items) {
+        if (lexer.accept(close)) {
+            return;
+        }
+        do {
+            items.push_back(parsePipe());
+        } while (lexer.accept(','));
+        expect(close);
+    }
+
+    static std::unique_ptr<Expr> numberLiteral(std::string_view text) {
+        size_t dots = std::count(text.begin(), text.end(), '.');
+        std::string digits(text);
+        if (dots > 1 || digits.find_first_of("0123456789") == std::string::npos) {
+            throw std::runtime_error("Syntax Error: Invalid number '" + digits + "'");
+        }
+        auto literal = std::make_unique<Expr>(Expr::Kind::Literal, digits);
+        literal->value = EvalResult(digits, dots == 0 ? "int" : "float");
+        return literal;
+    }
+
+    // A string token, with its quotes. Interpolations are parsed into one child per expression.
+    static std::unique_ptr<Expr> stringLiteral(std::string_view text) {
+        if (findStringEnd(text, 0) != text.length() - 1) {
+            throw std::runtime_error("Syntax Error: Unterminated string");
+        }
+        std::string_view body = text.substr(1, text.length() - 2);
+        if (body.find("${") == std::string_view::npos) {
+            auto literal = std::make_unique<Expr>(Expr::Kind::Literal, std::string(text));
+            literal->value = EvalResult::fromString(unescapedLiteral(body));
+            return literal;
+        }
+        InterpolationTemplate interpolation = parseInterpolation(body);
+        if (!interpolation.error.empty()) {
+            throw std::runtime_error(interpolation.error);
+        }
+        auto expr = std::make_unique<Expr>(Expr::Kind::Interpolation, std::string(body));
+        for (const InterpolationTemplate::Segment& segment : interpolation.segments) {
+            if (segment.isExpression) {
+                expr->children.push_back(parse(segment.text));
+            }
+        }
+        return expr;
+    }
+};
+
+/**
+ * @brief Builds a SyntaxTree from compiled statements, resolving names as it goes.
+ * Top-level code is resolved first, in line order; then every function body, against its
+ * parameters, its own locals and all the globals, since a function may run after any of them
+ * is declared. A 'var' of a name that is already visible binds to that variable, like the
+ * engine does.
+ */
+class SyntaxTreeBuilder {
+public:
+    SyntaxTreeBuilder(SyntaxTree& tree, const std::vector<Statement>& statements, const std::map<std::string, Function>& functions)
+        : tree(tree), statements(statements), functions(functions) {}
+
+    void build() {
+        int last = static_cast<int>(statements.size()) - 1;  // The padding line
+        tree.body = buildBlock(1, last);
+        topLevelSlots = slots;
+
+        for (const Binding& binding : tree.allBindings) {
+            if (binding.depth == 0) globals.emplace(binding.name, &binding);
+        }
+        globalColumnRead = columnReads.empty() || columnReads[0].first > 0 ? 0 : columnReads[0].second;
+
+        // Function bodies may define more functions, which are added to the end
+        for (size_t i = 0; i < pendingFunctions.size(); ++i) {
+            FunctionNode node = buildFunction(pendingFunctions[i]);
+            tree.functions[i] = std::move(node);
+        }
+        tree.slotCount = topLevelSlots;
+    }
+
+private:
+    SyntaxTree& tree;
+    const std::vector<Statement>& statements;
+    const std::map<std::string, Function>& functions;
+
+    std::map<std::string, const Binding*> scope;  // The visible variables (a function's own, in a function)
+    std::vector<const Binding*> declared;  // Those in 'scope', in the order they were declared
+    std::map<std::string, const Binding*> globals;  // Every global; functions see them after their own variables
+    bool inFunction = false;
+    std::vector<std::pair<int, int>> columnReads;  // Depth and line of every 'read' without 'into' in scope
+    int globalColumnRead = 0;  // Line of the first such 'read' at depth 0, which functions see too
+    int topLevelSlots = 0;
+    std::map<std::string, const Binding*>* elements = nullptr;  // Set while resolving a filter condition
+    int depth = 0;
+    int limit = 0;  // End of the block being built; a block that closes past it is left open
+    int slots = 0;  // Variables of the function (or top-level code) so far
+    const Function* function = nullptr;
+    std::vector<int> pendingFunctions;  // Lines of the FunctionDefs, by index in tree.functions
+
+    // The statements of lines [first, end) at the current depth
+    std::vector<Stmt> buildBlock(int first, int end) {
+        int outerLimit = limit;
+        limit = end;
+        std::vector<Stmt> block;
+        int line = first;
+        while (line < end) {
+            const Statement& statement = statements[line];
+            int next = line + 1;
+            switch (statement.kind) {
+            case StatementKind::Empty:
+            case StatementKind::Comment:
+            case StatementKind::Style:
+                break;
+            default:
+                block.push_back(buildStatement(line));
+                if ((statement.kind == StatementKind::If || statement.kind == StatementKind::FunctionDef)
+                    && isClosed(statement, line)) {
+                    next = statement.blockEnd + 1;
+                }
+                break;
+            }
+            line = next;
+        }
+        limit = outerLimit;
+        return block;
+    }
+
+    bool isClosed(const Statement& statement, int line) const {
+        return statement.blockEnd > line && statement.blockEnd < limit;
+    }
+
+    Stmt buildStatement(int line) {
+        const Statement& statement = statements[line];
+        Stmt stmt;
+        stmt.statement = &statement;
+        stmt.line = line;
+        stmt.depth = depth;
+
+        switch (statement.kind) {
+        case StatementKind::ReturnValue:
+        case StatementKind::Print:
+        case StatementKind::Println:
+        case StatementKind::Exec:
+        case StatementKind::Snapshot:
+        case StatementKind::Await:
+        case StatementKind::Sleep:
+        case StatementKind::Recv:
+        case StatementKind::Close:
+            stmt.exprs.push_back(expression(statement.args[0]));
+            break;
+        case StatementKind::Send:
+            stmt.exprs.push_back(expression(statement.args[0]));
+            stmt.exprs.push_back(expression(statement.args[1]));
+            break;
+        case StatementKind::If: {
+            stmt.exprs.push_back(expression(statement.args[0]));
+            if (isClosed(statement, line)) {
+                size_t mark = declared.size();
+                depth++;
+                stmt.body = buildBlock(line + 1, statement.blockEnd);
+                depth--;
+                // The block's variables go out of scope; columns of an earlier read may have been found in it
+                size_t kept = mark;
+                for (size_t i = mark; i < declared.size(); ++i) {
+                    if (declared[i]->depth > depth) scope.erase(declared[i]->name);
+                    else declared[kept++] = declared[i];
+                }
+                declared.resize(kept);
+                while (!columnReads.empty() && columnReads.back().first > depth) {
+                    columnReads.pop_back();
+                }
+            }
+            break;
+        }
+        case StatementKind::FunctionDef:
+            stmt.function = static_cast<int>(tree.functions.size());
+            tree.functions.emplace_back();
+            pendingFunctions.push_back(line);
+            break;
+        case StatementKind::Declaration:
+            // The engine declares the variable before evaluating its value
+            stmt.targets.push_back(declare(statement.args[0], line));
+            stmt.exprs.push_back(value(statement));
+            break;
+        case StatementKind::Assignment:
+            stmt.targets.push_back(find(statement.args[0]));
+            stmt.exprs.push_back(value(statement));
+            break;
+        case StatementKind::Spawn:
+        case StatementKind::Call:
+            stmt.exprs.push_back(call(statement));
+            break;
+        case StatementKind::CsvOpen:
+            stmt.exprs.push_back(expression(statement.args[1]));
+            stmt.targets.push_back(declare(statement.args[0], line));
+            break;
+        case StatementKind::CsvRead:
+            stmt.targets.push_back(declare(statement.args[0], line));
+            for (const std::string& field : splitAndTrimArgs(statement.args[1])) {
+                stmt.targets.push_back(declare(field, line));
+            }
+            if (statement.args[1].empty()) {
+                columnReads.emplace_back(depth, line);
+            }
+            break;
+        case StatementKind::Select:
+            for (const std::string& channel : splitAndTrimArgs(statement.args[2])) {
+                stmt.exprs.push_back(expression(channel));
+            }
+            if (!statement.args[3].empty()) {
+                stmt.exprs.push_back(expression(statement.args[3]));
+            }
+            stmt.targets.push_back(declare(statement.args[0], line));
+            stmt.targets.push_back(declare(statement.args[1], line));
+            break;
+        default:
+            break;
+        }
+        return stmt;
+    }
+
+    FunctionNode buildFunction(int line) {
+        const Statement& statement = statements[line];
+        FunctionNode node;
+        const Function* func = &functions.at(statement.args[0]);
+        node.function = func->startingLine == line ? func : nullptr;
+        node.name = statement.args[0];
+        node.line = line;
+
+        scope.clear();
+        declared.clear();
+        columnReads.clear();
+        inFunction = true;
+        depth = 1;
+        slots = 0;
+        function = node.function;
+        for (const std::string& name : func->parameters) {
+            node.parameters.push_back(addBinding(name, Binding::Kind::Parameter, line));
+        }
+        limit = static_cast<int>(statements.size()) - 1;
+        if (isClosed(statement, line)) {
+            node.body = buildBlock(line + 1, statement.blockEnd);
+        }
+        node.slotCount = slots;
+        function = nullptr;
+        return node;
+    }
+
+    const Binding* addBinding(const std::string& name, Binding::Kind kind, int line) {
+        return addBinding(name, kind, line, depth);
+    }
+
+    const Binding* addBinding(const std::string& name, Binding::Kind kind, int line, int atDepth) {
+        tree.allBindings.push_back(Binding{ name, kind, atDepth, line, slots++, function });
+        const Binding* binding = &tree.allBindings.back();
+        scope[name] = binding;
+        declared.push_back(binding);
+        return binding;
+    }
+
+    // A new variable at the current depth, or the visible one of that name
+    const Binding* declare(const std::string& name, int line) {
+        if (const Binding* existing = lookup(name)) {
+            return existing;
+        }
+        return addBinding(name, depth == 0 ? Binding::Kind::Global : Binding::Kind::Local, line);
+    }
+
+    const Binding* lookup(const std::string& name) const {
+        auto it = scope.find(name);
+        if (it != scope.end()) {
+            return it->second;
+        }
+        if (inFunction && (it = globals.find(name)) != globals.end()) {
+            return it->second;
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief lookup(), or else a column of the nearest 'read' without 'into' still in scope,
+     * whose header may declare any name. A function also sees those of the top-level code.
+     */
+    const Binding* find(const std::string& name) {
+        if (const Binding* binding = lookup(name)) {
+            return binding;
+        }
+        if (!columnReads.empty()) {
+            return addBinding(name, Binding::Kind::Column, columnReads.back().second, columnReads.back().first);
+        }
+        if (inFunction && globalColumnRead > 0) {
+            tree.allBindings.push_back(Binding{ name, Binding::Kind::Column, 0, globalColumnRead, topLevelSlots++, nullptr });
+            return globals[name] = &tree.allBindings.back();
+        }
+        return nullptr;
+    }
+
+    std::unique_ptr<Expr> expression(const std::string& text) {
+        std::unique_ptr<Expr> expr = ExpressionParser::parse(text);
+        resolve(*expr);
+        return expr;
+    }
+
+    // The value of a declaration or assignment (the call itself for spawn)
+    std::unique_ptr<Expr> value(const Statement& statement) {
+        return statement.isSpawn ? call(statement) : expression(statement.args[1]);
+    }
+
+    // The call of a Call or Spawn statement, from its already split callee and arguments
+    std::unique_ptr<Expr> call(const Statement& statement) {
+        auto expr = std::make_unique<Expr>(Expr::Kind::Call, statement.callee);
+        for (const std::string& arg : statement.callArgs) {
+            expr->children.push_back(ExpressionParser::parse(arg));
+        }
+        resolve(*expr);
+        return expr;
+    }
+
+    const Function* findFunction(const std::string& name) const {
+        auto it = functions.find(name);
+        return it == functions.end() ? nullptr : &it->second;
+    }
+
+    void resolve(Expr& expr) {
+        switch (expr.kind) {
+        case Expr::Kind::Variable:
+            if (elements != nullptr && (expr.text == "x" || lookup(expr.text) == nullptr)) {
+                expr.binding = element(expr.text);
+            } else if ((expr.function = findFunction(expr.text)) != nullptr && lookup(expr.text) == nullptr) {
+                expr.kind = Expr::Kind::FunctionRef;
+            } else {
+                expr.function = nullptr;
+                expr.binding = find(expr.text);
+            }
+            return;
+        case Expr::Kind::Call:
+            expr.function = findFunction(expr.text);
+            break;
+        case Expr::Kind::Pipe:
+            // Stages are only native or built-in functions, or filters
+            resolve(*expr.children[0]);
+            for (size_t i = 1; i < expr.children.size(); ++i) {
+                Expr& stage = *expr.children[i];
+                if (stage.kind == Expr::Kind::Filter && findFunction(stage.text) == nullptr) {
+                    std::map<std::string, const Binding*> names;
+                    elements = &names;
+                    for (auto& condition : stage.children) resolve(*condition);
+                    elements = nullptr;
+                } else {
+                    stage.kind = Expr::Kind::Call;
+                    for (auto& arg : stage.children) resolve(*arg);
+                }
+            }
+            return;
+        default:
+            break;
+        }
+        for (auto& child : expr.children) {
+            resolve(*child);
+        }
+    }
+
+    // The element, or column, of a filter condition; one binding per name and filter
+    const Binding* element(const std::string& name) {
+        auto it = elements->find(name);
+        if (it != elements->end()) {
+            return it->second;
+        }
+        tree.allBindings.push_back(Binding{ name, Binding::Kind::Element, depth, 0, -1, function });
+        return (*elements)[name] = &tree.allBindings.back();
+    }
+};
+
+inline std::unique_ptr<SyntaxTree> SyntaxTree::build(const std::vector<Statement>& statements,
+                                                     const std::map<std::string, Function>& functions) {
+    auto tree = std::make_unique<SyntaxTree>();
+    SyntaxTreeBuilder(*tree, statements, functions).build();
+    return tree;
+}
+
+inline std::string SyntaxTree::describe(const Binding* binding) {
+    if (binding == nullptr) {
+        return "unresolved";
+    }
+    static const char* const KINDS[] = { "global", "local", "parameter", "element", "column" };
+    std::string text = KINDS[static_cast<int>(binding->kind)];
+    if (binding->slot >= 0) {
+        text += " " + std::to_string(binding->slot);
+    }
+    if (binding->function != nullptr) {
+        text += " of " + binding->function->name;
+    }
+    text += ", depth " + std::to_string(binding->depth);
+    if (binding->kind == Binding::Kind::Global || binding->kind == Binding::Kind::Local) {
+        text += ", line " + std::to_string(binding->line);
+    } else if (binding->kind == Binding::Kind::Column) {
+        text += ", read on line " + std::to_string(binding->line);
+    }
+    if (binding->type != ValueType::Unknown) {
+        text += std::string(", ") + valueTypeName(binding->type);
+    }
+    return text;
+}
+
+inline void SyntaxTree::dump(std::ostream& out) const {
+    out << "top level: " << slotCount << (slotCount == 1 ? " variable" : " variables") << "\n";
+    for (const Stmt& stmt : body) {
+        dumpStatement(out, stmt, 1);
+    }
+}
+
+inline void SyntaxTree::dumpStatement(std::ostream& out, const Stmt& stmt, int indent) const {
+    std::string pad(2 * indent, ' ');
+    out << pad << stmt.line << ": " << statementKindName(stmt.kind());
+    const Statement& statement = *stmt.statement;
+    if (stmt.kind() == StatementKind::Goto) {
+        out << " " << statement.args[0];
+    }
+    if (statement.isSpawn) out << (statement.isolated ? " (parallel)" : " (spawn)");
+    if (statement.isAwait) out << " (await)";
+    if (statement.isRecv) out << " (recv)";
+    if (stmt.typed) out << " (typed)";
+    out << ", depth " << stmt.depth << "\n";
+
+    for (const Binding* target : stmt.targets) {
+        out << pad << "  -> " << (target ? target->name : std::string("?")) << " [" << describe(target) << "]\n";
+    }
+    for (const auto& expr : stmt.exprs) {
+        dumpExpression(out, *expr, indent + 1);
+    }
+    if (stmt.function >= 0) {
+        const FunctionNode& node = functions[stmt.function];
+        out << pad << "  " << node.name << "(";
+        for (size_t i = 0; i < node.parameters.size(); ++i) {
+            out << (i > 0 ? ", " : "") << node.parameters[i]->name;
+        }
+        out << "): " << node.slotCount << (node.slotCount == 1 ? " variable" : " variables")
+            << (node.function == nullptr ? ", redefined" : "") << "\n";
+        for (const Stmt& inner : node.body) {
+            dumpStatement(out, inner, indent + 1);
+        }
+    }
+    for (const Stmt& inner : stmt.body) {
+        dumpStatement(out, inner, indent + 1);
+    }
+}
+
+inline void SyntaxTree::dumpExpression(std::ostream& out, const Expr& expr, int indent) {
+    std::string pad(2 * indent, ' ');
+    out << pad;
+    switch (expr.kind) {
+    case Expr::Kind::Literal: {
+        std::string text = expr.value.type == "string" ? expr.value.asString() : expr.value.value;
+        for (size_t at = text.find('\n'); at != std::string::npos; at = text.find('\n', at + 2)) {
+            text.replace(at, 1, "\\n");
+        }
+        out << expr.value.type << " " << (expr.value.type == "string" ? "\"" + text + "\"" : text);
+        break;
+    }
+    case Expr::Kind::Interpolation: out << "interpolation \"" << expr.text << "\""; break;
+    case Expr::Kind::Input: out << "input"; break;
+    case Expr::Kind::Variable: out << "variable " << expr.text << " [" << describe(expr.binding) << "]"; break;
+    case Expr::Kind::FunctionRef: out << "function " << expr.text << " [line " << expr.function->startingLine << "]"; break;
+    case Expr::Kind::Unary: out << "unary " << expr.text << " [" << valueTypeName(expr.type) << "]"; break;
+    case Expr::Kind::Binary: out << "binary " << expr.text << " [" << valueTypeName(expr.type) << "]"; break;
+    case Expr::Kind::Call:
+        out << "call " << expr.text;
+        out << (expr.function != nullptr ? " [line " + std::to_string(expr.function->startingLine) + "]" : std::string(" [host]"));
+        break;
+    case Expr::Kind::Index: out << "index"; break;
+    case Expr::Kind::Array: out << "array"; break;
+    case Expr::Kind::Pipe: out << "pipe"; break;
+    case Expr::Kind::Filter: out << expr.text; break;
+    case Expr::Kind::Error: out << "error: " << expr.text; break;
+    }
+    out << "\n";
+    for (const auto& child : expr.children) {
+        dumpExpression(out, *child, indent + 1);
+    }
+}
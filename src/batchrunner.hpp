@@ -0,0 +1,102 @@
+#pragma once
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+
+#include "executionengine.hpp"
+#include "program.hpp"
+#include "threadpool.hpp"
+
+struct BatchResult {
+    std::string output;
+    std::string errors;
+    bool failed = false;  // Stopped by a fatal error
+};
+
+/**
+ * @brief Runs many independent scripts concurrently on a work-stealing pool.
+ * Every job gets its own engine with its own output, error and input streams, so nothing
+ * is shared between threads except immutable Programs. Results come back in the order the
+ * jobs were added, whatever order they finished in.
+ */
+class BatchRunner {
+public:
+    // Called on every engine before it runs, e.g. to register natives
+    using SetupFunction = std::function<void(ExecutionEngine&)>;
+
+    explicit BatchRunner(size_t threadCount = 0, SetupFunction setupFunction = nullptr)
+        : pool(threadCount), setup(std::move(setupFunction)) {}
+
+    // Queues a script file. It's compiled on a worker thread.
+    size_t addFile(const std::string& filename, const std::string& input = "") {
+        jobs.push_back(Job{ filename, nullptr, input });
+        return jobs.size() - 1;
+    }
+
+    // Queues one more instance of a compiled program, with its own input
+    size_t addProgram(std::shared_ptr<const Program> program, const std::string& input = "") {
+        jobs.push_back(Job{ program->getName(), std::move(program), input });
+        return jobs.size() - 1;
+    }
+
+    size_t threadCount() const { return pool.threadCount(); }
+
+    // Runs every queued job; result i belongs to the i-th job added
+    std::vector<BatchResult> run() {
+        std::vector<BatchResult> results(jobs.size());
+        for (size_t i = 0; i < jobs.size(); ++i) {
+            pool.submit([this, i, &results]() { runJob(jobs[i], results[i]); });
+        }
+        pool.wait();
+        jobs.clear();
+        return results;
+    }
+
+    // Writes the results one after another, in job order
+    static void writeResults(const std::vector<BatchResult>& results, std::ostream& out, std::ostream& err) {
+        for (const BatchResult& result : results) {
+            out << result.output;
+            err << result.errors;
+        }
+        out.flush();
+    }
+
+private:
+    struct Job {
+        std::string filename;
+        std::shared_ptr<const Program> program;
+        std::string input;
+    };
+
+    WorkStealingPool pool;
+    SetupFunction setup;
+    std::vector<Job> jobs;
+
+    void runJob(const Job& job, BatchResult& result) {
+        std::ostringstream output;
+        std::ostringstream errors;
+        std::istringstream input(job.input);
+
+        try {
+            std::shared_ptr<const Program> program = job.program ? job.program : Program::fromFile(job.filename, errors);
+            ExecutionEngine engine(program);
+            engine.setOutput(output);
+            engine.setErrorOutput(errors);
+            engine.setInput(input);
+            if (setup) {
+                setup(engine);
+            }
+            engine.run();
+        } catch (const std::exception& e) {
+            errors << "Execution Fatal Error in " << job.filename << ": " << e.what() << "\n";
+            result.failed = true;
+        }
+
+        result.output = output.str();
+        result.errors = errors.str();
+    }
+};
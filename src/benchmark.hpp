@@ -0,0 +1,160 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <memory>
+#include <cstdint>
+
+#include "executionengine.hpp"
+#include "program.hpp"
+#include "batchrunner.hpp"
+#include "vectorkernels.hpp"
+
+// --- Command line benchmarks (see main.cpp) ---
+
+// Nanoseconds per iteration of 'body', run 'iterations' times
+template <typename Body>
+double timePerIteration(int iterations, Body body) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        body();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+/**
+ * @brief Measures the cost of creating engines for one script.
+ * Compares compiling the source for every engine against sharing one compiled Program.
+ */
+void benchmarkEngineCreation(const std::string& filename, int iterations) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open script file: " + filename);
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    const std::string source = contents.str();
+
+    // Warm up the shared syntax tables so the first compile isn't counted
+    std::shared_ptr<const Program> program = Program::fromString(source, filename);
+
+    double compileAndCreate = timePerIteration(iterations, [&]() {
+        ExecutionEngine engine(Program::fromString(source, filename));
+    });
+    double createShared = timePerIteration(iterations, [&]() {
+        ExecutionEngine engine(program);
+    });
+
+    std::cout << "Engine creation (" << iterations << " iterations, " << filename << ")\n";
+    std::cout << "  compile + create:      " << compileAndCreate << " ns/engine\n";
+    std::cout << "  create from Program:   " << createShared << " ns/engine\n";
+}
+
+/**
+ * @brief Runs 'count' instances of one script as a batch, on one thread and then on all cores.
+ * Outputs are discarded; only the throughput is reported.
+ */
+void benchmarkBatch(const std::string& filename, int count) {
+    std::shared_ptr<const Program> program = Program::fromFile(filename);
+
+    auto timeBatch = [&](size_t threads) {
+        BatchRunner runner(threads);
+        for (int i = 0; i < count; ++i) {
+            runner.addProgram(program);
+        }
+        auto start = std::chrono::steady_clock::now();
+        runner.run();
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        return std::make_pair(std::chrono::duration<double, std::milli>(elapsed).count(), runner.threadCount());
+    };
+
+    auto single = timeBatch(1);
+    auto all = timeBatch(0);
+
+    std::cout << "Batch of " << count << " runs (" << filename << ")\n";
+    std::cout << "  1 thread:    " << single.first << " ms\n";
+    std::cout << "  " << all.second << " threads:  " << all.first << " ms\n";
+}
+
+/**
+ * @brief Times the array kernels over 'count' elements with every kernel set this CPU supports.
+ */
+void benchmarkVectorKernels(size_t count) {
+    std::vector<double> a(count), b(count), out(count);
+    std::vector<long long> ints(count);
+    std::vector<uint8_t> mask(count);
+    for (size_t i = 0; i < count; ++i) {
+        a[i] = static_cast<double>(i % 1000) * 0.5;
+        b[i] = static_cast<double>(i % 7) + 1;
+        ints[i] = static_cast<long long>(i);
+    }
+    const int iterations = 20;
+    volatile double sink = 0;  // Keeps the reductions from being optimized away
+
+    std::cout << "Vector kernels (" << count << " elements, ns/element)\n";
+    for (const VectorKernels* kernels : VectorKernels::available()) {
+        double sum = timePerIteration(iterations, [&]() { sink += kernels->sumFloat(a.data(), count); }) / count;
+        double sumInt = timePerIteration(iterations, [&]() { sink += kernels->sumInt(ints.data(), count); }) / count;
+        double dot = timePerIteration(iterations, [&]() { sink += kernels->dotFloat(a.data(), b.data(), count); }) / count;
+        double multiply = timePerIteration(iterations, [&]() {
+            kernels->arithmeticFloat(VectorOp::Mul, a.data(), 1, b.data(), 1, out.data(), count);
+        }) / count;
+        double compare = timePerIteration(iterations, [&]() {
+            kernels->compareFloat(VectorCompare::Gt, a.data(), 1, b.data(), 0, mask.data(), count);
+        }) / count;
+        std::cout << "  " << kernels->name << ": sum " << sum << ", int sum " << sumInt << ", dot " << dot
+                  << ", a * b " << multiply << ", a > x " << compare << "\n";
+    }
+}
+
+/**
+ * @brief Compiles a generated script of 'lines' lines, using every statement form in both styles,
+ * and reports the parse throughput.
+ */
+void benchmarkParse(size_t lines) {
+    static const char* const END_STYLE[] = {
+        "func add_{n}(a, b)", "    var total_{n} = a + b * 2", "    if total_{n} > 10",
+        "        println \"big ${total_{n}}\"", "    end", "    return total_{n};", "end",
+        "var values_{n} = [1, 2.5, \"three\"]", "values_{n} = push(values_{n}, {n})", "print format(\"%5d\", {n})",
+        "csv rows_{n} = \"data.csv\" as int, str", "read rows_{n} into a, b", "# comment {n}", "",
+    };
+    static const char* const BRACKETS_STYLE[] = {
+        "func scale_{n}(x) {", "    var t_{n} = spawn add_{n}(x, 1)", "    var r_{n} = await t_{n}", "    if r_{n} == 1 {",
+        "        send ch, r_{n}", "    }", "    return r_{n}", "}", "select i, v from ch timeout 10",
+        "exec \"echo {n}\"", "scale_{n}(3)", "GOTO 1",
+    };
+
+    std::string source = "STYLE = end\n";
+    size_t count = 1;
+    for (size_t n = 0; count < lines; ++n) {
+        bool brackets = n % 2 == 1;
+        source += brackets ? "STYLE = brackets\n" : "STYLE = end\n";
+        count++;
+        for (const char* line : brackets ? std::vector<const char*>(std::begin(BRACKETS_STYLE), std::end(BRACKETS_STYLE))
+                                         : std::vector<const char*>(std::begin(END_STYLE), std::end(END_STYLE))) {
+            std::string text = line;
+            for (size_t at = text.find("{n}"); at != std::string::npos; at = text.find("{n}", at)) {
+                text.replace(at, 3, std::to_string(n));
+            }
+            source += text + '\n';
+            count++;
+        }
+    }
+
+    std::ostringstream errors;
+    Program::fromString(source, "<bench>", errors);  // Warm up
+    const int iterations = 5;
+    double nanoseconds = timePerIteration(iterations, [&]() {
+        Program::fromString(source, "<bench>", errors);
+    });
+    double seconds = nanoseconds / 1e9;
+
+    std::cout << "Parse (" << count << " lines, " << source.size() / 1024 << " KB)\n";
+    std::cout << "  " << nanoseconds / 1e6 << " ms, " << source.size() / seconds / (1024 * 1024) << " MB/s, "
+              << static_cast<size_t>(count / seconds) << " lines/s\n";
+}
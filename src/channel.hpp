@@ -0,0 +1,230 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+
+#include "evaluator.hpp"
+
+/**
+ * @brief A bounded FIFO of script values, shared between tasks and engines.
+ *
+ * Values are moved in by send and moved out by recv, so a string travels from the sender to
+ * the receiver without being copied.
+ *
+ * While only one thread sends and only one thread receives, the ring is used lock-free: the
+ * producer owns 'tail', the consumer owns 'head'. The first operation from a second sending
+ * or receiving thread switches the channel to locked mode for good. Tasks on the same engine
+ * share a thread, so a pipeline between green threads stays lock-free.
+ */
+class Channel {
+public:
+    explicit Channel(int id, size_t capacity)
+        : channelId(id), slots(capacity == 0 ? 1 : capacity) {}
+
+    Channel(const Channel&) = delete;
+    Channel& operator=(const Channel&) = delete;
+
+    int id() const { return channelId; }
+    size_t capacity() const { return slots.size(); }
+    bool isLocked() const { return locked.load(); }
+
+    // Returns false if the channel is full or closed; the value is left untouched then
+    bool trySend(EvalResult& value) {
+        if (!claim(producer, producerBusy)) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!push(value)) return false;
+        } else {
+            bool pushed = push(value);
+            producerBusy.store(false);
+            if (!pushed) return false;
+        }
+        notifyWaiters();
+        return true;
+    }
+
+    // Returns false if the channel is empty
+    bool tryRecv(EvalResult& value) {
+        if (!claim(consumer, consumerBusy)) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!pop(value)) return false;
+        } else {
+            bool popped = pop(value);
+            consumerBusy.store(false);
+            if (!popped) return false;
+        }
+        notifyWaiters();
+        return true;
+    }
+
+    void close() {
+        closed.store(true);
+        notifyWaiters();
+    }
+
+    bool isClosed() const { return closed.load(); }
+
+    // Another engine can use the channel too: it was handed to a parallel task, or looked up by id.
+    // A task waiting only on channels that aren't shared can only be woken by its own engine.
+    void markShared() { shared.store(true); }
+    bool isShared() const { return shared.load(); }
+
+    // A send would not block (it may still fail because the channel is closed)
+    bool canSend() const { return closed.load() || tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire) < slots.size(); }
+
+    // A recv would not block (it may still fail because the channel is closed and drained)
+    bool canRecv() const { return closed.load() || tail.load(std::memory_order_acquire) != head.load(std::memory_order_acquire); }
+
+    // Closed with nothing left to receive
+    bool isDrained() const { return closed.load() && tail.load(std::memory_order_acquire) == head.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Blocks the calling thread until a send (or recv) would not block, or until the deadline.
+     * @return false if the deadline passed first.
+     */
+    bool waitUntilReady(bool sending, std::chrono::steady_clock::time_point deadline) {
+        std::unique_lock<std::mutex> lock(mutex);
+        waiters++;
+        bool ready;
+        while (!(ready = sending ? canSend() : canRecv()) && std::chrono::steady_clock::now() < deadline) {
+            // Also wakes up now and then, so a far-off (or 'max') deadline is never handed to the OS
+            wake.wait_until(lock, std::min(deadline, std::chrono::steady_clock::now() + std::chrono::milliseconds(100)));
+        }
+        waiters--;
+        return ready;
+    }
+
+private:
+    const int channelId;
+    std::vector<EvalResult> slots;
+    std::atomic<size_t> head{0};  // Next slot to receive from (owned by the consumer)
+    std::atomic<size_t> tail{0};  // Next slot to send to (owned by the producer)
+    std::atomic<bool> closed{false};
+    std::atomic<bool> shared{false};
+
+    // Single producer/consumer detection
+    std::atomic<size_t> producer{0};  // Token of the only thread that has sent, 0 if none yet
+    std::atomic<size_t> consumer{0};
+    std::atomic<bool> producerBusy{false};
+    std::atomic<bool> consumerBusy{false};
+    std::atomic<bool> locked{false};
+
+    std::mutex mutex;  // Guards the ring in locked mode, and the waiters
+    std::condition_variable wake;
+    std::atomic<int> waiters{0};
+
+    static size_t threadToken() {
+        static std::atomic<size_t> nextToken{1};
+        thread_local size_t token = nextToken++;
+        return token;
+    }
+
+    /**
+     * @brief Enters the lock-free path for one side of the ring.
+     * @return false if the caller must lock instead: the channel is (or just became) locked.
+     */
+    bool claim(std::atomic<size_t>& owner, std::atomic<bool>& busy) {
+        size_t token = threadToken();
+        size_t current = owner.load();
+        if (current != token && !(current == 0 && owner.compare_exchange_strong(current, token))) {
+            lockChannel();
+            return false;
+        }
+
+        // 'locked' is checked after 'busy' is set, and lockChannel() waits for 'busy' to clear
+        // after setting 'locked', so a lock-free operation never overlaps a locked one
+        busy.store(true);
+        if (locked.load()) {
+            busy.store(false);
+            return false;
+        }
+        return true;
+    }
+
+    // Switches to locked mode, after any lock-free operation in progress has completed
+    void lockChannel() {
+        if (locked.exchange(true)) return;
+        while (producerBusy.load() || consumerBusy.load()) {
+            std::this_thread::yield();
+        }
+    }
+
+    bool push(EvalResult& value) {
+        size_t position = tail.load(std::memory_order_relaxed);
+        if (closed.load() || position - head.load(std::memory_order_acquire) >= slots.size()) {
+            return false;
+        }
+        slots[position % slots.size()] = std::move(value);
+        tail.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(EvalResult& value) {
+        size_t position = head.load(std::memory_order_relaxed);
+        if (position == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = std::move(slots[position % slots.size()]);
+        head.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // A waiter registers under the mutex before its last check, so taking the mutex here
+    // means the notification can't fall between that check and its wait
+    void notifyWaiters() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load() > 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            wake.notify_all();
+        }
+    }
+};
+
+/**
+ * @brief Process-wide lookup of channels by id, so a channel value can be passed to a parallel
+ * task running in another engine. Engines keep their channels alive; the registry doesn't.
+ */
+class ChannelRegistry {
+public:
+    static std::shared_ptr<Channel> create(size_t capacity) {
+        ChannelRegistry& registry = instance();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        int id = registry.nextId++;
+        std::shared_ptr<Channel> channel = std::make_shared<Channel>(id, capacity);
+        registry.channels[id] = channel;
+
+        // Forget channels nobody uses any more, once in a while
+        if (registry.channels.size() > 2 * registry.liveAtLastSweep + 64) {
+            for (auto it = registry.channels.begin(); it != registry.channels.end(); ) {
+                it = it->second.expired() ? registry.channels.erase(it) : std::next(it);
+            }
+            registry.liveAtLastSweep = registry.channels.size();
+        }
+        return channel;
+    }
+
+    static std::shared_ptr<Channel> find(int id) {
+        ChannelRegistry& registry = instance();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        auto it = registry.channels.find(id);
+        return it == registry.channels.end() ? nullptr : it->second.lock();
+    }
+
+private:
+    std::mutex mutex;
+    std::map<int, std::weak_ptr<Channel>> channels;
+    int nextId = 1;
+    size_t liveAtLastSweep = 0;
+
+    static ChannelRegistry& instance() {
+        static ChannelRegistry registry;
+        return registry;
+    }
+};
@@ -0,0 +1,329 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fstream>
+#include <cstring>
+#include <charconv>
+#include <stdexcept>
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#endif
+
+#include "evaluator.hpp"
+
+/**
+ * @brief Streaming CSV/TSV reader.
+ * Reads the file in fixed-size chunks and hands out each record as string_views into the
+ * chunk buffer, so reading a record performs no per-field heap allocation. Quoted fields
+ * ("a, ""b""") are unescaped in place inside the buffer.
+ *
+ * Column types are the EvalResult types ("int", "float", "bool", "string"). They are either
+ * given explicitly with setColumnTypes() or inferred from the first data record.
+ */
+class CsvReader {
+public:
+    CsvReader(const std::string& filename, char delim = ',', bool header = true)
+        : file(filename, std::ios::binary), delimiter(delim), hasHeader(header) {
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open CSV file: " + filename);
+        }
+        buffer.resize(CHUNK_SIZE);
+
+        // The header row gives the column names
+        if (hasHeader && readRecord()) {
+            for (std::string_view name : fields) {
+                columnNames.emplace_back(name);
+            }
+        }
+    }
+
+    /**
+     * @brief Advances to the next record.
+     * @return false once the end of the file has been reached.
+     */
+    bool readRecord() {
+        // Blank lines are not records
+        do {
+            size_t recordEnd;
+            while (!findRecordEnd(recordEnd)) {
+                if (!refill()) {
+                    return false;
+                }
+            }
+
+            parseFields(recordEnd);
+
+            // Skip the line terminator (\n, \r\n or end of data)
+            pos = recordEnd;
+            if (pos < length && buffer[pos] == '\r') pos++;
+            if (pos < length && buffer[pos] == '\n') pos++;
+        } while (fields.size() == 1 && fields[0].empty());
+
+        if (columnTypes.empty() && (!hasHeader || !columnNames.empty())) {
+            inferColumnTypes();
+        }
+        return true;
+    }
+
+    size_t fieldCount() const { return fields.size(); }
+
+    // Raw field text. Only valid until the next readRecord().
+    std::string_view field(size_t i) const { return fields[i]; }
+
+    const std::vector<std::string>& getColumnNames() const { return columnNames; }
+    const std::vector<std::string>& getColumnTypes() const { return columnTypes; }
+
+    void setColumnTypes(const std::vector<std::string>& types) {
+        for (const std::string& type : types) {
+            if (type != "int" && type != "float" && type != "bool" && type != "string") {
+                throw std::runtime_error("Type Error: Unknown CSV column type '" + type + "'");
+            }
+        }
+        columnTypes = types;
+    }
+
+    /**
+     * @brief Writes a field into an existing value/type pair as an EvalResult-style value.
+     * Assigning into existing strings reuses their capacity, so binding the same variables
+     * record after record does not allocate. Fields that don't match their column type
+     * fall back to "string".
+     */
+    void fieldInto(size_t i, std::string& value, std::string& type) const {
+        std::string_view text = i < fields.size() ? fields[i] : std::string_view();
+        const std::string& columnType = i < columnTypes.size() ? columnTypes[i] : STRING_TYPE;
+
+        if (columnType != "string" && matchesType(text, columnType)) {
+            if (columnType == "bool") {
+                value.assign(isTrue(text) ? "true" : "false");
+            } else {
+                value.assign(text.data(), text.size());
+            }
+            type.assign(columnType);
+            return;
+        }
+
+        value.assign(text.data(), text.size());
+        type.assign("string");
+    }
+
+    EvalResult typedField(size_t i) const {
+        EvalResult result;
+        fieldInto(i, result.value, result.type);
+        return result.type == "string" ? EvalResult::fromString(std::move(result.value)) : result;
+    }
+
+private:
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+    inline static const std::string STRING_TYPE = "string";
+
+    std::ifstream file;
+    std::vector<char> buffer;
+    size_t pos = 0;     // Start of the unread data
+    size_t length = 0;  // End of the valid data
+    bool eof = false;
+
+    char delimiter;
+    bool hasHeader;
+
+    std::vector<std::string_view> fields;
+    std::vector<std::string> columnNames;
+    std::vector<std::string> columnTypes;
+
+    /**
+     * @brief Returns the first delimiter, quote or line break in [p, end).
+     * Uses 16-byte SSE2 compares where available, with a scalar loop for the tail.
+     */
+    static const char* scanSpecial(const char* p, const char* end, char delim) {
+#if defined(__SSE2__) && defined(__GNUC__)
+        const __m128i d = _mm_set1_epi8(delim);
+        const __m128i q = _mm_set1_epi8('"');
+        const __m128i n = _mm_set1_epi8('\n');
+        const __m128i r = _mm_set1_epi8('\r');
+        while (end - p >= 16) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, d), _mm_cmpeq_epi8(chunk, q)),
+                                        _mm_or_si128(_mm_cmpeq_epi8(chunk, n), _mm_cmpeq_epi8(chunk, r)));
+            int mask = _mm_movemask_epi8(hits);
+            if (mask != 0) {
+                return p + __builtin_ctz(mask);
+            }
+            p += 16;
+        }
+#endif
+        while (p < end && *p != delim && *p != '"' && *p != '\n' && *p != '\r') {
+            p++;
+        }
+        return p;
+    }
+
+    // Finds the end of the record starting at pos (the offset of its line break, or the end of
+    // the data at EOF). Returns false if the buffer doesn't hold a complete record yet.
+    bool findRecordEnd(size_t& recordEnd) {
+        const char* begin = buffer.data();
+        const char* p = begin + pos;
+        const char* end = begin + length;
+        bool inQuotes = false;
+
+        if (pos == length) {
+            return false;
+        }
+
+        while (true) {
+            if (inQuotes) {
+                const char* quote = static_cast<const char*>(std::memchr(p, '"', end - p));
+                if (quote == nullptr) break;
+                p = quote + 1;
+                inQuotes = false;
+                continue;
+            }
+            p = scanSpecial(p, end, delimiter);
+            if (p == end) break;
+            if (*p == '\n' || *p == '\r') {
+                recordEnd = p - begin;
+                return true;
+            }
+            if (*p == '"') inQuotes = true;
+            p++;
+        }
+
+        // Last record without a trailing newline
+        if (eof) {
+            recordEnd = length;
+            return true;
+        }
+        return false;
+    }
+
+    // Splits [pos, recordEnd) into fields, unescaping quoted fields in place.
+    void parseFields(size_t recordEnd) {
+        char* begin = buffer.data();
+        char* p = begin + pos;
+        char* end = begin + recordEnd;
+        fields.clear();
+
+        while (true) {
+            if (p < end && *p == '"') {
+                // Quoted field: compact the contents towards the opening quote
+                char* out = p;
+                char* start = p;
+                p++;
+                while (p < end) {
+                    if (*p == '"') {
+                        if (p + 1 < end && p[1] == '"') {
+                            *out++ = '"';
+                            p += 2;
+                            continue;
+                        }
+                        p++;
+                        break;
+                    }
+                    *out++ = *p++;
+                }
+                // Anything between the closing quote and the delimiter is kept as-is
+                while (p < end && *p != delimiter) {
+                    *out++ = *p++;
+                }
+                fields.emplace_back(start, out - start);
+            } else {
+                char* start = p;
+                // Stray quotes inside an unquoted field are literal characters
+                while (true) {
+                    p = const_cast<char*>(scanSpecial(p, end, delimiter));
+                    if (p < end && *p == '"') {
+                        p++;
+                        continue;
+                    }
+                    break;
+                }
+                fields.emplace_back(start, p - start);
+            }
+
+            if (p < end && *p == delimiter) {
+                p++;
+                continue;
+            }
+            break;
+        }
+    }
+
+    // Moves the unread tail to the front of the buffer and reads the next chunk after it.
+    bool refill() {
+        if (eof) {
+            return false;
+        }
+
+        size_t remaining = length - pos;
+        if (pos > 0 && remaining > 0) {
+            std::memmove(buffer.data(), buffer.data() + pos, remaining);
+        }
+        pos = 0;
+        length = remaining;
+
+        // A record longer than the buffer: grow it
+        if (length == buffer.size()) {
+            buffer.resize(buffer.size() * 2);
+        }
+
+        file.read(buffer.data() + length, buffer.size() - length);
+        length += static_cast<size_t>(file.gcount());
+        if (!file) {
+            eof = true;
+        }
+        return true;
+    }
+
+    void inferColumnTypes() {
+        columnTypes.clear();
+        for (std::string_view text : fields) {
+            if (matchesType(text, "bool")) columnTypes.push_back("bool");
+            else if (matchesType(text, "int")) columnTypes.push_back("int");
+            else if (matchesType(text, "float")) columnTypes.push_back("float");
+            else columnTypes.push_back("string");
+        }
+    }
+
+    static bool isTrue(std::string_view text) {
+        return text == "true" || text == "TRUE" || text == "True";
+    }
+
+    static bool matchesType(std::string_view text, const std::string& type) {
+        if (text.empty()) {
+            return false;
+        }
+        const char* first = text.data();
+        const char* last = text.data() + text.size();
+        if (*first == '+') first++;
+
+        if (type == "bool") {
+            return isTrue(text) || text == "false" || text == "FALSE" || text == "False";
+        }
+        if (type == "int") {
+            long long n;
+            auto [ptr, ec] = std::from_chars(first, last, n);
+            return ec == std::errc() && ptr == last;
+        }
+        if (type == "float") {
+            // Digits with an optional fraction only: the Evaluator can't read 1e5, inf or nan,
+            // which from_chars would accept
+            if (first == text.data() && first != last && *first == '-') first++;
+            const char* digits = first;
+            while (first != last && *first >= '0' && *first <= '9') first++;
+            if (first == digits) {
+                return false;
+            }
+            if (first != last && *first == '.') {
+                const char* fraction = ++first;
+                while (first != last && *first >= '0' && *first <= '9') first++;
+                if (first == fraction) {
+                    return false;
+                }
+            }
+            return first == last;
+        }
+        return type == "string";
+    }
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <functional>
+
+#include "executionengine.hpp"
+#include "program.hpp"
+
+/**
+ * @brief A pool of initialized engines for running the same script once per request.
+ * Each engine loads nothing from disk: it's built from the shared Program, runs the script's
+ * top-level code once, and is checkpointed. Released engines are reset() to that checkpoint,
+ * so a request never pays for loading or global initialization again.
+ */
+class EnginePool {
+public:
+    // Called on every new engine before its top-level code runs, e.g. to register natives
+    using SetupFunction = std::function<void(ExecutionEngine&)>;
+
+    // Returns the engine to its pool when it goes out of scope
+    class Lease {
+    public:
+        Lease(EnginePool* owner, std::unique_ptr<ExecutionEngine> leased)
+            : pool(owner), engine(std::move(leased)) {}
+
+        Lease(Lease&& other) noexcept = default;
+        Lease& operator=(Lease&& other) = delete;
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+        ~Lease() {
+            if (engine) {
+                pool->release(std::move(engine));
+            }
+        }
+
+        ExecutionEngine& operator*() { return *engine; }
+        ExecutionEngine* operator->() { return engine.get(); }
+
+    private:
+        EnginePool* pool;
+        std::unique_ptr<ExecutionEngine> engine;
+    };
+
+    explicit EnginePool(std::shared_ptr<const Program> compiled, SetupFunction setupFunction = nullptr)
+        : program(std::move(compiled)), setup(std::move(setupFunction)) {}
+
+    // Takes an idle engine, or initializes a new one if none is available. Thread-safe.
+    Lease acquire() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!idle.empty()) {
+                std::unique_ptr<ExecutionEngine> engine = std::move(idle.back());
+                idle.pop_back();
+                return Lease(this, std::move(engine));
+            }
+        }
+        return Lease(this, createEngine());
+    }
+
+    // Initializes engines ahead of the first requests
+    void reserve(size_t count) {
+        std::vector<std::unique_ptr<ExecutionEngine>> created;
+        for (size_t i = 0; i < count; ++i) {
+            created.push_back(createEngine());
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& engine : created) {
+            idle.push_back(std::move(engine));
+        }
+    }
+
+    size_t idleCount() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return idle.size();
+    }
+
+private:
+    std::shared_ptr<const Program> program;
+    SetupFunction setup;
+
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ExecutionEngine>> idle;
+
+    std::unique_ptr<ExecutionEngine> createEngine() {
+        std::unique_ptr<ExecutionEngine> engine(new ExecutionEngine(program));
+        if (setup) {
+            setup(*engine);
+        }
+        engine->run();
+        engine->checkpoint();
+        return engine;
+    }
+
+    void release(std::unique_ptr<ExecutionEngine> engine) {
+        engine->reset();
+        std::lock_guard<std::mutex> lock(mutex);
+        idle.push_back(std::move(engine));
+    }
+};
@@ -2,17 +2,64 @@
 
 #include <stack>
 #include <map>
+#include <vector>
+#include <memory>
 #include <sstream>
 #include <stdexcept>
 #include <cmath> // For std::fmod and std::floor
+#include <cstdint>
+#include <cstdlib>
+#include <cerrno>
+#include <string_view>
+#include <charconv>
+
+#include "vectorkernels.hpp"
+#include "symbols.hpp"
+
+struct ArrayData;
+struct TableData;
+inline std::string tableText(const TableData& table);  // In table.hpp
+
+/**
+ * @brief The shortest text that reads back as the same number, like 0.1 or 2.5.
+ * Written in fixed notation, since the Evaluator doesn't read exponents, and always with a
+ * decimal point, so the value stays a float when it's substituted into an expression again.
+ * Short results fit in std::string's own buffer, so nothing is allocated.
+ */
+template <typename Float>
+inline std::string formatFloat(Float value) {
+    char buffer[512];  // Enough for any double in fixed notation
+    char* end = std::to_chars(buffer, buffer + sizeof(buffer) - 2, value, std::chars_format::fixed).ptr;
+    if (std::string_view(buffer, end - buffer).find_first_of(".ni") == std::string_view::npos) {
+        *end++ = '.';
+        *end++ = '0';
+    }
+    return std::string(buffer, end);
+}
+
+/**
+ * @brief The type of a variable or expression, as type inference proves it (see TypeInference).
+ * Unknown is the start, before anything is known; Mixed means it can be more than one type,
+ * or one that has no typed code (arrays, tables, errors).
+ */
+enum class ValueType : uint8_t { Unknown, Int, Float, Bool, String, Mixed };
+
+inline const char* valueTypeName(ValueType type) {
+    static const char* const NAMES[] = { "unknown", "int", "float", "bool", "string", "mixed" };
+    return NAMES[static_cast<size_t>(type)];
+}
 
 /**
  * @brief Holds the result of an evaluation.
- * The 'type' string can be "int", "float", "bool", "string", or "error".
+ * The 'type' string can be "int", "float", "bool", "string", "array", "table", or "error".
  */
 struct EvalResult {
     std::string value;
     std::string type;
+    std::shared_ptr<const ArrayData> array;  // Elements of an "array". Never modified, so copies share them.
+    std::shared_ptr<const TableData> table;  // Columns of a "table", shared the same way
+    std::shared_ptr<const std::string> text; // Text of a long "string", shared the same way
+    SymbolRef symbol;                        // Set for interned strings: equal strings share one Symbol
 
     EvalResult(std::string v = "", std::string t = "empty") : value(std::move(v)), type(std::move(t)) {}
 
@@ -34,23 +81,215 @@ struct EvalResult {
         }
     }
     bool asBool() const { return value == "true"; }
-    std::string asString() const {
-        // Return contents *without* the quotes
-        if (type == "string" && value.length() >= 2 && value.front() == '"' && value.back() == '"') {
-            return value.substr(1, value.length() - 2);
-        }
+
+    // Factories for values coming from C++
+    static EvalResult fromInt(long long v) { return EvalResult(std::to_string(v), "int"); }
+    static EvalResult fromFloat(double v) { return EvalResult(formatFloat(v), "float"); }
+    static EvalResult fromBool(bool v) { return EvalResult(v ? "true" : "false", "bool"); }
+    // Strings are kept without quotes: short ones in 'value', within std::string's own buffer, and
+    // longer ones in 'text', so copying a string value never copies its characters
+    static EvalResult fromString(std::string v) {
+        EvalResult result("", "string");
+        if (v.length() <= std::string().capacity()) result.value = std::move(v);
+        else result.text = std::make_shared<const std::string>(std::move(v));
+        return result;
+    }
+    static EvalResult fromSymbol(SymbolRef s) {
+        EvalResult result("", "string");
+        result.symbol = std::move(s);
+        return result;
+    }
+    static EvalResult fromArray(std::vector<EvalResult> elements);
+    static EvalResult fromArray(std::shared_ptr<const ArrayData> data);
+    static EvalResult fromTable(std::shared_ptr<const TableData> data) {
+        EvalResult result("", "table");
+        result.table = std::move(data);
+        return result;
+    }
+
+    size_t size() const;
+    std::string asString() const;
+
+    // The text of a string (or the value of a number or bool), without copying it
+    std::string_view stringView() const {
+        if (symbol != nullptr) return symbol->text;
+        if (text) return *text;
         return value;
     }
+
+    // The same string, interned
+    EvalResult interned() const {
+        return type == "string" && symbol == nullptr ? fromSymbol(intern(stringView())) : *this;
+    }
 };
 
+/**
+ * @brief Elements of an array value.
+ * Arrays holding only ints, only floats or only bools are stored unboxed, so the vector kernels
+ * (vectorkernels.hpp) can run over them. Any other array keeps its EvalResults.
+ */
+struct ArrayData {
+    enum class Kind { Mixed, Int, Float, Bool };
+
+    Kind kind = Kind::Mixed;
+    std::vector<EvalResult> items;  // Mixed
+    std::vector<long long> ints;    // Int
+    std::vector<double> floats;     // Float
+    std::vector<uint8_t> bools;     // Bool
+
+    size_t size() const {
+        switch (kind) {
+        case Kind::Int: return ints.size();
+        case Kind::Float: return floats.size();
+        case Kind::Bool: return bools.size();
+        default: return items.size();
+        }
+    }
+
+    EvalResult at(size_t i) const {
+        switch (kind) {
+        case Kind::Int: return EvalResult::fromInt(ints[i]);
+        case Kind::Float: return EvalResult::fromFloat(floats[i]);
+        case Kind::Bool: return EvalResult::fromBool(bools[i] != 0);
+        default: return items[i];
+        }
+    }
+
+    bool isNumeric() const { return kind == Kind::Int || kind == Kind::Float; }
+
+    // The elements whose byte in 'mask' (one per element, 0 or 1) is 1, in order
+    std::shared_ptr<const ArrayData> filtered(const uint8_t* mask) const {
+        const VectorKernels& kernels = VectorKernels::best();
+        size_t count = kernels.countTrue(mask, size());
+        auto result = std::make_shared<ArrayData>();
+        result->kind = kind;
+        switch (kind) {
+        case Kind::Int:
+            result->ints.resize(count + 4);  // Room for the compaction kernel's overhang
+            kernels.compactInt(ints.data(), mask, size(), result->ints.data());
+            result->ints.resize(count);
+            break;
+        case Kind::Float:
+            result->floats.resize(count + 4);
+            kernels.compactFloat(floats.data(), mask, size(), result->floats.data());
+            result->floats.resize(count);
+            break;
+        case Kind::Bool:
+            result->bools.reserve(count);
+            for (size_t i = 0; i < bools.size(); ++i) {
+                if (mask[i]) result->bools.push_back(bools[i]);
+            }
+            break;
+        case Kind::Mixed:
+            result->items.reserve(count);
+            for (size_t i = 0; i < items.size(); ++i) {
+                if (mask[i]) result->items.push_back(items[i]);
+            }
+            break;
+        }
+        return result;
+    }
+
+    // The elements at the positions in 'order', in that order
+    std::shared_ptr<const ArrayData> gathered(const std::vector<uint32_t>& order) const {
+        auto result = std::make_shared<ArrayData>();
+        result->kind = kind;
+        switch (kind) {
+        case Kind::Int:
+            result->ints.reserve(order.size());
+            for (uint32_t i : order) result->ints.push_back(ints[i]);
+            break;
+        case Kind::Float:
+            result->floats.reserve(order.size());
+            for (uint32_t i : order) result->floats.push_back(floats[i]);
+            break;
+        case Kind::Bool:
+            result->bools.reserve(order.size());
+            for (uint32_t i : order) result->bools.push_back(bools[i]);
+            break;
+        case Kind::Mixed:
+            result->items.reserve(order.size());
+            for (uint32_t i : order) result->items.push_back(items[i]);
+            break;
+        }
+        return result;
+    }
+
+    // Stores the elements unboxed when they all have the same int, float or bool type
+    static std::shared_ptr<const ArrayData> fromItems(std::vector<EvalResult> elements) {
+        auto data = std::make_shared<ArrayData>();
+        const std::string& type = elements.empty() ? "" : elements[0].type;
+        bool uniform = type == "int" || type == "float" || type == "bool";
+        for (size_t i = 1; uniform && i < elements.size(); ++i) {
+            uniform = elements[i].type == type;
+        }
+        try {
+            if (uniform && type == "int") {
+                data->ints.reserve(elements.size());
+                for (const EvalResult& element : elements) data->ints.push_back(std::stoll(element.value));
+                data->kind = Kind::Int;
+            } else if (uniform && type == "float") {
+                data->floats.reserve(elements.size());
+                for (const EvalResult& element : elements) data->floats.push_back(std::stod(element.value));
+                data->kind = Kind::Float;
+            } else if (uniform && type == "bool") {
+                data->bools.reserve(elements.size());
+                for (const EvalResult& element : elements) data->bools.push_back(element.asBool() ? 1 : 0);
+                data->kind = Kind::Bool;
+            }
+        } catch (...) {
+            // A value out of range stays boxed
+            data->ints.clear();
+            data->floats.clear();
+        }
+        if (data->kind == Kind::Mixed) {
+            data->items = std::move(elements);
+        }
+        return data;
+    }
+};
+
+inline EvalResult EvalResult::fromArray(std::vector<EvalResult> elements) {
+    return fromArray(ArrayData::fromItems(std::move(elements)));
+}
+
+inline EvalResult EvalResult::fromArray(std::shared_ptr<const ArrayData> data) {
+    EvalResult result("", "array");
+    result.array = std::move(data);
+    return result;
+}
+
+inline size_t EvalResult::size() const { return array ? array->size() : 0; }
+
+inline std::string EvalResult::asString() const {
+    // Arrays print as [1, 2, three]
+    if (type == "array") {
+        std::string text = "[";
+        for (size_t i = 0; i < size(); ++i) {
+            if (i > 0) text += ", ";
+            text += array->at(i).asString();
+        }
+        return text + "]";
+    }
+    if (type == "table") {
+        return tableText(*table);
+    }
+    if (type == "string") {
+        return std::string(stringView());
+    }
+    return value;
+}
+
 class Evaluator {
 public:
     /**
      * @brief Main function to evaluate a full expression string.
      * @param expression The infix expression (e.g., "5 * (3 + 2)").
+     * @param operands Values the expression refers to as $0, $1, ... (arrays, which have no literal).
      * @return An EvalResult containing the final value or an error.
      */
-    EvalResult evaluate(const std::string& expression) {
+    EvalResult evaluate(const std::string& expression, const std::vector<EvalResult>& operands = {}) {
+        this->operands = &operands;
         try {
             // 1. Tokenize the input string
             std::vector<std::string> tokens = tokenize(expression);
@@ -67,6 +306,8 @@ public:
     }
 
 private:
+    const std::vector<EvalResult>* operands = nullptr;
+
     // Helper function for implicit type conversion
     EvalResult coerceToNumber(const EvalResult& result) {
         if (result.type == "string") {
@@ -96,19 +337,18 @@ private:
         return s.length() >= 2 && s.front() == '"' && s.back() == '"';
     }
 
-    // A more robust number checker
+    // A more robust number checker. Every operator token is checked too, so it doesn't throw.
     static bool isNumber(const std::string& s) {
-        try {
-            size_t pos;
-            std::stof(s, &pos);
-            // Ensure the *entire* string was parsed as a number
-            return pos == s.length();
-        } catch (...) {
-            return false;
-        }
+        const char* begin = s.c_str();
+        char* end = nullptr;
+        errno = 0;
+        std::strtof(begin, &end);
+        // Ensure the *entire* string was parsed as a number that fits a float
+        return end != begin && end == begin + s.length() && errno != ERANGE;
     }
 
     static std::string getTokenType(const std::string& token) {
+        if (token.length() > 1 && token[0] == '$') return "operand";
         if (isBool(token)) return "bool";
         if (isString(token)) return "string";
         if (isNumber(token)) {
@@ -209,6 +449,16 @@ private:
                 tokens.push_back(current_token);
                 current_token = "";
             }
+            // Operand references: $0, $1, ...
+            else if (c == '$' && i + 1 < expression.length() && isdigit(expression[i+1])) {
+                current_token += c;
+                while (i + 1 < expression.length() && isdigit(expression[i+1])) {
+                    current_token += expression[i+1];
+                    i++;
+                }
+                tokens.push_back(current_token);
+                current_token = "";
+            }
             // Booleans
             else if (isalpha(c)) {
                 current_token += c;
@@ -233,7 +483,8 @@ private:
 
     // --- 2. Shunting-Yard Algorithm (Unchanged) ---
     // 
-    std::map<std::string, int> precedence = {
+    // Shared by all Evaluators; operators not listed (like "(") have precedence 0
+    inline static const std::map<std::string, int> precedence = {
         {"||", 1},
         {"&&", 2},
         {"==", 3}, {"!=", 3},
@@ -243,6 +494,11 @@ private:
         {"!", 7} // Unary 'not'
     };
 
+    static int getPrecedence(const std::string& op) {
+        auto it = precedence.find(op);
+        return it == precedence.end() ? 0 : it->second;
+    }
+
     std::vector<std::string> shuntingYard(const std::vector<std::string>& tokens) {
         std::vector<std::string> output_queue;
         std::stack<std::string> operator_stack;
@@ -250,7 +506,7 @@ private:
         for (const std::string& token : tokens) {
             std::string type = getTokenType(token);
 
-            if (type == "int" || type == "float" || type == "string" || type == "bool") {
+            if (type == "int" || type == "float" || type == "string" || type == "bool" || type == "operand") {
                 output_queue.push_back(token);
             } 
             else if (token == "(") {
@@ -268,7 +524,7 @@ private:
             }
             else { // It's an operator
                 while (!operator_stack.empty() && operator_stack.top() != "(" &&
-                       precedence[operator_stack.top()] >= precedence[token]) {
+                       getPrecedence(operator_stack.top()) >= getPrecedence(token)) {
                     output_queue.push_back(operator_stack.top());
                     operator_stack.pop();
                 }
@@ -296,8 +552,18 @@ private:
         for (const std::string& token : postfix) {
             std::string type = getTokenType(token);
 
-            if (type == "int" || type == "float" || type == "bool" || type == "string") {
+            if (type == "string") {
+                stack.push(EvalResult::fromString(token.substr(1, token.length() - 2)));
+            }
+            else if (type == "int" || type == "float" || type == "bool") {
                 stack.push(EvalResult(token, type));
+            }
+            else if (type == "operand") {
+                size_t index = std::stoul(token.substr(1));
+                if (operands == nullptr || index >= operands->size()) {
+                    throw std::runtime_error("Internal Error: Unknown operand '" + token + "'");
+                }
+                stack.push((*operands)[index]);
             } 
             else { // It's an operator
                 // Handle unary '!'
@@ -326,6 +592,9 @@ private:
     // --- 4. Operation Helpers (MODIFIED) ---
 
     EvalResult applyUnaryOp(const EvalResult& operand, const std::string& op) {
+        if (op == "!" && operand.type == "array") {
+            return applyArrayNot(operand);
+        }
         if (op == "!") {
             if (operand.type != "bool") {
                 throw std::runtime_error("Type Error: Operator '!' requires a boolean operand");
@@ -336,6 +605,10 @@ private:
     }
 
     EvalResult applyBinaryOp(const EvalResult& lhs, const EvalResult& rhs, const std::string& op) {
+        if (lhs.type == "array" || rhs.type == "array") {
+            return applyArrayOp(lhs, rhs, op);
+        }
+
         // --- Logical Operations (Unchanged) ---
         if (op == "&&" || op == "||") {
             if (lhs.type != "bool" || rhs.type != "bool") {
@@ -348,7 +621,7 @@ private:
         // Comparison Operations
         if (op == "==" || op == "!=") {
             bool result;
-            if (lhs.type == "string" && rhs.type == "string") result = (lhs.asString() == rhs.asString());
+            if (lhs.type == "string" && rhs.type == "string") result = stringsEqual(lhs, rhs);
             else if (lhs.type == "bool" && rhs.type == "bool") result = (lhs.asBool() == rhs.asBool());
             // Implicitly allow int/float comparison
             else if ((lhs.type == "int" || lhs.type == "float") && (rhs.type == "int" || rhs.type == "float")) {
@@ -392,13 +665,13 @@ private:
             if (!((L.type == "int" || L.type == "float") && (R.type == "int" || R.type == "float"))) {
                 // 1. Flexible String Concatenation: If EITHER operand is a string, concatenate.
                 if (lhs.type == "string" || rhs.type == "string") {
-                    // Get the raw value string. If it's a string type, use asString() to remove quotes.
-                    // Otherwise, use .value which contains the string representation of the number/bool.
-                    std::string s_l = (lhs.type == "string") ? lhs.asString() : lhs.value;
-                    std::string s_r = (rhs.type == "string") ? rhs.asString() : rhs.value;
-                    
-                    // Concatenate and wrap in quotes to preserve it as a string literal result
-                    return EvalResult('"' + s_l + s_r + '"', "string");
+                    // Strings give their text, numbers and bools their printed value
+                    std::string_view s_l = lhs.stringView();
+                    std::string_view s_r = rhs.stringView();
+                    std::string joined;
+                    joined.reserve(s_l.length() + s_r.length());
+                    joined.append(s_l).append(s_r);
+                    return EvalResult::fromString(std::move(joined));
                 }
             }
 
@@ -413,7 +686,7 @@ private:
             std::string result_type = (L.type == "float" || R.type == "float" || std::fmod(result, 1.0) != 0.0) ? "float" : "int";
             
             if (result_type == "float") {
-                 return EvalResult(std::to_string(result), "float");
+                 return EvalResult(formatFloat(result), "float");
             }
             return EvalResult(std::to_string((long long)result), "int");
         }
@@ -451,7 +724,7 @@ private:
                 throw std::runtime_error("Type Error: Operator '%' requires integer operands");
             }
             if (R.asInt() == 0) throw std::runtime_error("Runtime Error: Modulo by zero");
-            result = L.asInt() % R.asInt();
+            result = R.asInt() == -1 ? 0 : L.asInt() % R.asInt();  // The smallest int % -1 overflows
             result_type = "int"; // Modulo always results in int
         }
         else {
@@ -460,8 +733,210 @@ private:
         
         // Final result formatting
         if (result_type == "float" || std::fmod(result, 1.0) != 0.0) {
-             return EvalResult(std::to_string(result), "float");
+             return EvalResult(formatFloat(result), "float");
         }
         return EvalResult(std::to_string((long long)result), "int");
     }
-};
\ No newline at end of file
+
+    // --- 5. Array Operations ---
+    //
+    // An operator with an array operand applies element by element. The other operand is an array
+    // of the same size, or a single value used for every element. Numeric arrays go through the
+    // vector kernels: int with int stays int for + - *, / gives floats and comparisons give bools.
+    // && || and ! combine bool arrays (masks) the same way. Anything else (strings, mixed arrays, %)
+    // applies the operator to each pair of elements.
+
+    EvalResult applyArrayOp(const EvalResult& lhs, const EvalResult& rhs, const std::string& op) {
+        // Concatenation uses the printed array, like for any other value
+        if (op == "+" && (lhs.type == "string" || rhs.type == "string")) {
+            return EvalResult::fromString(lhs.asString() + rhs.asString());
+        }
+        if (lhs.type == "array" && rhs.type == "array" && lhs.size() != rhs.size()) {
+            throw std::runtime_error("Runtime Error: Operator '" + op + "' needs arrays of the same size, found "
+                                     + std::to_string(lhs.size()) + " and " + std::to_string(rhs.size()));
+        }
+        size_t count = lhs.type == "array" ? lhs.size() : rhs.size();
+
+        if ((op == "&&" || op == "||") && isMaskOperand(lhs) && isMaskOperand(rhs)) {
+            uint8_t lhsValue = 0, rhsValue = 0;
+            size_t lhsStride = 0, rhsStride = 0;
+            const uint8_t* a = maskOperand(lhs, lhsValue, lhsStride);
+            const uint8_t* b = maskOperand(rhs, rhsValue, rhsStride);
+            auto result = std::make_shared<ArrayData>();
+            result->kind = ArrayData::Kind::Bool;
+            result->bools.resize(count);
+            VectorKernels::best().maskLogic(op == "&&" ? MaskOp::And : MaskOp::Or, a, lhsStride, b, rhsStride, result->bools.data(), count);
+            return EvalResult::fromArray(std::move(result));
+        }
+
+        VectorOp arithmetic = VectorOp::Add;
+        VectorCompare compare = VectorCompare::Eq;
+        bool isArithmetic = op == "+" || op == "-" || op == "*" || op == "/";
+        bool isComparison = op == "<" || op == ">" || op == "<=" || op == ">=" || op == "==" || op == "!=";
+        if ((isArithmetic || isComparison) && isNumericOperand(lhs) && isNumericOperand(rhs)) {
+            if (op == "+") arithmetic = VectorOp::Add;
+            else if (op == "-") arithmetic = VectorOp::Sub;
+            else if (op == "*") arithmetic = VectorOp::Mul;
+            else if (op == "/") arithmetic = VectorOp::Div;
+            else if (op == "<") compare = VectorCompare::Lt;
+            else if (op == ">") compare = VectorCompare::Gt;
+            else if (op == "<=") compare = VectorCompare::Le;
+            else if (op == ">=") compare = VectorCompare::Ge;
+            else if (op == "!=") compare = VectorCompare::Ne;
+            return applyVectorKernel(lhs, rhs, count, isComparison, arithmetic, compare);
+        }
+
+        if ((op == "==" || op == "!=") && (lhs.type == "string" || rhs.type == "string")) {
+            return applyStringEquality(lhs.type == "array" ? lhs : rhs, lhs.type == "array" ? rhs : lhs, op == "!=");
+        }
+
+        std::vector<EvalResult> results;
+        results.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            EvalResult l = lhs.type == "array" ? lhs.array->at(i) : lhs;
+            EvalResult r = rhs.type == "array" ? rhs.array->at(i) : rhs;
+            results.push_back(applyBinaryOp(l, r, op));
+        }
+        return EvalResult::fromArray(std::move(results));
+    }
+
+    // Interned strings are equal only if they are the same Symbol; others compare their text
+    static bool stringsEqual(const EvalResult& lhs, const EvalResult& rhs) {
+        if (lhs.symbol != nullptr && rhs.symbol != nullptr) {
+            return lhs.symbol == rhs.symbol;
+        }
+        return lhs.stringView() == rhs.stringView();
+    }
+
+    // array == "text": the string is interned once, so interned elements (like table cells) are compared by pointer
+    EvalResult applyStringEquality(const EvalResult& array, const EvalResult& text, bool negate) {
+        EvalResult key = text.interned();
+        auto result = std::make_shared<ArrayData>();
+        result->kind = ArrayData::Kind::Bool;
+        result->bools.resize(array.size());
+        for (size_t i = 0; i < result->bools.size(); ++i) {
+            bool equal;
+            if (array.array->kind == ArrayData::Kind::Mixed && array.array->items[i].type == "string") {
+                equal = stringsEqual(array.array->items[i], key);
+            } else {
+                equal = applyBinaryOp(array.array->at(i), key, "==").asBool();
+            }
+            result->bools[i] = equal != negate ? 1 : 0;
+        }
+        return EvalResult::fromArray(std::move(result));
+    }
+
+    EvalResult applyVectorKernel(const EvalResult& lhs, const EvalResult& rhs, size_t count, bool isComparison,
+                                 VectorOp arithmetic, VectorCompare compare) {
+        const VectorKernels& kernels = VectorKernels::best();
+        bool ints = isIntOperand(lhs) && isIntOperand(rhs);
+        auto result = std::make_shared<ArrayData>();
+
+        if (ints && (isComparison || arithmetic != VectorOp::Div)) {
+            long long lhsValue = 0, rhsValue = 0;
+            size_t lhsStride = 0, rhsStride = 0;
+            const long long* a = intOperand(lhs, lhsValue, lhsStride);
+            const long long* b = intOperand(rhs, rhsValue, rhsStride);
+            if (isComparison) {
+                result->kind = ArrayData::Kind::Bool;
+                result->bools.resize(count);
+                kernels.compareInt(compare, a, lhsStride, b, rhsStride, result->bools.data(), count);
+            } else {
+                result->kind = ArrayData::Kind::Int;
+                result->ints.resize(count);
+                kernels.arithmeticInt(arithmetic, a, lhsStride, b, rhsStride, result->ints.data(), count);
+            }
+            return EvalResult::fromArray(std::move(result));
+        }
+
+        std::vector<double> lhsStorage, rhsStorage;
+        size_t lhsStride = 0, rhsStride = 0;
+        const double* a = floatOperand(lhs, lhsStorage, lhsStride);
+        const double* b = floatOperand(rhs, rhsStorage, rhsStride);
+        if (isComparison) {
+            result->kind = ArrayData::Kind::Bool;
+            result->bools.resize(count);
+            kernels.compareFloat(compare, a, lhsStride, b, rhsStride, result->bools.data(), count);
+        } else {
+            if (arithmetic == VectorOp::Div) {
+                for (size_t i = 0; i < (rhsStride ? count : 1); ++i) {
+                    if (b[i] == 0) throw std::runtime_error("Runtime Error: Division by zero");
+                }
+            }
+            result->kind = ArrayData::Kind::Float;
+            result->floats.resize(count);
+            kernels.arithmeticFloat(arithmetic, a, lhsStride, b, rhsStride, result->floats.data(), count);
+        }
+        return EvalResult::fromArray(std::move(result));
+    }
+
+    EvalResult applyArrayNot(const EvalResult& operand) {
+        const ArrayData& array = *operand.array;
+        if (array.kind == ArrayData::Kind::Bool) {
+            auto result = std::make_shared<ArrayData>();
+            result->kind = ArrayData::Kind::Bool;
+            result->bools.resize(array.size());
+            VectorKernels::best().maskNot(array.bools.data(), result->bools.data(), array.size());
+            return EvalResult::fromArray(std::move(result));
+        }
+        std::vector<EvalResult> results;
+        results.reserve(array.size());
+        for (size_t i = 0; i < array.size(); ++i) {
+            results.push_back(applyUnaryOp(array.at(i), "!"));
+        }
+        return EvalResult::fromArray(std::move(results));
+    }
+
+    static bool isMaskOperand(const EvalResult& operand) {
+        if (operand.type == "array") return operand.array->kind == ArrayData::Kind::Bool || operand.size() == 0;
+        return operand.type == "bool";
+    }
+
+    // An operand for the mask kernels: the array's bytes, or 'value' repeated (stride 0)
+    static const uint8_t* maskOperand(const EvalResult& operand, uint8_t& value, size_t& stride) {
+        if (operand.type == "array") {
+            stride = 1;
+            return operand.array->bools.data();
+        }
+        value = operand.asBool() ? 1 : 0;
+        stride = 0;
+        return &value;
+    }
+
+    static bool isNumericOperand(const EvalResult& operand) {
+        if (operand.type == "array") return operand.array->isNumeric() || operand.size() == 0;
+        return operand.type == "int" || operand.type == "float";
+    }
+
+    static bool isIntOperand(const EvalResult& operand) {
+        if (operand.type == "array") return operand.array->kind != ArrayData::Kind::Float;
+        return operand.type == "int";
+    }
+
+    // An operand for the int kernels: the array's elements, or 'value' repeated (stride 0)
+    static const long long* intOperand(const EvalResult& operand, long long& value, size_t& stride) {
+        if (operand.type == "array") {
+            stride = 1;
+            return operand.array->ints.data();
+        }
+        value = operand.asInt();
+        stride = 0;
+        return &value;
+    }
+
+    // An operand for the float kernels. Ints are widened into 'storage'.
+    static const double* floatOperand(const EvalResult& operand, std::vector<double>& storage, size_t& stride) {
+        stride = operand.type == "array" ? 1 : 0;
+        if (operand.type == "array" && operand.array->kind == ArrayData::Kind::Float) {
+            return operand.array->floats.data();
+        }
+        if (operand.type == "array") {
+            storage.assign(operand.array->ints.begin(), operand.array->ints.end());
+        } else {
+            storage.assign(1, operand.type == "int" ? static_cast<double>(operand.asInt()) : std::strtod(operand.value.c_str(), nullptr));
+        }
+        return storage.data();
+    }
+};
+
+#include "table.hpp"
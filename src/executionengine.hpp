@@ -5,126 +5,290 @@
 #include <vector>
 #include <fstream>
 #include <cctype>
-#include <regex>
 #include <map>
+#include <memory>
+#include <type_traits>
+#include <cstdio>
+#include <deque>
+#include <future>
+#include <thread>
+#include <chrono>
 #include <sstream>
+#include <functional>
+#include <algorithm>
+#include <cstring>
 
 #include "evaluator.hpp"
 #include "variable.hpp"
 #include "helpers.hpp"
+#include "interpolation.hpp"
 #include "function.hpp"
-
-// Function to split and trim arguments for function calls
-std::vector<std::string> splitAndTrimArgs(const std::string& paramsString) {
-    std::vector<std::string> args;
-    std::stringstream ss(paramsString);
-    std::string segment;
-    while(std::getline(ss, segment, ',')) {
-        // Simple trim logic
-        size_t first = segment.find_first_not_of(' ');
-        if (std::string::npos == first) {
-            continue;
-        }
-        size_t last = segment.find_last_not_of(' ');
-        args.push_back(segment.substr(first, (last - first + 1)));
-    }
-    return args;
-}
+#include "program.hpp"
+#include "csv.hpp"
+#include "snapshot.hpp"
+#include "task.hpp"
+#include "threadpool.hpp"
+#include "channel.hpp"
+#include "sort.hpp"
 
 class ExecutionEngine {
 private:
+    std::shared_ptr<const Program> program;
     std::map<std::string, Variable> variables;
-    std::map<std::string, Function> functions;
+    std::map<std::string, NativeFunction> natives;
+    std::map<std::string, CsvReader> csvReaders;
     Evaluator eval;
-    
-    // In-memory source code vector
-    std::vector<std::string> sourceCode;
-    std::string fileName;
-
-    std::string style = "end";  // "end" or "brackets"
 
     int scopeLevel = 0;  // Tracks current scope level
     int programCounter = 1; // Tracks the current line number for context
 
     int functionDepth = 0;
-    std::vector<int> returnStack;
+    std::vector<CallFrame> callStack;
 
-    bool ignoreLine = false;
-    
-    // Regular expressions for parsing
-    const std::regex declarationRegex = std::regex(R"(^\s*var\s+([a-zA-Z_]\w*)\s*=\s*(.*))");
-    const std::regex assignmentRegex = std::regex(R"(^\s*([a-zA-Z_]\w*)\s*=\s*(.*))");
-    const std::regex printRegex = std::regex(R"(^\s*print\s+(.*))");
-    const std::regex printlnRegex = std::regex(R"(^\s*println\s+(.*))");
-    const std::regex execRegex = std::regex(R"(^\s*exec\s+(.*))");
-    std::regex ifRegex;
-
-    // Function regexes
-    std::regex funcDefRegex;
-    const std::regex funcCallRegex = std::regex(R"(^\s*([a-zA-Z_][a-zA-Z0-9_]*)\s*\((.*?)\)\s*$)");
-    const std::regex returnRegex = std::regex(R"(^\s*return\s*;?\s*$)");
-    const std::regex returnExpRegex = std::regex(R"(^\s*return\s+.+;?\s*$)");
-
-    // Control flow regexes
-    const std::regex endRegex = std::regex(R"(^\s*END\s*$)"); // Matches: END
-    const std::regex gotoRegex = std::regex(R"(^\s*GOTO\s+(\d+)\s*$)");
-    const std::regex styleRegex = std::regex(R"(^\s*STYLE\s*=\s*["']?([a-z]+)["']?\s*$)");
-    std::regex closeBlockRegex;
+    // Per-engine streams, so engines on different threads don't share std::cout/std::cin
+    std::ostream* output = &std::cout;
+    std::ostream* errorOutput = &std::cerr;
+    std::istream* input = &std::cin;
+    std::ostream discardedErrors{ nullptr };  // Takes the name errors reportNameErrors() already reported
+    // Lines whose undefined names were reported before the script ran, or null until they are.
+    // Shared with the engines of parallel tasks and slices, which run the same lines.
+    std::shared_ptr<const std::vector<bool>> reportedNameErrors;
+
+    EvalResult returnValue;
+    bool hasReturnValue = false;
+    bool hostReturned = false;  // Set when the frame of a C++ call() returns
+    bool halted = false;
+
+    // State saved by checkpoint() and restored by reset()
+    struct SavedValue {
+        Variable* variable;
+        std::string value;
+        std::string type;
+        std::shared_ptr<const ArrayData> array;
+        std::shared_ptr<const TableData> table;
+        std::shared_ptr<const std::string> text;
+        SymbolRef symbol;
+    };
+    bool hasCheckpoint = false;
+    int checkpointCounter = 1;
+    bool checkpointHalted = false;
+    std::vector<SavedValue> undoLog;  // Original values of globals written since the checkpoint
+    std::vector<std::string> createdGlobals;  // Globals declared since the checkpoint
+    unsigned long long checkpointEpoch = 0;  // Counts checkpoint() and reset() calls (see GlobalHandle)
+    std::vector<std::string> openedReaders;  // CSV readers opened since the checkpoint
+    std::vector<int> openedChannels;  // Channels this engine started using since the checkpoint
+
+    // Green threads. Empty until the first 'spawn'; task 0 is then the main program.
+    std::map<int, Task> tasks;
+    std::deque<int> readyQueue;
+    int currentTask = 0;
+    int nextTaskId = 1;
+    int unfinishedTasks = 0;  // Spawned and parallel tasks that haven't returned yet
+    int sliceCount = 0;  // Backward jumps since the last switch
+    static const int TIME_SLICE = 64;  // Backward jumps a task may take before it yields
+
+    std::map<int, std::shared_ptr<Channel>> channels;  // Channels this engine created or was handed
+
+    // A parallel task handed channels, on a thread of its own (see startParallelTask)
+    struct ChannelThread {
+        std::shared_ptr<ParallelJob> job;
+        std::vector<std::shared_ptr<Channel>> channels;  // Closed to wake it if it's cancelled
+        std::thread thread;
+    };
+    std::vector<ChannelThread> channelThreads;
+    const std::atomic<bool>* cancelled = nullptr;  // Set when this engine runs a parallel task
+
+    std::vector<EvalResult> operands;  // Arrays in the expressions being evaluated, referenced as $0, $1, ...
+
+    // Built-in functions are called like natives; script functions and natives take precedence.
+    // Pure built-ins can be used by the functions given to pmap, pfilter and preduce.
+    using Builtin = EvalResult (ExecutionEngine::*)(const std::vector<EvalResult>&);
+    struct BuiltinInfo {
+        Builtin function;
+        bool pure;
+        bool updatesFirst = false;  // Returns an updated copy of its first argument, like push()
+    };
+    static const std::map<std::string, BuiltinInfo>& builtins();
+    EvalResult builtinChannel(const std::vector<EvalResult>& args);
+    EvalResult builtinFormat(const std::vector<EvalResult>& args);
+    EvalResult builtinPrintf(const std::vector<EvalResult>& args);
+    bool formatArgs(const std::vector<EvalResult>& args, std::string& out, std::string& error) const;
+    EvalResult builtinLen(const std::vector<EvalResult>& args);
+    EvalResult builtinRange(const std::vector<EvalResult>& args);
+    EvalResult builtinPush(const std::vector<EvalResult>& args);
+    EvalResult builtinSum(const std::vector<EvalResult>& args);
+    EvalResult builtinMin(const std::vector<EvalResult>& args);
+    EvalResult builtinMax(const std::vector<EvalResult>& args);
+    EvalResult builtinMean(const std::vector<EvalResult>& args);
+    EvalResult builtinDot(const std::vector<EvalResult>& args);
+    EvalResult extreme(const std::vector<EvalResult>& args, const std::string& name);
+    EvalResult builtinParallelMap(const std::vector<EvalResult>& args);
+    EvalResult builtinParallelFilter(const std::vector<EvalResult>& args);
+    EvalResult builtinParallelReduce(const std::vector<EvalResult>& args);
+
+    // Tables
+    EvalResult builtinTable(const std::vector<EvalResult>& args);
+    EvalResult builtinReadTable(const std::vector<EvalResult>& args);
+    EvalResult builtinColumn(const std::vector<EvalResult>& args);
+    EvalResult builtinSelect(const std::vector<EvalResult>& args);
+    EvalResult builtinGroupBy(const std::vector<EvalResult>& args);
+    EvalResult builtinCount(const std::vector<EvalResult>& args);
+    EvalResult builtinAvg(const std::vector<EvalResult>& args);
+    EvalResult aggregateTable(const std::vector<EvalResult>& args, const std::string& name);
+    bool findColumns(const TableData& table, const std::vector<EvalResult>& names, size_t first,
+                     std::vector<size_t>& columns, std::string& error) const;
+
+    // Sorting
+    EvalResult builtinSort(const std::vector<EvalResult>& args);
+    EvalResult builtinSortBy(const std::vector<EvalResult>& args);
+
+    // Parallel map/reduce
+    static const size_t MIN_SLICE = 16;  // Elements per slice at least, so engine setup doesn't dominate
+    const Function* findPureFunction(const EvalResult& handle, const std::string& builtinName, size_t arity, std::string& error) const;
+    static size_t sliceCountFor(size_t count);
+    std::string runSlices(size_t count, size_t slices, const std::function<void(ExecutionEngine&, size_t, size_t, size_t)>& body);
 
     // Helpers
     void jumpToLine(int targetLine);
-    int findBlockEnd(int startLine);
-    
-    // Handlers
-    bool handleIfStatement(const std::string& line);
+    void runCommand(const std::string& command);
+    void execute();
+    EvalResult evaluateExpression(const std::string& expression);
+    EvalResult evaluatePipe(const std::string& expression, size_t arrow);
+    EvalResult filterValue(const EvalResult& value, const std::vector<std::string>& args);
+    std::vector<EvalResult> evaluateArgs(const std::vector<std::string>& args);
+    std::string expandInterpolation(const std::string& expression, std::vector<EvalResult>& operands);
+    EvalResult renderInterpolation(const InterpolationTemplate& interpolation);
+    std::string expandNativeCalls(const std::string& expression, std::vector<EvalResult>& operands);
+    std::string expandIndexing(const std::string& expression, std::vector<EvalResult>& operands);
+    EvalResult evaluateArrayLiteral(const std::string& expression);
+    void enterFunction(const Function& func, std::vector<EvalResult> args, const CallFrame& frame);
+    void leaveFunction();
 
-    // Style setup
-    void setupStyleRegexes() {
-        if (style == "brackets") {
-            ifRegex = std::regex(R"(^\s*if\s+(.*)\s*\{\s*$)");
-            funcDefRegex = std::regex(R"(^\s*func\s+([a-zA-Z_][a-zA-Z0-9_]*)\s*\((.*?)\)\s*\{\s*$)");
-            closeBlockRegex = std::regex(R"(^\s*\}\s*$)");
-        } else if (style == "end") {
-            ifRegex = std::regex(R"(^\s*if\s+(.*)\s*$)");
-            funcDefRegex = std::regex(R"(^\s*func\s+([a-zA-Z_][a-zA-Z0-9_]*)\s*\((.*?)\)\s*$)");
-            closeBlockRegex = std::regex(R"(^\s*end\s*$)");
+    // Task scheduling
+    bool canSwitchTasks() const;
+    void saveContext(Task& task);
+    void loadContext(Task& task);
+    void wakeBlockedTasks();
+    bool schedule(bool currentRunnable);
+    bool blockCurrentTask(int line);
+    void reportDeadlock(int line);
+    void maybeYield(bool timeSliced);
+    bool finishCurrentTask();
+    void spawnTask(const Statement& statement, const std::string& assignTarget, bool declareTarget);
+    void startParallelTask(const Function& func, std::vector<EvalResult> args, Task& task);
+    void reapChannelThreads();
+    void stopChannelThreads();
+    void collectParallelTasks();
+    EvalResult runIsolated(const Function& func, const std::vector<EvalResult>& args);
+    bool handleAwait(const std::string& expression, const std::string& assignTarget, bool declareTarget);
+
+    // Channels
+    std::shared_ptr<Channel> findChannel(const EvalResult& handle);
+    std::shared_ptr<Channel> evaluateChannel(const std::string& expression);
+    void handleSend(const Statement& statement);
+    bool handleReceive(const std::string& channelList, const std::string& timeout,
+                       const std::string& indexTarget, const std::string& valueTarget, bool declareValue);
+    void handleSleep(const std::string& expression);
+    void startCommand(const std::string& command);
+
+    // Every variable is created through here, so reset() knows which globals are new
+    Variable& declareVariable(const std::string& name) {
+        Variable& var = variables.emplace(name, Variable(name, scopeLevel)).first->second;
+        if (hasCheckpoint && scopeLevel == 0) {
+            createdGlobals.push_back(name);
         }
+        return var;
     }
 
-public:
-    // Constructor loads file into vector
-    ExecutionEngine(const std::string& filename) {
-        fileName = filename;
-        std::ifstream file(filename);
-        if (!file.is_open()) {
-            throw std::runtime_error("Failed to open script file: " + filename);
+    // The handle's variable, unless reset() may have removed it since
+    Variable& checkedGlobal(GlobalHandle handle) const {
+        if (handle.sinceCheckpoint && handle.epoch != checkpointEpoch) {
+            throw std::runtime_error("GlobalHandle of a global declared since the checkpoint used after "
+                                     "checkpoint() or reset(); get it again with getGlobal()");
+        }
+        return *handle.variable;
+    }
+
+    // Call before changing a variable: saves a global's checkpoint value on its first write
+    Variable& writeVariable(Variable& var) {
+        if (hasCheckpoint && var.scopeLevel == 0 && !var.saved) {
+            undoLog.push_back(SavedValue{ &var, var.value, var.type, var.array, var.table, var.text, var.symbol });
+            var.saved = true;
         }
+        return var;
+    }
 
-        // Add a dummy empty string at index 0 so line 1 is at index 1
-        sourceCode.push_back("");
+    // Runs the current line's typed code; false if it has none, or if the line has to be evaluated as text after all
+    bool runTypedCode(TypedValue& result) {
+        const TypedCode* code = program->typedCode(programCounter);
+        return code != nullptr && code->run(variables, result);
+    }
 
-        std::string line;
-        while (std::getline(file, line)) {
-            sourceCode.push_back(line);
+    /**
+     * @brief Reports the names the compiler couldn't resolve, except the globals the host defined
+     * under them, and remembers their lines. Only the first call reports anything.
+     */
+    void reportNameErrors(std::ostream& report) {
+        if (reportedNameErrors) {
+            return;
         }
-        file.close();
+        auto lines = std::make_shared<std::vector<bool>>(program->size(), false);
+        for (const NameError& error : program->nameErrors()) {
+            auto it = variables.find(error.name);
+            if (it == variables.end() || it->second.scopeLevel != 0) {
+                report << error.message << std::endl;
+                (*lines)[error.line] = true;
+            }
+        }
+        reportedNameErrors = std::move(lines);
+    }
+
+    // Where undefined names are reported: nowhere, on a line whose undefined names were reported before it ran
+    std::ostream& nameErrorOutput() {
+        bool reported = reportedNameErrors && programCounter > 0 && programCounter < program->size() &&
+                        (*reportedNameErrors)[programCounter];
+        return reported ? discardedErrors : *errorOutput;
+    }
+
+    bool isCallable(const std::string& name) const {
+        return program->findFunction(name) != nullptr || natives.count(name) > 0 || builtins().count(name) > 0;
+    }
+
+    bool callHostFunction(const std::string& name, const std::vector<EvalResult>& args, EvalResult& result);
 
-        // Add a dummy empty string at the end
-        sourceCode.push_back("");
+    // Handlers
+    bool handleIfStatement(const Statement& statement);
+    bool handleCall(const Statement& statement, const std::string& assignTarget, bool declareTarget);
+    void handleCsvOpen(const std::string& readerName, const std::string& expression, const std::string& typeList);
+    void handleCsvRead(const std::string& readerName, const std::string& targetList);
+    void bindVariable(const std::string& name, EvalResult result);
 
-        setupStyleRegexes();
+    // Converts C++ arguments of call() to script values
+    template <typename T>
+    static EvalResult toEvalResult(const T& value) {
+        if constexpr (std::is_same_v<T, EvalResult>) return value;
+        else if constexpr (std::is_same_v<T, bool>) return EvalResult::fromBool(value);
+        else if constexpr (std::is_integral_v<T>) return EvalResult::fromInt(value);
+        else if constexpr (std::is_floating_point_v<T>) return EvalResult::fromFloat(value);
+        else return EvalResult::fromString(std::string(value));
     }
 
-    // Destructor
-    ~ExecutionEngine() {}
+public:
+    // Compiles the file, then builds an engine for it
+    explicit ExecutionEngine(const std::string& filename)
+        : ExecutionEngine(Program::fromFile(filename)) {}
 
-    void registerFunction(std::string name, std::vector<std::string> parameters, int startingLine) {
-        if (scopeLevel == 0)
-            functions.emplace(name, Function(name, parameters, startingLine));
-        else
-            std::cerr << "Error: Function declarations are only allowed in the global scope." << std::endl;
+    // Shares an already compiled program. Nothing is parsed here.
+    explicit ExecutionEngine(std::shared_ptr<const Program> compiled)
+        : program(std::move(compiled)) {
+        if (!program) {
+            throw std::runtime_error("ExecutionEngine requires a compiled program");
+        }
     }
 
+    // Destructor
+    ~ExecutionEngine() { stopChannelThreads(); }
+
     void removeVariablesByScope() {
         // Iterate through the map safely, handling element deletion.
         for (auto it = variables.begin(); it != variables.end(); ) {
@@ -145,373 +309,2870 @@ public:
             removeVariablesByScope(); 
             scopeLevel--;
         } else {
-            std::cout << "Warning: Attempted to decrement scope below 0." << std::endl;
+            *output << "Warning: Attempted to decrement scope below 0." << std::endl;
         }
     }
 
+    void setOutput(std::ostream& stream) { output = &stream; }
+    void setErrorOutput(std::ostream& stream) { errorOutput = &stream; }
+    void setInput(std::istream& stream) { input = &stream; }
+
+    // Runs the script from the current line until it ends
     void run() {
-        std::string line;
-        std::smatch match;
-
-        // Loop iterates through the vector using programCounter
-        while (programCounter < sourceCode.size()) {
-            line = sourceCode[programCounter];
-
-            // Set STYLE
-            if (std::regex_match(line, match, styleRegex)) {
-                std::string styleInput = match[1];
-                if (styleInput == "brackets") {
-                    style = "brackets";
-                    setupStyleRegexes();
+        reportNameErrors(*errorOutput);
+        halted = false;
+        execute();
+        stopChannelThreads();  // Any still running were left behind by END or a deadlock
+    }
+
+    /**
+     * @brief Marks the current state (usually right after run() finished the top-level
+     * initialization) as the state reset() returns to.
+     * Must be called outside of any function, at scope 0.
+     */
+    void checkpoint() {
+        if (scopeLevel != 0 || !callStack.empty()) {
+            throw std::runtime_error("checkpoint() must be called at global scope");
+        }
+        if (!tasks.empty()) {
+            throw std::runtime_error("checkpoint() must be called while no tasks are running");
+        }
+        for (const SavedValue& saved : undoLog) {
+            saved.variable->saved = false;
+        }
+        undoLog.clear();
+        createdGlobals.clear();
+        openedReaders.clear();
+        openedChannels.clear();
+        checkpointEpoch++;
+
+        hasCheckpoint = true;
+        checkpointCounter = programCounter;
+        checkpointHalted = halted;
+    }
+
+    /**
+     * @brief Returns to the last checkpoint.
+     * Only the globals written or declared since then are touched, so the cost is proportional
+     * to what the last run changed rather than to the size of the script's state.
+     * CSV readers opened since the checkpoint are closed; readers opened before it keep
+     * their current position. Channels created since the checkpoint are released.
+     */
+    void reset() {
+        if (!hasCheckpoint) {
+            throw std::runtime_error("reset() requires a checkpoint()");
+        }
+
+        // Drop the tasks the last run left behind, then leave any function or block it stopped in
+        stopChannelThreads();
+        tasks.clear();
+        readyQueue.clear();
+        currentTask = 0;
+        unfinishedTasks = 0;
+        callStack.clear();
+        functionDepth = 0;
+        while (scopeLevel > 0) {
+            decrementScope();
+        }
+
+        for (SavedValue& saved : undoLog) {
+            saved.variable->value.swap(saved.value);
+            saved.variable->type.swap(saved.type);
+            saved.variable->array.swap(saved.array);
+            saved.variable->table.swap(saved.table);
+            saved.variable->text.swap(saved.text);
+            std::swap(saved.variable->symbol, saved.symbol);
+            saved.variable->unboxedType = ValueType::Unknown;
+            saved.variable->saved = false;
+        }
+        undoLog.clear();
+
+        for (const std::string& name : createdGlobals) {
+            variables.erase(name);
+        }
+        createdGlobals.clear();
+        checkpointEpoch++;
+
+        for (const std::string& name : openedReaders) {
+            csvReaders.erase(name);
+        }
+        openedReaders.clear();
+
+        for (int id : openedChannels) {
+            channels.erase(id);
+        }
+        openedChannels.clear();
+
+        programCounter = checkpointCounter;
+        halted = checkpointHalted;
+        hostReturned = false;
+        hasReturnValue = false;
+        returnValue = EvalResult();
+    }
+
+    // --- Snapshots ---
+
+    /**
+     * @brief Writes the compiled program and the complete interpreter state (variables,
+     * scopes, call stack and current line) to a file.
+     * Native functions and open CSV readers are not part of a snapshot, and it can't be
+     * taken while spawned tasks are running.
+     */
+    void writeSnapshot(const std::string& filename) const;
+
+    // Builds an engine that continues exactly where the snapshot was taken
+    static std::unique_ptr<ExecutionEngine> loadSnapshot(const std::string& filename);
+
+    // --- Embedding API ---
+
+    // Makes a C++ function callable from scripts as name(args). Script functions take precedence.
+    void registerNative(const std::string& name, NativeFunction function) {
+        natives[name] = std::move(function);
+    }
+
+    FunctionHandle getFunction(const std::string& name) const {
+        return FunctionHandle{ program->findFunction(name) };
+    }
+
+    /**
+     * @brief Calls a script function and runs it until it returns.
+     * @return The value of its 'return' statement, or an "empty" result if it returned nothing.
+     */
+    EvalResult call(FunctionHandle handle, const std::vector<EvalResult>& args);
+
+    // call() with C++ arguments: integers, floating point numbers, bools, strings or EvalResults
+    template <typename... Args>
+    EvalResult callWith(FunctionHandle handle, const Args&... args) {
+        return call(handle, std::vector<EvalResult>{ toEvalResult(args)... });
+    }
+
+    // Returns an invalid handle if no global of that name exists (yet)
+    GlobalHandle getGlobal(const std::string& name) {
+        auto it = variables.find(name);
+        if (it == variables.end() || it->second.scopeLevel != 0) {
+            return GlobalHandle{};
+        }
+        bool sinceCheckpoint = std::find(createdGlobals.begin(), createdGlobals.end(), name) != createdGlobals.end();
+        return GlobalHandle{ &it->second, sinceCheckpoint, checkpointEpoch };
+    }
+
+    // Declares a global from C++. Returns an invalid handle if the name is taken.
+    GlobalHandle defineGlobal(const std::string& name, const EvalResult& value) {
+        if (variables.find(name) != variables.end()) {
+            return GlobalHandle{};
+        }
+        int savedScope = scopeLevel;
+        scopeLevel = 0;
+        Variable& var = declareVariable(name);
+        scopeLevel = savedScope;
+        var.setValue(value);
+        return GlobalHandle{ &var, hasCheckpoint, checkpointEpoch };
+    }
+
+    EvalResult getValue(GlobalHandle handle) const {
+        return checkedGlobal(handle).getAsResult();
+    }
+
+    template <typename T>
+    void setValue(GlobalHandle handle, const T& value) {
+        writeVariable(checkedGlobal(handle)).setValue(toEvalResult(value));
+    }
+
+};
+
+void ExecutionEngine::execute() {
+    // Loop iterates through the compiled statements using programCounter
+    while (!halted) {
+        // The running task (or the program) reached its end: switch to the next task, if any
+        if (programCounter >= program->size()) {
+            if (tasks.empty() || !finishCurrentTask()) {
+                break;
+            }
+            continue;
+        }
+        const Statement& statement = program->at(programCounter);
+
+        switch (statement.kind) {
+        case StatementKind::Empty:
+        case StatementKind::Comment:
+        case StatementKind::Style:  // Styles are applied at compile time
+        case StatementKind::Unknown:  // Unhandled line simply skips
+            programCounter++;
+            break;
+
+        // End program
+        case StatementKind::End:
+            *output << "\nProgram execution terminated by END command.\n";
+            halted = true;
+            return;
+
+        // Close block
+        case StatementKind::CloseBlock:
+            if (scopeLevel == 1 && functionDepth > 0) {
+                if (callStack.empty()) {
+                    *errorOutput << "Runtime Error on line " << programCounter << std::endl;
+                    halted = true;
+                    return;
                 }
-                if (styleInput == "end") {
-                    style = "end";
-                    setupStyleRegexes();
+                hasReturnValue = false;
+                leaveFunction();
+                break;
+            } else if (scopeLevel > 0) {
+                decrementScope();
+            } else {
+                // Error handling for an unexpected '}' if you need it
+                *errorOutput << "Syntax Error on line " << programCounter << ": Unexpected closing brace '}' or end statement 'end'." << std::endl;
+            }
+            programCounter++;
+            break;
+
+        // Function returns
+        case StatementKind::Return:
+        case StatementKind::ReturnValue:
+            if (callStack.empty()) {
+                *errorOutput << "Runtime Error on line " << programCounter << ": 'return' called outside of a function." << std::endl;
+                halted = true;
+                return;
+            }
+
+            hasReturnValue = false;
+            if (statement.kind == StatementKind::ReturnValue) {
+                // Evaluated before the function's variables are cleared
+                EvalResult result = evaluateExpression(statement.args[0]);
+                if (result.type != "error") {
+                    returnValue = std::move(result);
+                    hasReturnValue = true;
+                } else {
+                    *errorOutput << "Runtime Error on line " << programCounter << ": " << result.value << std::endl;
                 }
+            }
+            leaveFunction();
+            break;
 
-                programCounter++;
-                continue;
+        // Function declarations are collected at compile time; skip the body
+        case StatementKind::FunctionDef:
+            if (scopeLevel != 0) {
+                *errorOutput << "Error: Function declarations are only allowed in the global scope." << std::endl;
             }
-            // Skip comments
-            if (!line.empty() && line[0] == '#') {
+            if (statement.blockEnd != -1) {
+                jumpToLine(statement.blockEnd + 1);
+            } else {
                 programCounter++;
-                continue;
             }
+            break;
+
+        // GOTO. Backward jumps form the script's loops, so they're where long-running tasks yield.
+        case StatementKind::Goto: {
+            int target = std::stoi(statement.args[0]);
+            int from = programCounter;
+            jumpToLine(target);
+            if (target <= from) {
+                maybeYield(true);
+            }
+            break;
+        }
 
-            // Ignore line
-            if (ignoreLine) {
-                ignoreLine = false;
+        case StatementKind::If:
+            // Store whether we jumped
+            if (!handleIfStatement(statement)) {
                 programCounter++;
-                continue;
             }
+            break;
 
-            // End program
-            if (std::regex_match(line, match, endRegex)) {
-                std::cout << "\nProgram execution terminated by END command.\n";
-                return;
-            } 
+        case StatementKind::Declaration: {
+            const std::string& varName = statement.args[0];
 
-            // Skip empty lines
-            if (line.empty() || std::regex_match(line, std::regex(R"(^\s*$)"))) {
-                programCounter++;
-                continue;
+            // Ensure variable exists (or create it)
+            bool exists = variables.find(varName) != variables.end();
+            if (exists) {
+                // Variable already exists, print an error and skip the rest of the block
+                *errorOutput << "Compilation Error: Cannot redeclare variable '" << varName 
+                        << "'. A variable with that name already exists." << std::endl;
             }
 
-            // Close block
-            if (std::regex_match(line, match, closeBlockRegex)) {
-                if (scopeLevel == 1 && functionDepth > 0) {
-                    if (returnStack.empty()) {
-                        std::cerr << "Runtime Error on line " << programCounter << std::endl;
-                        return;
-                    }
-                    
-                    jumpToLine(returnStack.back());
-                    returnStack.pop_back();
-                    
-                    // Only decrement scope if leaving the outermost function call
-                    if (functionDepth > 0) {
-                        if (functionDepth == 1) {
-                            decrementScope();  // This call clears function variables
-                        }
-                        functionDepth--;
-                    }
-                    
-                    continue;
-                } else if (scopeLevel > 0) {
-                    decrementScope();
-                } else {
-                    // Error handling for an unexpected '}' if you need it
-                    std::cerr << "Syntax Error on line " << programCounter << ": Unexpected closing brace '}' or end statement 'end'." << std::endl;
-                }
+            if (statement.isSpawn) {
+                spawnTask(statement, varName, true);
                 programCounter++;
-                continue;
+                break;
             }
-
-            // Function returns
-            if (std::regex_match(line, match, returnRegex)) {
-                if (returnStack.empty()) {
-                    std::cerr << "Runtime Error on line " << programCounter << ": 'return' called outside of a function." << std::endl;
-                    return;
+            if (statement.isAwait) {
+                if (!handleAwait(statement.args[1], varName, true)) {
+                    programCounter++;
                 }
-                
-                jumpToLine(returnStack.back());
-                returnStack.pop_back();
-                
-                // Only decrement scope if leaving the outermost function call
-                if (functionDepth > 0) {
-                    if (functionDepth == 1) {
-                        decrementScope();  // This call clears function variables
-                    }
-                    functionDepth--;
+                break;
+            }
+            if (statement.isRecv) {
+                if (!handleReceive(statement.args[1], "", "", varName, true)) {
+                    programCounter++;
                 }
-                
-                continue;
+                break;
             }
 
-            if (std::regex_match(line, match, returnExpRegex)) {
-                // Return with expression--not yet implemented
+            // var x = f(...) binds the return value when f returns
+            if (!statement.callee.empty() && isCallable(statement.callee)) {
+                if (!handleCall(statement, varName, true)) {
+                    programCounter++;
+                }
+                break;
+            }
+            if (!exists) {
+                declareVariable(varName);
+            }
+            TypedValue typed;
+            if (runTypedCode(typed)) {
+                typed.storeIn(writeVariable(variables.at(varName)));
+                programCounter++;
+                break;
             }
 
-            // FUNCTION LOGIC
-            // Handle function declaration
-            if (std::regex_match(line, match, funcDefRegex)) {
-                std::string funcName = match[1].str();
-                std::string paramsString = match[2].str();
-                
-                std::vector<std::string> params = splitAndTrimArgs(paramsString);
+            // Substitute and Evaluate
+            EvalResult result = evaluateExpression(statement.args[1]);
 
-                registerFunction(funcName, params, programCounter);
+            // Store result
+            if (result.type != "error") {
+                writeVariable(variables.at(varName)).setValue(std::move(result));
+            } else {
+                *errorOutput << "Runtime Error on line: '" << statement.text << "'. " << result.value << std::endl;
+            }
+            programCounter++;
+            break;
+        }
 
-                int endLine = findBlockEnd(programCounter + 1);
-                if (endLine != -1) {
-                    jumpToLine(endLine + 1);
-                }
+        case StatementKind::Assignment: {
+            const std::string& varName = statement.args[0];
 
-                continue;
+            // Check for declaration
+            if (variables.find(varName) == variables.end()) {
+                nameErrorOutput() << "Name Error: Variable '" << varName << "' used before declaration." << std::endl;
+                programCounter++;
+                break;
             }
 
-            // GOTO
-            if (std::regex_match(line, match, gotoRegex)) {
-                int targetLine = std::stoi(match[1].str());
-                jumpToLine(targetLine);
-                continue;
+            if (statement.isSpawn) {
+                spawnTask(statement, varName, false);
+                programCounter++;
+                break;
             }
-            
-            // STEP 1: Handle I/O Operations (Input Function)
-            line = handleInputCall(line, variables);
-
-            // STEP 2: Handle if statements
-            if (std::regex_match(line, match, ifRegex)) {
-                // Store whether we jumped
-                bool jumped = handleIfStatement(line);
-
-                if (!jumped) {
+            if (statement.isAwait) {
+                if (!handleAwait(statement.args[1], varName, false)) {
                     programCounter++;
                 }
-                continue;
+                break;
             }
-            
-            // STEP 3: Handle Declarations, Assignments, execs, and Prints
-            if (std::regex_match(line, match, declarationRegex)) {
-                std::string varName = match[1].str();
-                std::string expression = match[2].str();
-                
-                // Ensure variable exists (or create it)
-                if (variables.find(varName) != variables.end()) {
-                    // Variable already exists, print an error and skip the rest of the block
-                    std::cerr << "Compilation Error: Cannot redeclare variable '" << varName 
-                            << "'. A variable with that name already exists." << std::endl;
-                } else {
-                    variables.emplace(varName, Variable(varName, scopeLevel));
+            if (statement.isRecv) {
+                if (!handleReceive(statement.args[1], "", "", varName, false)) {
+                    programCounter++;
                 }
-                
-                // Substitute and Evaluate
-                std::string substitutedExpr = findAndReplaceVariables(expression, variables);
-                EvalResult result = eval.evaluate(substitutedExpr);
-                
-                // Store result
-                if (result.type != "error") {
-                    variables.at(varName).setValue(result);
-                } else {
-                    std::cerr << "Runtime Error on line: '" << line << "'. " << result.value << std::endl;
+                break;
+            }
+
+            if (!statement.callee.empty() && isCallable(statement.callee)) {
+                if (!handleCall(statement, varName, false)) {
+                    programCounter++;
                 }
+                break;
+            }
+            TypedValue typed;
+            if (runTypedCode(typed)) {
+                typed.storeIn(writeVariable(variables.at(varName)));
+                programCounter++;
+                break;
+            }
 
-            } else if (std::regex_match(line, match, assignmentRegex)) {
-                std::string varName = match[1].str();
-                std::string expression = match[2].str();
+            // Substitute and Evaluate
+            EvalResult result = evaluateExpression(statement.args[1]);
 
-                // Check for declaration
-                if (variables.find(varName) == variables.end()) {
-                    std::cerr << "Name Error: Variable '" << varName << "' used before declaration." << std::endl;
-                    continue; 
-                }
-                
-                // Substitute and Evaluate
-                std::string substitutedExpr = findAndReplaceVariables(expression, variables);
-                EvalResult result = eval.evaluate(substitutedExpr);
-                
-                // Store result
-                if (result.type != "error") {
-                    variables.at(varName).setValue(result);
-                } else {
-                    std::cerr << "Runtime Error on line: '" << line << "'. " << result.value << std::endl;
-                }
-                
-            } else if (std::regex_match(line, match, printRegex) || std::regex_match(line, match, printlnRegex)) {
-                std::string expression = match[1].str();
-                bool isPrintln = (line.find("println") != std::string::npos);
+            // Store result
+            if (result.type != "error") {
+                writeVariable(variables.at(varName)).setValue(std::move(result));
+            } else {
+                *errorOutput << "Runtime Error on line: '" << statement.text << "'. " << result.value << std::endl;
+            }
+            programCounter++;
+            break;
+        }
 
-                // Substitute and evaluate
-                std::string substitutedExpr = findAndReplaceVariables(expression, variables);
-                EvalResult result = eval.evaluate(substitutedExpr);
+        case StatementKind::Print:
+        case StatementKind::Println: {
+            // Substitute and evaluate
+            EvalResult result = evaluateExpression(statement.args[0]);
 
-                // Handle output
-                if (result.type != "error") {
-                    std::cout << result.asString();
-                    if (isPrintln) {
-                        std::cout << "\n";
-                    }
-                } else {
-                    std::cerr << "Runtime Error in print statement: " << result.value << std::endl;
+            // Handle output
+            if (result.type != "error") {
+                *output << result.asString();
+                if (statement.kind == StatementKind::Println) {
+                    *output << "\n";
                 }
-            } else if (std::regex_match(line, match, execRegex)) {
-                std::string expression = match[1].str();
+            } else {
+                *errorOutput << "Runtime Error in print statement: " << result.value << std::endl;
+            }
+            programCounter++;
+            break;
+        }
 
-                // Substitute and evaluate
-                std::string substitutedExpr = findAndReplaceVariables(expression, variables);
-                EvalResult result = eval.evaluate(substitutedExpr);
+        case StatementKind::Exec: {
+            // Substitute and evaluate
+            EvalResult result = evaluateExpression(statement.args[0]);
 
-                // Run command
-                if (result.type != "error") {
-                    std::system(result.asString().c_str());
-                } else {
-                    std::cerr << "Runtime Error in print statement: " << result.value << std::endl;
-                }
+            // Run command. With other tasks around, it runs in the background while they continue.
+            programCounter++;
+            if (result.type == "error") {
+                *errorOutput << "Runtime Error in exec statement: " << result.value << std::endl;
+            } else if (canSwitchTasks()) {
+                startCommand(result.asString());
+            } else {
+                runCommand(result.asString());
             }
-            // Function call logic
-            if (std::regex_match(line, match, funcCallRegex)) {
-                std::string funcName = match[1].str();
-                std::string argsString = match[2].str();
-
-                if (functions.count(funcName)) {
-                    while (scopeLevel > 0) {
-                        decrementScope();  // Wipe scope variables
-                    }
-                    incrementScope();
-                    functionDepth++;
-
-                    const Function& func = functions.at(funcName);
-                    returnStack.push_back(programCounter + 1);
-                    
-                    // Handle Parameters/Arguments
-                    std::vector<std::string> callArgs = splitAndTrimArgs(argsString);
-                    const std::vector<std::string>& funcParams = func.parameters;
-                    
-                    for (size_t i = 0; i < funcParams.size(); ++i) {
-                        std::string paramName = funcParams[i];
-                        EvalResult result;
-                        
-                        if (i < callArgs.size() && !callArgs[i].empty()) {
-                            std::string substitutedArg = findAndReplaceVariables(callArgs[i], variables);
-                            result = eval.evaluate(substitutedArg);
-                        } else {
-                            result.type = "number";
-                            result.value = "0";
-                        }
-                        
-                        if (variables.find(paramName) == variables.end()) {
-                            variables.emplace(paramName, Variable(paramName, scopeLevel));
-                            
-                            if (result.type != "error") {
-                                variables.at(paramName).setValue(result);
-                            } else {
-                                variables.at(paramName).setValue({ "number", "0" });
-                                std::cerr << "Runtime Warning on line " << programCounter << ": Failed to evaluate argument for parameter '" 
-                                          << paramName << "'. Defaulting to 0." << std::endl;
-                            }
-                        } else {
-                            std::cerr << "Runtime Error on line " << programCounter << ": Function parameter '" << paramName 
-                                      << "' conflicts with existing variable in the current scope." << std::endl;
-                        }
-                    }
-
-                    // Goto function body
-                    jumpToLine(func.startingLine + 1); 
-                    continue;
+            break;
+        }
 
-                } else {
-                    std::cerr << "Name Error on line " << programCounter << ": Function '" << funcName << "' is not defined." << std::endl;
-                }
+        case StatementKind::CsvOpen:
+            handleCsvOpen(statement.args[0], statement.args[1], statement.args[2]);
+            programCounter++;
+            break;
+
+        case StatementKind::CsvRead:
+            handleCsvRead(statement.args[0], statement.args[1]);
+            programCounter++;
+            maybeYield(false);
+            break;
+
+        // snapshot "file": save the state and continue; --resume starts from the next line
+        case StatementKind::Snapshot: {
+            EvalResult path = evaluateExpression(statement.args[0]);
+            programCounter++;
+            if (path.type == "error") {
+                *errorOutput << "Runtime Error in snapshot statement: " << path.value << std::endl;
+                break;
+            }
+            try {
+                writeSnapshot(path.asString());
+            } catch (const std::exception& e) {
+                *errorOutput << "Runtime Error on line " << programCounter - 1 << ": " << e.what() << std::endl;
+            }
+            break;
+        }
+
+        // Function call logic
+        case StatementKind::Call:
+            if (!handleCall(statement, "", false)) {
+                programCounter++;
+            }
+            break;
+
+        case StatementKind::Spawn:
+            spawnTask(statement, "", false);
+            programCounter++;
+            break;
+
+        case StatementKind::Await:
+            if (!handleAwait(statement.args[0], "", false)) {
+                programCounter++;
+            }
+            break;
+
+        case StatementKind::Sleep:
+            programCounter++;
+            handleSleep(statement.args[0]);
+            break;
+
+        case StatementKind::Send:
+            handleSend(statement);
+            break;
+
+        case StatementKind::Recv:
+            if (!handleReceive(statement.args[0], "", "", "", false)) {
+                programCounter++;
+            }
+            break;
+
+        // select i, x from a, b [timeout ms]
+        case StatementKind::Select:
+            if (!handleReceive(statement.args[2], statement.args[3], statement.args[0], statement.args[1], true)) {
+                programCounter++;
+            }
+            break;
+
+        case StatementKind::Close:
+            if (std::shared_ptr<Channel> channel = evaluateChannel(statement.args[0])) {
+                channel->close();
             }
-            // Unhandled line simply skips
             programCounter++;
+            break;
+        }
+
+        // Reading input may block, so let the other tasks run first
+        if (statement.readsInput && !halted) {
+            maybeYield(false);
+        }
+
+        if (hostReturned) {
+            hostReturned = false;
+            return;
         }
     }
-};
+}
 
 void ExecutionEngine::jumpToLine(int targetLine) {
-    if (targetLine >= 0 && targetLine < sourceCode.size()) {
+    if (targetLine >= 0 && targetLine < program->size()) {
         programCounter = targetLine;
     } else {
-        std::cerr << "Critical Error: Jump to invalid line " << targetLine << std::endl;
-        std::exit(EXIT_FAILURE);
+        // Thrown rather than exiting, so other engines in the process keep running
+        throw std::runtime_error("Critical Error: Jump to invalid line " + std::to_string(targetLine));
     }
 }
 
-int ExecutionEngine::findBlockEnd(int startLine) {
-    int currentLine = startLine;
-    int nestedLevel = 1; // We assume we are inside the block already
+// Runs a shell command. When the engine's output is redirected, the command's output is captured into it.
+void ExecutionEngine::runCommand(const std::string& command) {
+    if (output == &std::cout) {
+        std::cout.flush();
+        std::system(command.c_str());
+        return;
+    }
+
+    FILE* pipe = popen(command.c_str(), "r");
+    if (pipe == nullptr) {
+        *errorOutput << "Runtime Error on line " << programCounter << ": Failed to run '" << command << "'" << std::endl;
+        return;
+    }
+    char buffer[4096];
+    size_t count;
+    while ((count = std::fread(buffer, 1, sizeof(buffer), pipe)) > 0) {
+        output->write(buffer, count);
+    }
+    pclose(pipe);
+}
 
-    // Loop through sourceCode vector
-    while (currentLine < sourceCode.size() && nestedLevel > 0) {
-        std::string line = sourceCode[currentLine];
+// Substitutes interpolated strings, input, native calls, array elements and variables, then evaluates.
+// A bare variable, an array literal or a single native call is already a value and skips the Evaluator.
+// Arrays reach the Evaluator as operands ($0, $1, ...).
+EvalResult ExecutionEngine::evaluateExpression(const std::string& expression) {
+    if (expression.find("->") != std::string::npos) {
+        size_t arrow = findTopLevel(expression, "->");
+        if (arrow != std::string::npos) {
+            return evaluatePipe(expression, arrow);
+        }
+    }
 
-        // Brace Counting Logic
-        if (style == "brackets") {
-            for (char c : line) {
-                if (c == '{') {
-                    nestedLevel++;
-                } else if (c == '}') {
-                    nestedLevel--;
-                    if (nestedLevel == 0) {
-                        return currentLine; 
-                    }
-                }
-            }
-        } else if (style == "end") {
-            // Detect block openers
-            if (std::regex_match(line, funcDefRegex) ||
-                std::regex_match(line, ifRegex))
-            {
-                nestedLevel++;
+    size_t first = expression.find_first_not_of(" \t");
+    size_t last = expression.find_last_not_of(" \t");
+    if (first != std::string::npos) {
+        if (expression[first] == '[' && findClosing(expression, first) == last) {
+            return evaluateArrayLiteral(expression.substr(first + 1, last - first - 1));
+        }
+        size_t open = expression.find('(', first);
+        if (expression[last] == ')' && open != std::string::npos && findClosing(expression, open) == last) {
+            size_t nameEnd = expression.find_last_not_of(" \t", open - 1);
+            std::string name = expression.substr(first, nameEnd - first + 1);
+            EvalResult result;
+            if (isFunctionName(name) && program->findFunction(name) == nullptr
+                && callHostFunction(name, evaluateArgs(splitAndTrimArgs(expression.substr(open + 1, last - open - 1))), result)) {
+                return result;
             }
-            // Detect block close
-            else if (std::regex_match(line, closeBlockRegex)) {
-                nestedLevel--;
+        }
+        auto it = (first == 0 && last + 1 == expression.length()) ? variables.find(expression)
+                                                                    : variables.find(expression.substr(first, last - first + 1));
+        if (it != variables.end()) {
+            return it->second.getAsResult();
+        }
+    }
 
-                if (nestedLevel == 0) {
-                    return currentLine;
-                }
+    // Nested evaluations (call arguments, indexes) add their operands after ours and remove them when done
+    size_t operandsMark = operands.size();
+    std::string processed = handleInputCall(expandInterpolation(expression, operands), variables, *input);
+    processed = expandNativeCalls(processed, operands);
+    processed = expandIndexing(processed, operands);
+    std::string substitutedExpr = findAndReplaceVariables(processed, variables, nameErrorOutput(), &operands);
+    EvalResult result = eval.evaluate(substitutedExpr, operands);
+    operands.resize(operandsMark);
+    return result;
+}
+
+/**
+ * @brief value -> stage -> stage ...: every stage gets the value of the previous one.
+ * filter(condition) keeps the elements for which the condition is true, with x standing for the element
+ * (for a table, filter or where keeps the rows, and column names stand for the row's values).
+ * The condition is evaluated once, over the whole array, so it runs on the vector kernels and the kept
+ * elements are copied by a branch-free compaction loop. Any other stage is a native or built-in function,
+ * called with the value as its first argument: a -> push(4) is push(a, 4) and a -> sum is sum(a).
+ */
+EvalResult ExecutionEngine::evaluatePipe(const std::string& expression, size_t arrow) {
+    EvalResult value = evaluateExpression(expression.substr(0, arrow));
+    while (arrow != std::string::npos && value.type != "error") {
+        size_t next = findTopLevel(expression, "->", arrow + 2);
+        std::string stage = trimmed(expression.substr(arrow + 2, next == std::string::npos ? std::string::npos : next - arrow - 2));
+        arrow = next;
+
+        size_t open = stage.find('(');
+        std::string name = trimmed(stage.substr(0, open));
+        std::vector<std::string> argTexts;
+        if (open != std::string::npos) {
+            if (findClosing(stage, open) != stage.length() - 1) {
+                return EvalResult("Syntax Error: Invalid pipe stage '" + stage + "'", "error");
             }
+            argTexts = splitAndTrimArgs(stage.substr(open + 1, stage.length() - open - 2));
+        }
+        if ((name == "filter" || name == "where") && program->findFunction(name) == nullptr && natives.count(name) == 0) {
+            value = filterValue(value, argTexts);
+            continue;
         }
 
-        currentLine++;
+        std::vector<EvalResult> args = evaluateArgs(argTexts);
+        args.insert(args.begin(), value);
+        EvalResult result;
+        if (!isFunctionName(name) || program->findFunction(name) != nullptr || !callHostFunction(name, args, result)) {
+            return EvalResult("'" + name + "' can't be used in a pipe: only filter() and native or built-in functions can", "error");
+        }
+        value = std::move(result);
     }
-
-    std::cerr << "Syntax Error: Unmatched opening brace starting near line " << startLine - 1 << std::endl;
-    return -1; 
+    return value;
 }
 
-// Method inside ExecutionEngine
-bool ExecutionEngine::handleIfStatement(const std::string& line) {
-    std::smatch match;
+// The filter(condition) and where(condition) stages of a pipe. For an array, x in the condition is the
+// whole array; for a table, every column's name is that column. Either way they're passed as operands.
+EvalResult ExecutionEngine::filterValue(const EvalResult& value, const std::vector<std::string>& args) {
+    if ((value.type != "array" && value.type != "table") || args.size() != 1) {
+        return EvalResult("filter() expects an array or a table, and a condition", "error");
+    }
+    size_t operandsMark = operands.size();
+    std::map<std::string, std::string> names;
+    if (value.type == "array") {
+        names["x"] = "$" + std::to_string(operands.size());
+        operands.push_back(value);
+    } else {
+        for (size_t i = 0; i < value.table->columns.size(); ++i) {
+            names[value.table->names[i]] = "$" + std::to_string(operands.size());
+            operands.push_back(EvalResult::fromArray(value.table->columns[i]));
+        }
+    }
+    EvalResult mask = evaluateExpression(replaceIdentifiers(args[0], names));
+    operands.resize(operandsMark);
 
-    if (!std::regex_match(line, match, ifRegex)) {
-        std::cerr << "Internal Error: Called handleIfStatement with invalid line format." << std::endl;
-        return false; // Did not jump
+    size_t rows = value.type == "array" ? value.size() : value.table->rowCount();
+    std::vector<uint8_t> constant;
+    const uint8_t* bytes = nullptr;
+    if (mask.type == "bool") {
+        constant.assign(rows, mask.asBool() ? 1 : 0);
+        bytes = constant.data();
+    } else if (mask.type == "array" && mask.size() == rows && (mask.array->kind == ArrayData::Kind::Bool || rows == 0)) {
+        bytes = mask.array->bools.data();
+    } else if (mask.type == "error") {
+        return mask;
+    } else {
+        return EvalResult("filter() needs a condition that is true or false for every element", "error");
     }
-    
-    std::string conditionExpression = match[1].str();
-    std::string substitutedCond = findAndReplaceVariables(conditionExpression, variables); 
-    EvalResult conditionResult = eval.evaluate(substitutedCond);
+    return value.type == "array" ? EvalResult::fromArray(value.array->filtered(bytes)) : EvalResult::fromTable(value.table->filtered(bytes));
+}
 
-    if (conditionResult.type == "error") {
-        std::cerr << "Runtime Error on line " << programCounter << ": " << conditionResult.value << std::endl;
-        return false; 
+// Evaluates call arguments. Bare variables are read directly and function names are passed by name.
+std::vector<EvalResult> ExecutionEngine::evaluateArgs(const std::vector<std::string>& args) {
+    std::vector<EvalResult> results;
+    results.reserve(args.size());
+    for (const std::string& arg : args) {
+        auto it = variables.find(arg);
+        if (it != variables.end()) {
+            results.push_back(it->second.getAsResult());
+        } else if (isVariableName(arg) && isCallable(arg)) {
+            results.push_back(EvalResult(arg, "function"));
+        } else {
+            results.push_back(evaluateExpression(arg));
+        }
     }
+    return results;
+}
 
-    // If condition is FALSE, jump past the block
-    if (conditionResult.asBool() == false) {     
-        int blockStartLine = programCounter + 1;
-        int blockEndLine = findBlockEnd(blockStartLine); 
+/**
+ * @brief Replaces string literals with ${} interpolations inside an expression with the rendered strings.
+ * The literals' templates were parsed when the Program was compiled; a literal built at run time
+ * is parsed on the spot. The rendered strings are added to 'operands'.
+ */
+std::string ExecutionEngine::expandInterpolation(const std::string& expression, std::vector<EvalResult>& operands) {
+    if (expression.find("${") == std::string::npos) {
+        return expression;
+    }
 
-        if (blockEndLine != -1) {
-            jumpToLine(blockEndLine + 1); 
-            return true; // <--- WE JUMPED
+    std::string processed;
+    size_t i = 0;
+    while (i < expression.length()) {
+        size_t open = expression.find('"', i);
+        size_t close = open == std::string::npos ? open : findStringEnd(expression, open);
+        if (close == std::string::npos) {
+            // No more literals, or an unterminated one the Evaluator reports
+            processed.append(expression, i, std::string::npos);
+            break;
+        }
+        processed.append(expression, i, open - i);
+        i = close + 1;
+
+        std::string_view body(expression.data() + open + 1, close - open - 1);
+        if (body.find("${") == std::string_view::npos) {
+            processed.append(expression, open, close - open + 1);
+            continue;
+        }
+        const InterpolationTemplate* interpolation = program->findInterpolation(body);
+        InterpolationTemplate parsed;
+        if (interpolation == nullptr) {
+            parsed = parseInterpolation(body);
+            interpolation = &parsed;
+        }
+        EvalResult rendered = renderInterpolation(*interpolation);
+        if (rendered.type == "error") {
+            *errorOutput << "Runtime Error on line " << programCounter << ": " << rendered.value << std::endl;
+            processed += "0";
+        } else {
+            processed += literalText(rendered, &operands);
         }
-    } else {
-        incrementScope();
     }
-    
-    return false; // <--- WE DID NOT JUMP
-}
\ No newline at end of file
+    return processed;
+}
+
+// Evaluates the template's expressions, then writes the string into a buffer allocated once
+EvalResult ExecutionEngine::renderInterpolation(const InterpolationTemplate& interpolation) {
+    if (!interpolation.error.empty()) {
+        return EvalResult(interpolation.error, "error");
+    }
+
+    std::vector<EvalResult> values;
+    values.reserve(interpolation.expressionCount);
+    size_t length = interpolation.literalLength;
+    for (const InterpolationTemplate::Segment& segment : interpolation.segments) {
+        if (!segment.isExpression) {
+            continue;
+        }
+        EvalResult value;
+        auto it = segment.isVariable ? variables.find(segment.text) : variables.end();
+        if (it != variables.end()) {
+            value = it->second.getAsResult();
+        } else if (segment.isVariable) {
+            nameErrorOutput() << "Substitution Error: Undefined variable '" << segment.text << "' used in interpolation." << std::endl;
+            value = EvalResult::fromInt(0);
+        } else {
+            value = evaluateExpression(segment.text);
+            if (value.type == "error") {
+                return value;
+            }
+        }
+        if (value.type == "array" || value.type == "table") {
+            value = EvalResult::fromString(value.asString());
+        }
+        length += value.type == "string" ? value.stringView().length() : value.value.length();
+        values.push_back(std::move(value));
+    }
+
+    std::string text;
+    text.reserve(length);
+    size_t next = 0;
+    for (const InterpolationTemplate::Segment& segment : interpolation.segments) {
+        if (!segment.isExpression) {
+            text += segment.text;
+        } else {
+            const EvalResult& value = values[next++];
+            text += value.type == "string" ? value.stringView() : std::string_view(value.value);
+        }
+    }
+    return EvalResult::fromString(std::move(text));
+}
+
+/**
+ * @brief Replaces calls to native functions inside an expression with their results.
+ * Works like handleInputCall: the result is written back as a literal the Evaluator understands.
+ */
+std::string ExecutionEngine::expandNativeCalls(const std::string& expression, std::vector<EvalResult>& operands) {
+    if (natives.empty() && expression.find('(') == std::string::npos) {
+        return expression;
+    }
+
+    std::string processed;
+    bool inStringLiteral = false;
+    size_t i = 0;
+    while (i < expression.length()) {
+        char c = expression[i];
+        if (c == '"') {
+            inStringLiteral = !inStringLiteral;
+        }
+        if (inStringLiteral || !(std::isalpha(c) || c == '_')) {
+            processed += c;
+            i++;
+            continue;
+        }
+
+        // Read an identifier and look for an opening parenthesis after it
+        size_t start = i;
+        while (i < expression.length() && (std::isalnum(expression[i]) || expression[i] == '_')) i++;
+        std::string name = expression.substr(start, i - start);
+        size_t open = i;
+        while (open < expression.length() && expression[open] == ' ') open++;
+
+        bool isHostFunction = natives.count(name) > 0 || builtins().count(name) > 0;
+        if (!isHostFunction || open == expression.length() || expression[open] != '(' || program->findFunction(name) != nullptr) {
+            processed += name;
+            continue;
+        }
+
+        // Find the matching parenthesis, skipping string literals
+        size_t close = open;
+        int depth = 0;
+        bool quoted = false;
+        for (; close < expression.length(); ++close) {
+            if (expression[close] == '"') quoted = !quoted;
+            if (quoted) continue;
+            if (expression[close] == '(') depth++;
+            if (expression[close] == ')' && --depth == 0) break;
+        }
+        if (close == expression.length()) {
+            processed += name;
+            continue;
+        }
+
+        EvalResult result;
+        callHostFunction(name, evaluateArgs(splitAndTrimArgs(expression.substr(open + 1, close - open - 1))), result);
+        if (result.type == "error") {
+            *errorOutput << "Runtime Error on line " << programCounter << ": " << result.value << std::endl;
+            processed += "0";
+        } else {
+            processed += literalText(result, &operands);
+        }
+        i = close + 1;
+    }
+    return processed;
+}
+
+// [a, b, c]: every element is an expression
+EvalResult ExecutionEngine::evaluateArrayLiteral(const std::string& elements) {
+    std::vector<EvalResult> items;
+    for (const std::string& element : splitAndTrimArgs(elements)) {
+        EvalResult item = evaluateExpression(element);
+        if (item.type == "error") {
+            return item;
+        }
+        items.push_back(item.interned());
+    }
+    return EvalResult::fromArray(std::move(items));
+}
+
+/**
+ * @brief Replaces a[i] (and a[i][j], a[mask], t["column"]) inside an expression with the element, and array literals with their value.
+ * Works like expandNativeCalls: the element is written back as a literal the Evaluator understands.
+ */
+std::string ExecutionEngine::expandIndexing(const std::string& expression, std::vector<EvalResult>& operands) {
+    if (expression.find('[') == std::string::npos) {
+        return expression;
+    }
+
+    std::string processed;
+    bool inStringLiteral = false;
+    size_t i = 0;
+    while (i < expression.length()) {
+        char c = expression[i];
+        if (c == '"') {
+            inStringLiteral = !inStringLiteral;
+        }
+        size_t close = c == '[' && !inStringLiteral ? findClosing(expression, i) : std::string::npos;
+        if (close != std::string::npos) {
+            EvalResult array = evaluateArrayLiteral(expression.substr(i + 1, close - i - 1));
+            if (array.type == "error") {
+                *errorOutput << "Runtime Error on line " << programCounter << ": " << array.value << std::endl;
+                processed += "0";
+            } else {
+                processed += literalText(array, &operands);
+            }
+            i = close + 1;
+            continue;
+        }
+        if (inStringLiteral || !(std::isalpha(c) || c == '_')) {
+            processed += c;
+            i++;
+            continue;
+        }
+
+        size_t start = i;
+        while (i < expression.length() && (std::isalnum(expression[i]) || expression[i] == '_')) i++;
+        std::string name = expression.substr(start, i - start);
+        auto var = variables.find(name);
+        if (var == variables.end() || (var->second.type != "array" && var->second.type != "table") || i == expression.length() || expression[i] != '[') {
+            processed += name;
+            continue;
+        }
+
+        EvalResult element = var->second.getAsResult();
+        while (i < expression.length() && expression[i] == '[') {
+            size_t close = findClosing(expression, i);
+            if (close == std::string::npos) {
+                break;
+            }
+            EvalResult index = evaluateExpression(expression.substr(i + 1, close - i - 1));
+            i = close + 1;
+            if (element.type == "table" && index.type == "string") {
+                // t["name"]: a column
+                int column = element.table->findColumn(index.asString());
+                if (column < 0) {
+                    *errorOutput << "Index Error on line " << programCounter << ": '" << name << "' has no column '"
+                                 << index.asString() << "'." << std::endl;
+                    element = EvalResult("0", "int");
+                } else {
+                    element = EvalResult::fromArray(element.table->columns[column]);
+                }
+            } else if (element.type == "array" && index.type == "array" && index.size() == element.size()
+                && (index.array->kind == ArrayData::Kind::Bool || index.size() == 0)) {
+                // a[mask]: the elements where the mask is true
+                element = EvalResult::fromArray(element.array->filtered(index.array->bools.data()));
+            } else if (element.type != "array" || index.type != "int") {
+                *errorOutput << "Type Error on line " << programCounter
+                             << ": Arrays are indexed with an int, or a bool array of the same size." << std::endl;
+                element = EvalResult("0", "int");
+            } else if (index.asInt() < 0 || static_cast<size_t>(index.asInt()) >= element.size()) {
+                *errorOutput << "Index Error on line " << programCounter << ": Index " << index.value
+                          << " is out of range for '" << name << "' (size " << element.size() << ")." << std::endl;
+                element = EvalResult("0", "int");
+            } else {
+                element = element.array->at(static_cast<size_t>(index.asInt()));
+            }
+        }
+        processed += literalText(element, &operands);
+    }
+    return processed;
+}
+
+// Wipes the caller's local scopes, binds the parameters and jumps into the function body
+// The arguments are moved into the parameters, so a string or array argument is never copied
+void ExecutionEngine::enterFunction(const Function& func, std::vector<EvalResult> args, const CallFrame& frame) {
+    while (scopeLevel > 0) {
+        decrementScope();  // Wipe scope variables
+    }
+    incrementScope();
+    functionDepth++;
+
+    callStack.push_back(frame);
+    hasReturnValue = false;
+
+    // Handle Parameters/Arguments
+    for (size_t i = 0; i < func.parameters.size(); ++i) {
+        const std::string& paramName = func.parameters[i];
+
+        if (variables.find(paramName) != variables.end()) {
+            *errorOutput << "Runtime Error on line " << programCounter << ": Function parameter '" << paramName 
+                      << "' conflicts with existing variable in the current scope." << std::endl;
+            continue;
+        }
+
+        Variable& param = declareVariable(paramName);
+        if (i >= args.size()) {
+            param.setValue(EvalResult("0", "int"));
+        } else if (args[i].type != "error") {
+            param.setValue(std::move(args[i]));
+        } else {
+            param.setValue(EvalResult("0", "int"));
+            *errorOutput << "Runtime Warning on line " << programCounter << ": Failed to evaluate argument for parameter '" 
+                      << paramName << "'. Defaulting to 0." << std::endl;
+        }
+    }
+
+    // Goto function body
+    jumpToLine(func.startingLine + 1);
+}
+
+// Returns to the caller, delivering the return value to the frame's target variable
+void ExecutionEngine::leaveFunction() {
+    CallFrame frame = callStack.back();
+    callStack.pop_back();
+
+    if (frame.hostCall) {
+        programCounter = frame.returnLine;
+        hostReturned = true;
+    } else if (frame.taskRoot) {
+        programCounter = frame.returnLine;  // The end of the program: the task is finished
+    } else {
+        jumpToLine(frame.returnLine);
+    }
+
+    // Only decrement scope if leaving the outermost function call
+    if (functionDepth > 0) {
+        if (functionDepth == 1) {
+            decrementScope();  // This call clears function variables
+        }
+        functionDepth--;
+    }
+
+    if (!frame.assignTarget.empty()) {
+        EvalResult result = std::move(returnValue);
+        if (!hasReturnValue) {
+            *errorOutput << "Runtime Warning: Function did not return a value for '" << frame.assignTarget << "'. Defaulting to 0." << std::endl;
+            result = EvalResult("0", "int");
+        }
+
+        if (frame.declareTarget) {
+            bindVariable(frame.assignTarget, std::move(result));
+        } else if (variables.find(frame.assignTarget) != variables.end()) {
+            writeVariable(variables.at(frame.assignTarget)).setValue(std::move(result));
+        } else {
+            *errorOutput << "Name Error: Variable '" << frame.assignTarget << "' no longer exists." << std::endl;
+        }
+    }
+}
+
+/**
+ * @brief Calls the statement's callee.
+ * Script functions are entered (the return value goes to assignTarget when they return);
+ * native functions run immediately.
+ * @return true if execution jumped into a script function.
+ */
+bool ExecutionEngine::handleCall(const Statement& statement, const std::string& assignTarget, bool declareTarget) {
+    const std::string& funcName = statement.callee;
+
+    if (const Function* func = program->findFunction(funcName)) {
+        // Arguments are evaluated before the caller's scope is wiped
+        std::vector<EvalResult> args = evaluateArgs(statement.callArgs);
+        CallFrame frame{ programCounter + 1, assignTarget, declareTarget, false };
+        enterFunction(*func, std::move(args), frame);
+        return true;
+    }
+
+    EvalResult result;
+    if (natives.count(funcName) > 0 || builtins().count(funcName) > 0) {
+        std::vector<EvalResult> args = evaluateArgs(statement.callArgs);
+
+        // a = push(a, x): a's old value is about to be replaced, so it lets go of its array first.
+        // If nothing else shares the array, push() can then append to it instead of copying it.
+        Variable* updated = nullptr;
+        auto builtin = builtins().find(funcName);
+        if (natives.count(funcName) == 0 && builtin->second.updatesFirst && !declareTarget
+            && !statement.callArgs.empty() && statement.callArgs[0] == assignTarget && variables.count(assignTarget) > 0) {
+            updated = &writeVariable(variables.at(assignTarget));
+            updated->array.reset();
+        }
+
+        callHostFunction(funcName, args, result);
+        if (result.type == "error") {
+            if (updated != nullptr) {
+                updated->array = args[0].array;
+            }
+            *errorOutput << "Runtime Error on line " << programCounter << ": " << result.value << std::endl;
+        } else if (!assignTarget.empty()) {
+            bindVariable(assignTarget, std::move(result));
+        }
+        return false;
+    }
+
+    *errorOutput << "Name Error on line " << programCounter << ": Function '" << funcName << "' is not defined." << std::endl;
+    return false;
+}
+
+EvalResult ExecutionEngine::call(FunctionHandle handle, const std::vector<EvalResult>& args) {
+    if (!handle) {
+        throw std::runtime_error("call() requires a valid function handle");
+    }
+
+    int savedCounter = programCounter;
+    int savedFunctionDepth = functionDepth;
+    size_t savedStackSize = callStack.size();
+    bool wasHalted = halted;
+    halted = false;
+
+    reportNameErrors(*errorOutput);
+    enterFunction(*handle.function, args, CallFrame{ programCounter, "", false, true });
+    execute();
+
+    // An END inside the function leaves its frames behind
+    if (callStack.size() > savedStackSize) {
+        callStack.resize(savedStackSize);
+        while (scopeLevel > 0) {
+            decrementScope();
+        }
+        functionDepth = savedFunctionDepth;
+        programCounter = savedCounter;
+    }
+    halted = wasHalted;
+
+    return hasReturnValue ? returnValue : EvalResult();
+}
+
+static void saveTable(SnapshotWriter& out, const TableData& table);
+static std::shared_ptr<const TableData> loadTable(SnapshotReader& in);
+
+// Arrays are written as their kind and size, then the unboxed values or, for mixed arrays,
+// every element after its type; nested arrays and tables recursively
+static void saveArray(SnapshotWriter& out, const ArrayData& array) {
+    out.u32(static_cast<uint32_t>(array.kind));
+    out.u32(static_cast<uint32_t>(array.size()));
+    switch (array.kind) {
+    case ArrayData::Kind::Int:
+        for (long long value : array.ints) out.u64(static_cast<uint64_t>(value));
+        break;
+    case ArrayData::Kind::Float:
+        for (double value : array.floats) {
+            uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            out.u64(bits);
+        }
+        break;
+    case ArrayData::Kind::Bool:
+        for (uint8_t value : array.bools) out.flag(value != 0);
+        break;
+    case ArrayData::Kind::Mixed:
+        for (const EvalResult& item : array.items) {
+            out.str(item.stringView());
+            out.str(item.type);
+            if (item.type == "array") {
+                saveArray(out, *item.array);
+            } else if (item.type == "table") {
+                saveTable(out, *item.table);
+            }
+        }
+        break;
+    }
+}
+
+static std::shared_ptr<const ArrayData> loadArray(SnapshotReader& in) {
+    auto array = std::make_shared<ArrayData>();
+    uint32_t kind = in.u32();
+    if (kind > static_cast<uint32_t>(ArrayData::Kind::Bool)) {
+        throw std::runtime_error("Snapshot Error: Corrupt array");
+    }
+    array->kind = static_cast<ArrayData::Kind>(kind);
+    size_t count = in.u32();
+    switch (array->kind) {
+    case ArrayData::Kind::Int:
+        array->ints.resize(count);
+        for (long long& value : array->ints) value = static_cast<long long>(in.u64());
+        break;
+    case ArrayData::Kind::Float:
+        array->floats.resize(count);
+        for (double& value : array->floats) {
+            uint64_t bits = in.u64();
+            std::memcpy(&value, &bits, sizeof(value));
+        }
+        break;
+    case ArrayData::Kind::Bool:
+        array->bools.resize(count);
+        for (uint8_t& value : array->bools) value = in.flag() ? 1 : 0;
+        break;
+    case ArrayData::Kind::Mixed:
+        array->items.resize(count);
+        for (EvalResult& item : array->items) {
+            item.value = std::string(in.str());
+            item.type = std::string(in.str());
+            if (item.type == "string") {
+                item = EvalResult::fromSymbol(intern(item.value));
+            } else if (item.type == "array") {
+                item.array = loadArray(in);
+            } else if (item.type == "table") {
+                item.table = loadTable(in);
+            }
+        }
+        break;
+    }
+    return array;
+}
+
+// Tables are written as their columns' names and arrays, then the groupBy() columns
+static void saveTable(SnapshotWriter& out, const TableData& table) {
+    out.strings32(table.names);
+    for (const std::shared_ptr<const ArrayData>& column : table.columns) {
+        saveArray(out, *column);
+    }
+    out.u32(static_cast<uint32_t>(table.groupKeys.size()));
+    for (size_t key : table.groupKeys) {
+        out.u32(static_cast<uint32_t>(key));
+    }
+}
+
+static std::shared_ptr<const TableData> loadTable(SnapshotReader& in) {
+    auto table = std::make_shared<TableData>();
+    table->names = in.strings32();
+    for (size_t i = 0; i < table->names.size(); ++i) {
+        table->columns.push_back(loadArray(in));
+    }
+    table->groupKeys.resize(in.u32());
+    for (size_t& key : table->groupKeys) {
+        key = in.u32();
+        if (key >= table->columns.size()) {
+            throw std::runtime_error("Snapshot Error: Corrupt table");
+        }
+    }
+    return table;
+}
+
+void ExecutionEngine::writeSnapshot(const std::string& filename) const {
+    for (const CallFrame& frame : callStack) {
+        if (frame.hostCall) {
+            throw std::runtime_error("Snapshot Error: Cannot snapshot inside a call from C++");
+        }
+    }
+    if (!tasks.empty()) {
+        throw std::runtime_error("Snapshot Error: Cannot snapshot while tasks are running");
+    }
+    if (!csvReaders.empty()) {
+        *errorOutput << "Warning: Open CSV readers are not saved in snapshots." << std::endl;
+    }
+    if (!channels.empty()) {
+        *errorOutput << "Warning: Channels are not saved in snapshots." << std::endl;
+    }
+
+    SnapshotWriter out;
+    program->save(out);
+
+    out.i32(programCounter);
+    out.i32(scopeLevel);
+    out.i32(functionDepth);
+
+    out.u32(static_cast<uint32_t>(variables.size()));
+    for (const auto& entry : variables) {
+        const Variable& var = entry.second;
+        out.str(var.name);
+        out.str(var.stringView());
+        out.str(var.type);
+        if (var.type == "array") {
+            saveArray(out, *var.array);
+        } else if (var.type == "table") {
+            saveTable(out, *var.table);
+        }
+        out.i32(var.scopeLevel);
+    }
+
+    out.u32(static_cast<uint32_t>(callStack.size()));
+    for (const CallFrame& frame : callStack) {
+        out.i32(frame.returnLine);
+        out.str(frame.assignTarget);
+        out.flag(frame.declareTarget);
+    }
+
+    out.writeToFile(filename);
+}
+
+std::unique_ptr<ExecutionEngine> ExecutionEngine::loadSnapshot(const std::string& filename) {
+    SnapshotReader in(filename);
+    std::unique_ptr<ExecutionEngine> engine(new ExecutionEngine(Program::load(in)));
+
+    engine->programCounter = in.i32();
+    engine->scopeLevel = in.i32();
+    engine->functionDepth = in.i32();
+    if (engine->programCounter < 0 || engine->programCounter > engine->program->size()) {
+        throw std::runtime_error("Snapshot Error: Invalid line in " + filename);
+    }
+
+    uint32_t variableCount = in.u32();
+    for (uint32_t i = 0; i < variableCount; ++i) {
+        std::string name(in.str());
+        std::string_view value = in.str();
+        std::string_view type = in.str();
+        std::shared_ptr<const ArrayData> array;
+        std::shared_ptr<const TableData> table;
+        if (type == "array") {
+            array = loadArray(in);
+        } else if (type == "table") {
+            table = loadTable(in);
+        }
+        Variable var(name, in.i32());
+        if (type == "string") {
+            var.setValue(EvalResult::fromString(std::string(value)));
+        } else {
+            var.value.assign(value.data(), value.size());
+            var.type.assign(type.data(), type.size());
+        }
+        var.array = std::move(array);
+        var.table = std::move(table);
+        engine->variables.emplace(name, std::move(var));
+    }
+
+    uint32_t frameCount = in.u32();
+    for (uint32_t i = 0; i < frameCount; ++i) {
+        CallFrame frame;
+        frame.returnLine = in.i32();
+        frame.assignTarget = std::string(in.str());
+        frame.declareTarget = in.flag();
+        engine->callStack.push_back(frame);
+    }
+
+    // The engine that wrote the snapshot already reported them
+    engine->reportNameErrors(engine->discardedErrors);
+    return engine;
+}
+
+// Method inside ExecutionEngine
+bool ExecutionEngine::handleIfStatement(const Statement& statement) {
+    TypedValue typed;
+    bool condition;
+    if (runTypedCode(typed)) {
+        condition = typed.integer != 0;
+    } else {
+        EvalResult conditionResult = evaluateExpression(statement.args[0]);
+
+        if (conditionResult.type == "error") {
+            *errorOutput << "Runtime Error on line " << programCounter << ": " << conditionResult.value << std::endl;
+            return false; 
+        }
+        condition = conditionResult.asBool();
+    }
+
+    // If condition is FALSE, jump past the block
+    if (condition == false) {     
+        if (statement.blockEnd != -1) {
+            jumpToLine(statement.blockEnd + 1); 
+            return true; // <--- WE JUMPED
+        }
+    } else {
+        incrementScope();
+    }
+    
+    return false; // <--- WE DID NOT JUMP
+}
+
+// Declares the variable in the current scope if needed, then stores the result
+void ExecutionEngine::bindVariable(const std::string& name, EvalResult result) {
+    if (variables.find(name) == variables.end()) {
+        declareVariable(name);
+    }
+    writeVariable(variables.at(name)).setValue(std::move(result));
+}
+
+// csv feed = "prices.csv" [as int, float, string]
+void ExecutionEngine::handleCsvOpen(const std::string& readerName, const std::string& expression, const std::string& typeList) {
+    EvalResult path = evaluateExpression(expression);
+    if (path.type == "error") {
+        *errorOutput << "Runtime Error on line " << programCounter << ": " << path.value << std::endl;
+        return;
+    }
+
+    std::string filename = path.asString();
+    bool isTsv = filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".tsv") == 0;
+
+    try {
+        csvReaders.erase(readerName);
+        auto it = csvReaders.emplace(std::piecewise_construct, std::forward_as_tuple(readerName),
+                                     std::forward_as_tuple(filename, isTsv ? '\t' : ',')).first;
+        if (hasCheckpoint) {
+            openedReaders.push_back(readerName);
+        }
+        if (!typeList.empty()) {
+            it->second.setColumnTypes(splitAndTrimArgs(typeList));
+        }
+    } catch (const std::exception& e) {
+        csvReaders.erase(readerName);
+        *errorOutput << "Runtime Error on line " << programCounter << ": " << e.what() << std::endl;
+        return;
+    }
+
+    // The reader's variable tells the script whether a record is available
+    bindVariable(readerName, EvalResult("false", "bool"));
+}
+
+// read feed [into a, b, c]
+void ExecutionEngine::handleCsvRead(const std::string& readerName, const std::string& targetList) {
+    auto it = csvReaders.find(readerName);
+    if (it == csvReaders.end()) {
+        *errorOutput << "Name Error on line " << programCounter << ": CSV reader '" << readerName << "' is not open." << std::endl;
+        return;
+    }
+    CsvReader& reader = it->second;
+
+    bool hasRecord = reader.readRecord();
+    bindVariable(readerName, EvalResult(hasRecord ? "true" : "false", "bool"));
+    if (!hasRecord) {
+        return;
+    }
+
+    // Positional binding, or one variable per header column
+    std::vector<std::string> targets = targetList.empty() ? reader.getColumnNames() : splitAndTrimArgs(targetList);
+    for (size_t i = 0; i < targets.size(); ++i) {
+        if (!isVariableName(targets[i])) {
+            *errorOutput << "Name Error on line " << programCounter << ": '" << targets[i] << "' is not a valid variable name." << std::endl;
+            continue;
+        }
+        if (variables.find(targets[i]) == variables.end()) {
+            declareVariable(targets[i]);
+        }
+        Variable& var = writeVariable(variables.at(targets[i]));
+        reader.fieldInto(i, var.value, var.type);
+        var.array.reset();
+        var.table.reset();
+        var.text.reset();
+        var.symbol.reset();
+        var.unboxedType = ValueType::Unknown;
+    }
+}
+
+// --- Tasks ---
+
+// Switching is only possible once something was spawned, and never inside a call from C++,
+// which has to return to its caller on the same task
+bool ExecutionEngine::canSwitchTasks() const {
+    if (unfinishedTasks == 0) {
+        return false;
+    }
+    for (const CallFrame& frame : callStack) {
+        if (frame.hostCall) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Moves the running task's state, including its local variables, out of the engine
+void ExecutionEngine::saveContext(Task& task) {
+    task.programCounter = programCounter;
+    task.scopeLevel = scopeLevel;
+    task.functionDepth = functionDepth;
+    task.callStack = std::move(callStack);
+    task.returnValue = returnValue;
+    task.hasReturnValue = hasReturnValue;
+    callStack.clear();
+
+    task.locals.clear();
+    for (auto it = variables.begin(); it != variables.end(); ) {
+        if (it->second.scopeLevel > 0) {
+            if (!task.finished) {
+                task.locals.push_back(std::move(it->second));
+            }
+            it = variables.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void ExecutionEngine::loadContext(Task& task) {
+    programCounter = task.programCounter;
+    scopeLevel = task.scopeLevel;
+    functionDepth = task.functionDepth;
+    callStack = std::move(task.callStack);
+    returnValue = task.returnValue;
+    hasReturnValue = task.hasReturnValue;
+    task.callStack.clear();
+
+    for (Variable& local : task.locals) {
+        std::string name = local.name;
+        if (!variables.emplace(name, std::move(local)).second) {
+            *errorOutput << "Runtime Warning: Local variable '" << name << "' of task " << task.id
+                      << " is hidden by a global declared while it was suspended." << std::endl;
+        }
+    }
+    task.locals.clear();
+
+    if (!task.pendingOutput.empty()) {
+        *output << task.pendingOutput;
+        task.pendingOutput.clear();
+    }
+}
+
+// Makes every blocked task whose timer expired, command completed or awaited task finished ready again
+void ExecutionEngine::wakeBlockedTasks() {
+    collectParallelTasks();
+    auto now = std::chrono::steady_clock::now();
+    for (auto& entry : tasks) {
+        Task& task = entry.second;
+        bool ready = false;
+        switch (task.waitingFor) {
+        case Task::Wait::None:
+            break;
+        case Task::Wait::Sleep:
+            ready = now >= task.wakeTime;
+            break;
+        case Task::Wait::Command:
+            ready = task.command.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+            if (ready) {
+                try {
+                    task.pendingOutput = task.command.get();
+                } catch (const std::exception& e) {
+                    *errorOutput << "Runtime Error in exec statement: " << e.what() << std::endl;
+                }
+            }
+            break;
+        case Task::Wait::Task:
+            ready = tasks.at(task.awaitedTask).finished;
+            break;
+        case Task::Wait::Channel:
+            if (task.sending) {
+                // The blocked send completes here; the task resumes after it
+                ready = task.channels[0]->trySend(task.outgoing);
+                if (!ready && task.channels[0]->isClosed()) {
+                    *errorOutput << "Runtime Error: Task " << task.id << " sent on a closed channel." << std::endl;
+                    ready = true;
+                }
+            } else {
+                for (const std::shared_ptr<Channel>& channel : task.channels) {
+                    ready = ready || channel->canRecv();
+                }
+                if (!ready && task.hasDeadline && now >= task.wakeTime) {
+                    task.timedOut = true;
+                    ready = true;
+                }
+            }
+            break;
+        }
+        if (ready) {
+            task.waitingFor = Task::Wait::None;
+            task.channels.clear();
+            readyQueue.push_back(task.id);
+        }
+    }
+}
+
+/**
+ * @brief Suspends the running task and resumes the next ready one.
+ * If nothing is ready, waits for the earliest sleep to expire or a command to complete.
+ * @param currentRunnable Whether the running task goes back into the ready queue (a yield)
+ * rather than blocking on its waitingFor condition.
+ * @return false if no task can ever run again; the current task's state is then left loaded.
+ */
+bool ExecutionEngine::schedule(bool currentRunnable) {
+    Task& current = tasks.at(currentTask);
+    saveContext(current);
+    if (currentRunnable) {
+        readyQueue.push_back(currentTask);
+    }
+    sliceCount = 0;
+
+    while (true) {
+        wakeBlockedTasks();
+        if (!readyQueue.empty()) {
+            currentTask = readyQueue.front();
+            readyQueue.pop_front();
+            loadContext(tasks.at(currentTask));
+            return true;
+        }
+
+        bool commandsRunning = false;
+        bool sleeping = false;
+        auto wakeTime = std::chrono::steady_clock::time_point::max();
+        const Task* channelWaiter = nullptr;
+        size_t channelWaits = 0;
+        for (const auto& entry : tasks) {
+            const Task& task = entry.second;
+            if (task.waitingFor == Task::Wait::Command || (task.job && !task.finished)) {
+                commandsRunning = true;
+            } else if (task.waitingFor == Task::Wait::Sleep) {
+                sleeping = true;
+                wakeTime = std::min(wakeTime, task.wakeTime);
+            } else if (task.waitingFor == Task::Wait::Channel && (task.hasDeadline || task.waitsOnSharedChannel())) {
+                // Another engine or thread may still use the channel, or the wait times out. A task
+                // waiting only on channels nobody else has can only be woken by the tasks here.
+                channelWaiter = &task;
+                channelWaits += task.channels.size();
+                if (task.hasDeadline) {
+                    wakeTime = std::min(wakeTime, task.wakeTime);
+                }
+            }
+        }
+        if (!commandsRunning && !sleeping && channelWaiter == nullptr) {
+            loadContext(current);
+            return false;
+        }
+        if (cancelled != nullptr && cancelled->load()) {
+            loadContext(current);
+            halted = true;
+            return false;
+        }
+
+        // Commands and parallel tasks are polled. A sleep, or a single channel, can be waited for exactly.
+        auto pollTime = std::chrono::steady_clock::now() + std::chrono::milliseconds(1);
+        auto until = (commandsRunning || channelWaits > 1) ? std::min(wakeTime, pollTime) : wakeTime;
+        if (channelWaiter != nullptr) {
+            channelWaiter->channels[0]->waitUntilReady(channelWaiter->sending, until);
+        } else {
+            std::this_thread::sleep_until(until);
+        }
+    }
+}
+
+/**
+ * @brief Blocks the running task on its waitingFor condition until it can resume.
+ * @return false if no task can ever run again: the deadlock is reported and the engine halts.
+ */
+bool ExecutionEngine::blockCurrentTask(int line) {
+    if (schedule(false)) {
+        return true;
+    }
+    Task& self = tasks.at(currentTask);
+    self.waitingFor = Task::Wait::None;
+    self.channels.clear();
+    reportDeadlock(line);
+    return false;
+}
+
+void ExecutionEngine::reportDeadlock(int line) {
+    *errorOutput << "Runtime Error on line " << line << ": Deadlock, every task is waiting." << std::endl;
+    halted = true;
+}
+
+// A scheduling point: lets the other ready tasks run before the current one continues
+void ExecutionEngine::maybeYield(bool timeSliced) {
+    if (cancelled != nullptr && cancelled->load()) {
+        halted = true;
+        return;
+    }
+    if (!canSwitchTasks() || (timeSliced && ++sliceCount < TIME_SLICE)) {
+        return;
+    }
+    wakeBlockedTasks();
+    if (!readyQueue.empty()) {
+        schedule(true);
+    }
+}
+
+// Called when the running task reaches the end of the program. Returns true if another task took over.
+bool ExecutionEngine::finishCurrentTask() {
+    Task& task = tasks.at(currentTask);
+    task.finished = true;
+    task.result = hasReturnValue ? returnValue : EvalResult("0", "int");
+    if (currentTask != 0) {
+        unfinishedTasks--;
+    }
+
+    if (schedule(false)) {
+        return true;
+    }
+
+    for (const auto& entry : tasks) {
+        if (!entry.second.finished) {
+            *errorOutput << "Runtime Error: Deadlock, task " << entry.first << " is waiting on line "
+                      << entry.second.programCounter << " and can never resume." << std::endl;
+        }
+    }
+    // What the main program (or an isolated task's function) returned
+    returnValue = tasks.at(0).result;
+    hasReturnValue = true;
+
+    tasks.clear();
+    readyQueue.clear();
+    currentTask = 0;
+    unfinishedTasks = 0;
+    return false;
+}
+
+// spawn f(args) / parallel f(args): runs a script function as a new task. The task's handle goes to assignTarget.
+void ExecutionEngine::spawnTask(const Statement& statement, const std::string& assignTarget, bool declareTarget) {
+    const Function* func = program->findFunction(statement.callee);
+    if (func == nullptr) {
+        *errorOutput << "Name Error on line " << programCounter << ": 'spawn' requires a script function call." << std::endl;
+        return;
+    }
+    std::vector<EvalResult> args = evaluateArgs(statement.callArgs);
+
+    if (tasks.empty()) {
+        tasks[0].id = 0;
+        currentTask = 0;
+    }
+    int id = nextTaskId++;
+    Task& task = tasks[id];
+    task.id = id;
+    unfinishedTasks++;
+
+    if (statement.isolated) {
+        startParallelTask(*func, std::move(args), task);
+    } else {
+        task.programCounter = func->startingLine + 1;
+        task.scopeLevel = 1;
+        task.functionDepth = 1;
+        task.callStack.push_back(CallFrame{ program->size(), "", false, false, true });
+
+        for (size_t i = 0; i < func->parameters.size(); ++i) {
+            Variable param(func->parameters[i], 1);
+            if (i < args.size() && args[i].type != "error") {
+                param.setValue(std::move(args[i]));
+            } else {
+                param.setValue(EvalResult("0", "int"));
+            }
+            task.locals.push_back(std::move(param));
+        }
+        readyQueue.push_back(id);
+    }
+
+    if (assignTarget.empty()) {
+        return;
+    }
+    EvalResult handle(std::to_string(id), "task");
+    if (declareTarget) {
+        bindVariable(assignTarget, handle);
+    } else {
+        writeVariable(variables.at(assignTarget)).setValue(handle);
+    }
+}
+
+/**
+ * @brief await t: blocks the running task until task t has finished, then binds its result.
+ * @return true if the task blocked. Its line is then executed again when it resumes.
+ */
+bool ExecutionEngine::handleAwait(const std::string& expression, const std::string& assignTarget, bool declareTarget) {
+    EvalResult handle = evaluateArgs({ expression })[0];
+    if (handle.type != "task") {
+        *errorOutput << "Type Error on line " << programCounter << ": 'await' requires a task, got '" << expression << "'." << std::endl;
+        return false;
+    }
+
+    int id = std::stoi(handle.value);
+    auto it = tasks.find(id);
+    if (it == tasks.end()) {
+        *errorOutput << "Runtime Error on line " << programCounter << ": Task " << id << " no longer exists." << std::endl;
+        return false;
+    }
+
+    if (it->second.finished) {
+        if (!assignTarget.empty()) {
+            if (declareTarget) {
+                bindVariable(assignTarget, it->second.result);
+            } else {
+                writeVariable(variables.at(assignTarget)).setValue(it->second.result);
+            }
+        }
+        return false;
+    }
+
+    if (id == currentTask) {
+        *errorOutput << "Runtime Error on line " << programCounter << ": A task can't await itself." << std::endl;
+        return false;
+    }
+
+    // A parallel task nobody has started yet is run right here. If it's already running and
+    // no green thread is left to switch to, this thread sleeps until it finishes.
+    Task& awaited = it->second;
+    bool greenTasksLeft = false;
+    for (const auto& entry : tasks) {
+        greenTasksLeft = greenTasksLeft || (entry.first != currentTask && !entry.second.finished && !entry.second.job);
+    }
+    if (awaited.job && (!canSwitchTasks() || !greenTasksLeft)) {
+        awaited.job->tryRun();
+        awaited.job->waitUntilDone();
+        collectParallelTasks();
+        return handleAwait(expression, assignTarget, declareTarget);
+    }
+    if (!canSwitchTasks()) {
+        *errorOutput << "Runtime Error on line " << programCounter << ": Cannot await a task inside a call from C++." << std::endl;
+        return false;
+    }
+
+    Task& self = tasks.at(currentTask);
+    self.waitingFor = Task::Wait::Task;
+    self.awaitedTask = id;
+    blockCurrentTask(programCounter);
+    return true;
+}
+
+// sleep ms: suspends the running task. Without tasks, the whole engine sleeps.
+void ExecutionEngine::handleSleep(const std::string& expression) {
+    EvalResult duration = evaluateExpression(expression);
+    if (duration.type != "int" && duration.type != "float") {
+        *errorOutput << "Runtime Error in sleep statement: Expected a number of milliseconds" << std::endl;
+        return;
+    }
+    auto milliseconds = std::chrono::milliseconds(static_cast<long long>(std::stod(duration.value)));
+
+    if (!canSwitchTasks()) {
+        output->flush();
+        std::this_thread::sleep_for(milliseconds);
+        return;
+    }
+
+    Task& self = tasks.at(currentTask);
+    self.waitingFor = Task::Wait::Sleep;
+    self.wakeTime = std::chrono::steady_clock::now() + milliseconds;
+    schedule(false);
+}
+
+// Starts an exec on another thread and blocks the running task until it completes.
+// Its captured output is written when the task resumes.
+void ExecutionEngine::startCommand(const std::string& command) {
+    bool capture = output != &std::cout;
+    if (!capture) {
+        std::cout.flush();
+    }
+
+    Task& self = tasks.at(currentTask);
+    self.command = std::async(std::launch::async, [command, capture]() {
+        if (!capture) {
+            std::system(command.c_str());
+            return std::string();
+        }
+        FILE* pipe = popen(command.c_str(), "r");
+        if (pipe == nullptr) {
+            throw std::runtime_error("Failed to run '" + command + "'");
+        }
+        std::string captured;
+        char buffer[4096];
+        size_t count;
+        while ((count = std::fread(buffer, 1, sizeof(buffer), pipe)) > 0) {
+            captured.append(buffer, count);
+        }
+        pclose(pipe);
+        return captured;
+    });
+    self.waitingFor = Task::Wait::Command;
+    schedule(false);
+}
+
+// Shared by every engine in the process
+static WorkStealingPool& parallelTaskPool() {
+    static WorkStealingPool pool;
+    return pool;
+}
+
+/**
+ * @brief Starts a 'parallel' task: a new engine for the same Program runs the function on a
+ * pool thread, or on a thread of its own, owned by this engine, if it's handed channels. It starts
+ * with an empty heap holding only the parameters; the arguments are moved into it and its return
+ * value is moved back, so large strings are never copied.
+ * Natives are copied to the new engine, so they must be safe to call from any thread.
+ */
+void ExecutionEngine::startParallelTask(const Function& func, std::vector<EvalResult> args, Task& task) {
+    // Channels passed as arguments are handed over with the arguments
+    std::vector<std::shared_ptr<Channel>> handedChannels;
+    for (const EvalResult& arg : args) {
+        if (std::shared_ptr<Channel> channel = findChannel(arg)) {
+            channel->markShared();
+            handedChannels.push_back(channel);
+        }
+    }
+
+    task.job = std::make_shared<ParallelJob>();
+    task.job->body = [program = program, natives = natives, reportedNameErrors = reportedNameErrors, handedChannels,
+                      function = &func, args = std::move(args)](ParallelJob& job) mutable {
+        std::ostringstream jobOutput;
+        std::ostringstream jobErrors;
+        std::istringstream jobInput;
+        try {
+            ExecutionEngine engine(program);
+            engine.natives = std::move(natives);
+            engine.reportedNameErrors = std::move(reportedNameErrors);
+            engine.cancelled = &job.cancelled;
+            engine.setOutput(jobOutput);
+            engine.setErrorOutput(jobErrors);
+            engine.setInput(jobInput);
+            for (const std::shared_ptr<Channel>& channel : handedChannels) {
+                engine.channels[channel->id()] = channel;
+            }
+            job.result = engine.runIsolated(*function, args);
+            if (std::shared_ptr<Channel> channel = engine.findChannel(job.result)) {
+                job.channels.push_back(channel);
+            }
+        } catch (const std::exception& e) {
+            jobErrors << "Execution Fatal Error in parallel task '" << function->name << "': " << e.what() << "\n";
+            job.result = EvalResult("0", "int");
+        }
+        job.output = jobOutput.str();
+        job.errors = jobErrors.str();
+    };
+
+    // A task with channels may wait on them for one that is still queued behind it, so it gets a
+    // thread of its own instead of holding up a pool thread. The engine joins it when it stops.
+    std::shared_ptr<ParallelJob> job = task.job;
+    if (handedChannels.empty()) {
+        parallelTaskPool().submit([job]() { job->tryRun(); });
+    } else {
+        reapChannelThreads();
+        channelThreads.push_back(ChannelThread{ job, std::move(handedChannels), std::thread([job]() { job->tryRun(); }) });
+    }
+}
+
+// Joins the threads of the channel tasks that have finished
+void ExecutionEngine::reapChannelThreads() {
+    auto finished = std::stable_partition(channelThreads.begin(), channelThreads.end(),
+                                          [](const ChannelThread& entry) { return !entry.job->isDone(); });
+    for (auto it = finished; it != channelThreads.end(); ++it) {
+        it->thread.join();
+    }
+    channelThreads.erase(finished, channelThreads.end());
+}
+
+/**
+ * @brief Cancels the channel tasks that are still running and joins their threads.
+ * Closing the channels they were handed wakes any that are blocked on them; they halt at the
+ * next loop or scheduling point. A task blocked only on a channel it looked up by id isn't woken.
+ */
+void ExecutionEngine::stopChannelThreads() {
+    for (ChannelThread& entry : channelThreads) {
+        if (!entry.job->isDone()) {
+            entry.job->cancelled.store(true);
+            for (const std::shared_ptr<Channel>& channel : entry.channels) {
+                channel->close();
+            }
+        }
+    }
+    for (ChannelThread& entry : channelThreads) {
+        entry.thread.join();
+    }
+    channelThreads.clear();
+}
+
+// Finishes every parallel task whose job is done. Their output is written now, in one piece.
+void ExecutionEngine::collectParallelTasks() {
+    for (auto& entry : tasks) {
+        Task& task = entry.second;
+        if (!task.job || task.finished || !task.job->isDone()) {
+            continue;
+        }
+        *output << task.job->output;
+        *errorOutput << task.job->errors;
+        task.result = std::move(task.job->result);
+        for (const std::shared_ptr<Channel>& channel : task.job->channels) {
+            channels[channel->id()] = channel;
+        }
+        task.job.reset();
+        task.finished = true;
+        unfinishedTasks--;
+    }
+}
+
+// Runs one function as this engine's whole program, including any tasks it spawns
+EvalResult ExecutionEngine::runIsolated(const Function& func, const std::vector<EvalResult>& args) {
+    enterFunction(func, args, CallFrame{ program->size(), "", false, false, true });
+    execute();
+    return hasReturnValue ? returnValue : EvalResult("0", "int");
+}
+
+// --- Built-in functions and channels ---
+
+const std::map<std::string, ExecutionEngine::BuiltinInfo>& ExecutionEngine::builtins() {
+    static const std::map<std::string, BuiltinInfo> table = {
+        { "channel", { &ExecutionEngine::builtinChannel, false } },
+        { "format", { &ExecutionEngine::builtinFormat, true } },
+        { "printf", { &ExecutionEngine::builtinPrintf, false } },
+        { "len", { &ExecutionEngine::builtinLen, true } },
+        { "range", { &ExecutionEngine::builtinRange, true } },
+        { "push", { &ExecutionEngine::builtinPush, true, true } },
+        { "sum", { &ExecutionEngine::builtinSum, true } },
+        { "min", { &ExecutionEngine::builtinMin, true } },
+        { "max", { &ExecutionEngine::builtinMax, true } },
+        { "mean", { &ExecutionEngine::builtinMean, true } },
+        { "dot", { &ExecutionEngine::builtinDot, true } },
+        { "table", { &ExecutionEngine::builtinTable, true } },
+        { "readTable", { &ExecutionEngine::builtinReadTable, false } },
+        { "column", { &ExecutionEngine::builtinColumn, true } },
+        { "select", { &ExecutionEngine::builtinSelect, true } },
+        { "groupBy", { &ExecutionEngine::builtinGroupBy, true } },
+        { "count", { &ExecutionEngine::builtinCount, true } },
+        { "avg", { &ExecutionEngine::builtinAvg, true } },
+        { "sort", { &ExecutionEngine::builtinSort, true } },
+        { "sortBy", { &ExecutionEngine::builtinSortBy, true } },
+        { "pmap", { &ExecutionEngine::builtinParallelMap, true } },
+        { "pfilter", { &ExecutionEngine::builtinParallelFilter, true } },
+        { "preduce", { &ExecutionEngine::builtinParallelReduce, true } },
+    };
+    return table;
+}
+
+// Runs a native or built-in function. Returns false if there's none of that name.
+bool ExecutionEngine::callHostFunction(const std::string& name, const std::vector<EvalResult>& args, EvalResult& result) {
+    auto native = natives.find(name);
+    if (native != natives.end()) {
+        result = native->second(args);
+        return true;
+    }
+    auto builtin = builtins().find(name);
+    if (builtin != builtins().end()) {
+        result = (this->*builtin->second.function)(args);
+        return true;
+    }
+    return false;
+}
+
+// channel(capacity): a new bounded channel
+EvalResult ExecutionEngine::builtinChannel(const std::vector<EvalResult>& args) {
+    if (args.size() != 1 || args[0].type != "int" || args[0].asInt() < 1) {
+        return EvalResult("channel() expects a capacity of at least 1", "error");
+    }
+    std::shared_ptr<Channel> channel = ChannelRegistry::create(static_cast<size_t>(args[0].asInt()));
+    channels[channel->id()] = channel;
+    if (hasCheckpoint) {
+        openedChannels.push_back(channel->id());
+    }
+    return EvalResult(std::to_string(channel->id()), "channel");
+}
+
+// Resolves a channel value. A channel created by another engine is kept alive from now on.
+std::shared_ptr<Channel> ExecutionEngine::findChannel(const EvalResult& handle) {
+    if (handle.type != "channel") {
+        return nullptr;
+    }
+    int id = std::stoi(handle.value);
+    auto it = channels.find(id);
+    if (it != channels.end()) {
+        return it->second;
+    }
+    // Looked up by id, so another engine has it too
+    std::shared_ptr<Channel> channel = ChannelRegistry::find(id);
+    if (channel) {
+        channel->markShared();
+        channels[id] = channel;
+        if (hasCheckpoint) {
+            openedChannels.push_back(id);
+        }
+    }
+    return channel;
+}
+
+std::shared_ptr<Channel> ExecutionEngine::evaluateChannel(const std::string& expression) {
+    std::shared_ptr<Channel> channel = findChannel(evaluateArgs({ expression })[0]);
+    if (!channel) {
+        *errorOutput << "Type Error on line " << programCounter << ": '" << expression << "' is not a channel." << std::endl;
+    }
+    return channel;
+}
+
+/**
+ * @brief send ch, value. The value is moved into the channel.
+ * If the channel is full, the task is suspended and the value is delivered as soon as there's
+ * room; without other tasks, the engine's thread waits.
+ */
+void ExecutionEngine::handleSend(const Statement& statement) {
+    int line = programCounter;
+    programCounter++;
+
+    std::shared_ptr<Channel> channel = evaluateChannel(statement.args[0]);
+    if (!channel) {
+        return;
+    }
+    EvalResult value = evaluateExpression(statement.args[1]);
+    if (value.type == "error") {
+        *errorOutput << "Runtime Error in send statement: " << value.value << std::endl;
+        return;
+    }
+
+    while (!channel->trySend(value)) {
+        if (channel->isClosed()) {
+            *errorOutput << "Runtime Error on line " << line << ": Send on a closed channel." << std::endl;
+            return;
+        }
+        if (canSwitchTasks()) {
+            Task& self = tasks.at(currentTask);
+            self.waitingFor = Task::Wait::Channel;
+            self.channels = { channel };
+            self.sending = true;
+            self.hasDeadline = false;
+            self.outgoing = std::move(value);
+            blockCurrentTask(line);
+            return;
+        }
+        if (!channel->isShared()) {
+            // Nothing else can ever receive from it
+            reportDeadlock(line);
+            return;
+        }
+        channel->waitUntilReady(true, std::chrono::steady_clock::time_point::max());
+    }
+}
+
+/**
+ * @brief recv ch, or select i, x from a, b [timeout ms].
+ * Moves the first available value into valueTarget, and the position of its channel into
+ * indexTarget. A select sets the index to -1 on a timeout, or once every channel is closed and drained.
+ * @return true if the task was suspended; the statement runs again when it resumes.
+ */
+bool ExecutionEngine::handleReceive(const std::string& channelList, const std::string& timeout,
+                                    const std::string& indexTarget, const std::string& valueTarget, bool declareValue) {
+    std::vector<std::shared_ptr<Channel>> selected;
+    for (const std::string& expression : splitAndTrimArgs(channelList)) {
+        std::shared_ptr<Channel> channel = evaluateChannel(expression);
+        if (!channel) {
+            return false;
+        }
+        selected.push_back(channel);
+    }
+
+    // Resumed because the deadline of the previous attempt passed, or run again after being woken.
+    // The deadline was set when the statement first ran; running it again doesn't push it back.
+    bool timedOut = false;
+    bool resumed = false;
+    if (!tasks.empty()) {
+        Task& self = tasks.at(currentTask);
+        timedOut = self.timedOut;
+        resumed = self.resumingReceive;
+        self.timedOut = false;
+        self.resumingReceive = false;
+    }
+
+    bool hasDeadline = !timeout.empty();
+    auto deadline = std::chrono::steady_clock::time_point::max();
+    if (hasDeadline && resumed) {
+        deadline = tasks.at(currentTask).wakeTime;
+    } else if (hasDeadline) {
+        EvalResult milliseconds = evaluateExpression(timeout);
+        if (milliseconds.type != "int" && milliseconds.type != "float") {
+            *errorOutput << "Runtime Error on line " << programCounter << ": Expected a timeout in milliseconds." << std::endl;
+            return false;
+        }
+        deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(static_cast<long long>(std::stod(milliseconds.value)));
+    }
+
+    while (true) {
+        for (size_t i = 0; i < selected.size(); ++i) {
+            EvalResult value;
+            if (!selected[i]->tryRecv(value)) {
+                continue;
+            }
+            if (!valueTarget.empty()) {
+                if (declareValue || variables.find(valueTarget) == variables.end()) {
+                    bindVariable(valueTarget, std::move(value));
+                } else {
+                    writeVariable(variables.at(valueTarget)).setValue(std::move(value));
+                }
+            }
+            if (!indexTarget.empty()) {
+                bindVariable(indexTarget, EvalResult::fromInt(static_cast<long long>(i)));
+            }
+            return false;
+        }
+
+        bool drained = true;
+        for (const std::shared_ptr<Channel>& channel : selected) {
+            drained = drained && channel->isDrained();
+        }
+        if (drained || timedOut || std::chrono::steady_clock::now() >= deadline) {
+            if (!indexTarget.empty()) {
+                bindVariable(indexTarget, EvalResult::fromInt(-1));
+            } else {
+                *errorOutput << "Runtime Error on line " << programCounter << ": Receive on a closed channel." << std::endl;
+            }
+            return false;
+        }
+
+        if (canSwitchTasks()) {
+            Task& self = tasks.at(currentTask);
+            self.waitingFor = Task::Wait::Channel;
+            self.channels = selected;
+            self.sending = false;
+            self.hasDeadline = hasDeadline;
+            self.wakeTime = deadline;
+            self.resumingReceive = true;
+            blockCurrentTask(programCounter);
+            return true;
+        }
+
+        bool shared = false;
+        for (const std::shared_ptr<Channel>& channel : selected) {
+            shared = shared || channel->isShared();
+        }
+        if (!shared && !hasDeadline) {
+            // Nothing else can ever send to them
+            reportDeadlock(programCounter);
+            return false;
+        }
+
+        // Nothing else to run on this engine: wait for the channel (or poll several)
+        auto until = selected.size() == 1 ? deadline : std::min(deadline, std::chrono::steady_clock::now() + std::chrono::milliseconds(1));
+        selected[0]->waitUntilReady(false, until);
+    }
+}
+
+// --- Numbers ---
+
+// format(x): x as a string, with as few digits as read back the same. format(x, n): with n decimals.
+// format("%-8s %6.2f", a, b): the values formatted printf-style (see FormatOp).
+EvalResult ExecutionEngine::builtinFormat(const std::vector<EvalResult>& args) {
+    if (!args.empty() && args[0].type == "string") {
+        std::string text;
+        std::string error;
+        if (!formatArgs(args, text, error)) {
+            return EvalResult("format(): " + error, "error");
+        }
+        return EvalResult::fromString(std::move(text));
+    }
+    if (args.empty() || args.size() > 2 || (args[0].type != "int" && args[0].type != "float")
+        || (args.size() == 2 && (args[1].type != "int" || args[1].asInt() < 0 || args[1].asInt() > 100))) {
+        return EvalResult("format() expects a number and an optional number of decimals (0 to 100)", "error");
+    }
+    if (args.size() == 1) {
+        return EvalResult::fromString(args[0].value);
+    }
+    double value = std::strtod(args[0].value.c_str(), nullptr);
+    char buffer[512];
+    std::to_chars_result written = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::fixed,
+                                                 static_cast<int>(args[1].asInt()));
+    if (written.ec != std::errc()) {
+        return EvalResult("format(): the number is too long", "error");
+    }
+    return EvalResult::fromString(std::string(buffer, written.ptr));
+}
+
+// printf("%-8s %6.2f\n", a, b): writes the values formatted like format() does, in one piece. Gives the number of characters.
+EvalResult ExecutionEngine::builtinPrintf(const std::vector<EvalResult>& args) {
+    if (args.empty() || args[0].type != "string") {
+        return EvalResult("printf() expects a format string and its values", "error");
+    }
+    std::string text;
+    std::string error;
+    if (!formatArgs(args, text, error)) {
+        return EvalResult("printf(): " + error, "error");
+    }
+    output->write(text.data(), static_cast<std::streamsize>(text.length()));
+    return EvalResult::fromInt(static_cast<long long>(text.length()));
+}
+
+// Formats args[1...] with the format string args[0], parsed when the script was compiled if it's a literal there
+bool ExecutionEngine::formatArgs(const std::vector<EvalResult>& args, std::string& out, std::string& error) const {
+    const FormatSpec* spec = program->findFormat(args[0].stringView());
+    FormatSpec parsed;
+    if (spec == nullptr) {
+        parsed = parseFormat(args[0].stringView());
+        spec = &parsed;
+    }
+    return formatInto(out, *spec, args, 1, error);
+}
+
+// --- Arrays and parallel map/reduce ---
+
+// len(a): the number of elements of an array, rows of a table, or characters of a string
+EvalResult ExecutionEngine::builtinLen(const std::vector<EvalResult>& args) {
+    if (args.size() != 1 || (args[0].type != "array" && args[0].type != "string" && args[0].type != "table")) {
+        return EvalResult("len() expects an array, a table or a string", "error");
+    }
+    size_t length = args[0].type == "array" ? args[0].size()
+                  : args[0].type == "table" ? args[0].table->rowCount() : args[0].stringView().length();
+    return EvalResult::fromInt(static_cast<long long>(length));
+}
+
+// range(n) or range(start, end): the ints from start (default 0) up to but not including end
+EvalResult ExecutionEngine::builtinRange(const std::vector<EvalResult>& args) {
+    if (args.empty() || args.size() > 2 || args[0].type != "int" || args.back().type != "int") {
+        return EvalResult("range() expects one or two ints", "error");
+    }
+    long long start = args.size() == 2 ? args[0].asInt() : 0;
+    long long end = args.back().asInt();
+
+    auto array = std::make_shared<ArrayData>();
+    array->kind = ArrayData::Kind::Int;
+    array->ints.reserve(static_cast<size_t>(std::max(0LL, end - start)));
+    for (long long i = start; i < end; ++i) {
+        array->ints.push_back(i);
+    }
+    return EvalResult::fromArray(std::move(array));
+}
+
+// push(a, x): a new array with x appended. The original is left as it was.
+EvalResult ExecutionEngine::builtinPush(const std::vector<EvalResult>& args) {
+    if (args.size() != 2 || args[0].type != "array") {
+        return EvalResult("push() expects an array and a value", "error");
+    }
+    const ArrayData& original = *args[0].array;
+    bool sameType = (original.kind == ArrayData::Kind::Int && args[1].type == "int")
+                 || (original.kind == ArrayData::Kind::Float && args[1].type == "float")
+                 || (original.kind == ArrayData::Kind::Bool && args[1].type == "bool")
+                 || (original.kind == ArrayData::Kind::Mixed && original.size() > 0);
+    if (!sameType) {
+        // Boxes the array, or unboxes an empty one
+        std::vector<EvalResult> items;
+        items.reserve(original.size() + 1);
+        for (size_t i = 0; i < original.size(); ++i) {
+            items.push_back(original.at(i));
+        }
+        items.push_back(args[1]);
+        return EvalResult::fromArray(std::move(items));
+    }
+
+    // Copy on write: the elements are only copied if another value still shares them (see handleCall).
+    // Arrays are always created non-const, so the unshared one may be changed.
+    std::shared_ptr<ArrayData> array = args[0].array.use_count() == 1
+        ? std::const_pointer_cast<ArrayData>(args[0].array)
+        : std::make_shared<ArrayData>(original);
+    switch (array->kind) {
+    case ArrayData::Kind::Int: array->ints.push_back(args[1].asInt()); break;
+    case ArrayData::Kind::Float: array->floats.push_back(std::strtod(args[1].value.c_str(), nullptr)); break;
+    case ArrayData::Kind::Bool: array->bools.push_back(args[1].asBool() ? 1 : 0); break;
+    case ArrayData::Kind::Mixed: array->items.push_back(args[1].type == "string" ? args[1].interned() : args[1]); break;
+    }
+    return EvalResult::fromArray(std::move(array));
+}
+
+// Points 'values' at the elements of a numeric array as floats: the array's own storage for a
+// float array, otherwise a copy widened into 'storage'. False if an element isn't a number.
+static bool floatElements(const ArrayData& array, std::vector<double>& storage, const double*& values) {
+    if (array.kind == ArrayData::Kind::Float) {
+        values = array.floats.data();
+        return true;
+    }
+    if (array.kind == ArrayData::Kind::Bool) {
+        return false;
+    }
+    if (array.kind == ArrayData::Kind::Int) {
+        storage.assign(array.ints.begin(), array.ints.end());
+    } else {
+        for (const EvalResult& item : array.items) {
+            if (item.type != "int" && item.type != "float") {
+                return false;
+            }
+            storage.push_back(std::strtod(item.value.c_str(), nullptr));
+        }
+    }
+    values = storage.data();
+    return true;
+}
+
+// sum(a): the total of a numeric array, an int if every element is one. For a bool array, the number of trues.
+EvalResult ExecutionEngine::builtinSum(const std::vector<EvalResult>& args) {
+    if (!args.empty() && args[0].type == "table") {
+        return aggregateTable(args, "sum");
+    }
+    if (args.size() != 1 || args[0].type != "array") {
+        return EvalResult("sum() expects a numeric array", "error");
+    }
+    const ArrayData& array = *args[0].array;
+    if (array.kind == ArrayData::Kind::Int) {
+        return EvalResult::fromInt(VectorKernels::best().sumInt(array.ints.data(), array.size()));
+    }
+    if (array.kind == ArrayData::Kind::Bool) {
+        return EvalResult::fromInt(static_cast<long long>(VectorKernels::best().countTrue(array.bools.data(), array.size())));
+    }
+    std::vector<double> storage;
+    const double* values = nullptr;
+    if (!floatElements(array, storage, values)) {
+        return EvalResult("sum() expects a numeric array", "error");
+    }
+    if (array.size() == 0) {
+        return EvalResult::fromInt(0);
+    }
+    return EvalResult::fromFloat(VectorKernels::best().sumFloat(values, array.size()));
+}
+
+// min(a) and max(a): the smallest and largest element of a non-empty numeric array
+EvalResult ExecutionEngine::builtinMin(const std::vector<EvalResult>& args) {
+    return extreme(args, "min");
+}
+
+EvalResult ExecutionEngine::builtinMax(const std::vector<EvalResult>& args) {
+    return extreme(args, "max");
+}
+
+EvalResult ExecutionEngine::extreme(const std::vector<EvalResult>& args, const std::string& name) {
+    if (args.size() != 1 || args[0].type != "array" || args[0].size() == 0) {
+        return EvalResult(name + "() expects a non-empty numeric array", "error");
+    }
+    const VectorKernels& kernels = VectorKernels::best();
+    const ArrayData& array = *args[0].array;
+    if (array.kind == ArrayData::Kind::Int) {
+        return EvalResult::fromInt(name == "min" ? kernels.minInt(array.ints.data(), array.size())
+                                                 : kernels.maxInt(array.ints.data(), array.size()));
+    }
+    std::vector<double> storage;
+    const double* values = nullptr;
+    if (!floatElements(array, storage, values)) {
+        return EvalResult(name + "() expects a non-empty numeric array", "error");
+    }
+    return EvalResult::fromFloat(name == "min" ? kernels.minFloat(values, array.size()) : kernels.maxFloat(values, array.size()));
+}
+
+// mean(a): the average of a non-empty numeric array, as a float
+EvalResult ExecutionEngine::builtinMean(const std::vector<EvalResult>& args) {
+    if (args.size() != 1 || args[0].type != "array" || args[0].size() == 0) {
+        return EvalResult("mean() expects a non-empty numeric array", "error");
+    }
+    EvalResult total = builtinSum(args);
+    if (total.type == "error") {
+        return EvalResult("mean() expects a non-empty numeric array", "error");
+    }
+    double sum = total.type == "int" ? static_cast<double>(total.asInt()) : std::strtod(total.value.c_str(), nullptr);
+    return EvalResult::fromFloat(sum / static_cast<double>(args[0].size()));
+}
+
+// dot(a, b): the sum of a[i] * b[i] over two numeric arrays of the same size
+EvalResult ExecutionEngine::builtinDot(const std::vector<EvalResult>& args) {
+    if (args.size() != 2 || args[0].type != "array" || args[1].type != "array" || args[0].size() != args[1].size()) {
+        return EvalResult("dot() expects two numeric arrays of the same size", "error");
+    }
+    const ArrayData& a = *args[0].array;
+    const ArrayData& b = *args[1].array;
+    const VectorKernels& kernels = VectorKernels::best();
+    if ((a.kind == ArrayData::Kind::Int && b.kind == ArrayData::Kind::Int) || a.size() == 0) {
+        return EvalResult::fromInt(kernels.dotInt(a.ints.data(), b.ints.data(), a.ints.size()));
+    }
+    std::vector<double> aStorage, bStorage;
+    const double* aValues = nullptr;
+    const double* bValues = nullptr;
+    if (!floatElements(a, aStorage, aValues) || !floatElements(b, bStorage, bValues)) {
+        return EvalResult("dot() expects two numeric arrays of the same size", "error");
+    }
+    return EvalResult::fromFloat(kernels.dotFloat(aValues, bValues, a.size()));
+}
+
+/**
+ * @brief Resolves the function argument of pmap, pfilter or preduce.
+ * It must be a script function taking 'arity' parameters, pure (see Function::impurity), and
+ * use only pure built-ins: it runs on pool threads, in engines that have no globals or natives.
+ */
+const Function* ExecutionEngine::findPureFunction(const EvalResult& handle, const std::string& builtinName, size_t arity,
+                                                  std::string& error) const {
+    const Function* func = handle.type == "function" ? program->findFunction(handle.value) : nullptr;
+    if (func == nullptr) {
+        error = builtinName + "() expects a script function";
+        return nullptr;
+    }
+    if (func->parameters.size() != arity) {
+        error = builtinName + "() expects a function of " + std::to_string(arity) + " parameter" + (arity == 1 ? "" : "s")
+              + ", and '" + func->name + "' takes " + std::to_string(func->parameters.size());
+        return nullptr;
+    }
+    if (!func->impurity.empty()) {
+        error = builtinName + "() requires a pure function, and '" + func->name + "' " + func->impurity;
+        return nullptr;
+    }
+    for (const std::string& host : func->hostCalls) {
+        auto builtin = builtins().find(host);
+        if (natives.count(host) > 0 || builtin == builtins().end() || !builtin->second.pure) {
+            error = builtinName + "() requires a pure function, and '" + func->name + "' calls '" + host
+                  + "', which isn't a pure built-in";
+            return nullptr;
+        }
+    }
+    return func;
+}
+
+// Enough slices to keep every pool thread busy while some take longer than others
+size_t ExecutionEngine::sliceCountFor(size_t count) {
+    size_t bySize = (count + MIN_SLICE - 1) / MIN_SLICE;
+    return std::max<size_t>(1, std::min(bySize, parallelTaskPool().threadCount() * 4));
+}
+
+/**
+ * @brief Calls body(slice) for every slice on the parallel task pool and waits for all of them.
+ * The calling thread runs the first slice and then helps with any slice no worker has claimed yet,
+ * so work started from inside a parallel task can't starve the pool.
+ */
+static void runOnPool(size_t slices, const std::function<void(size_t)>& body) {
+    std::vector<std::shared_ptr<ParallelJob>> jobs;
+    for (size_t slice = 0; slice < slices; ++slice) {
+        std::shared_ptr<ParallelJob> job = std::make_shared<ParallelJob>();
+        job->body = [&body, slice](ParallelJob&) { body(slice); };
+        jobs.push_back(job);
+    }
+
+    for (size_t i = 1; i < jobs.size(); ++i) {
+        std::shared_ptr<ParallelJob> job = jobs[i];
+        parallelTaskPool().submit([job]() { job->tryRun(); });
+    }
+    for (const std::shared_ptr<ParallelJob>& job : jobs) {
+        job->tryRun();
+    }
+    for (const std::shared_ptr<ParallelJob>& job : jobs) {
+        job->waitUntilDone();
+    }
+}
+
+/**
+ * @brief Splits [0, count) into 'slices' consecutive ranges and calls body(engine, begin, end, slice)
+ * for each on the parallel task pool. Every slice gets an engine of its own for the same Program.
+ * @return The error output of the slices, in slice order.
+ */
+std::string ExecutionEngine::runSlices(size_t count, size_t slices,
+                                       const std::function<void(ExecutionEngine&, size_t, size_t, size_t)>& body) {
+    std::vector<std::string> sliceErrors(slices);
+    runOnPool(slices, [&](size_t slice) {
+        std::ostringstream output;
+        std::ostringstream errors;
+        std::istringstream input;
+        try {
+            ExecutionEngine engine(program);
+            engine.reportedNameErrors = reportedNameErrors;
+            engine.setOutput(output);
+            engine.setErrorOutput(errors);
+            engine.setInput(input);
+            body(engine, count * slice / slices, count * (slice + 1) / slices, slice);
+        } catch (const std::exception& e) {
+            errors << "Execution Fatal Error in parallel slice: " << e.what() << "\n";
+        }
+        sliceErrors[slice] = errors.str();
+    });
+
+    std::string errors;
+    for (const std::string& part : sliceErrors) {
+        errors += part;
+    }
+    return errors;
+}
+
+// Calls a pure function in a slice's engine. A function that returns nothing gives 0.
+static EvalResult callInSlice(ExecutionEngine& engine, const Function& func, const std::vector<EvalResult>& args) {
+    EvalResult result = engine.call(FunctionHandle{ &func }, args);
+    return result.type == "empty" ? EvalResult("0", "int") : result;
+}
+
+// pmap(a, f): [f(a[0]), f(a[1]), ...], computed in parallel
+EvalResult ExecutionEngine::builtinParallelMap(const std::vector<EvalResult>& args) {
+    if (args.size() != 2 || args[0].type != "array") {
+        return EvalResult("pmap() expects an array and a function", "error");
+    }
+    std::string error;
+    const Function* func = findPureFunction(args[1], "pmap", 1, error);
+    if (func == nullptr) {
+        return EvalResult(error, "error");
+    }
+
+    size_t count = args[0].size();
+    if (count == 0) {
+        return EvalResult::fromArray(std::vector<EvalResult>());
+    }
+    const ArrayData& items = *args[0].array;
+    std::vector<EvalResult> results(count);
+    *errorOutput << runSlices(count, sliceCountFor(count), [&](ExecutionEngine& engine, size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; ++i) {
+            results[i] = callInSlice(engine, *func, { items.at(i) });
+        }
+    });
+    return EvalResult::fromArray(std::move(results));
+}
+
+// pfilter(a, f): the elements of a for which f returns true, in their original order
+EvalResult ExecutionEngine::builtinParallelFilter(const std::vector<EvalResult>& args) {
+    if (args.size() != 2 || args[0].type != "array") {
+        return EvalResult("pfilter() expects an array and a function", "error");
+    }
+    std::string error;
+    const Function* func = findPureFunction(args[1], "pfilter", 1, error);
+    if (func == nullptr) {
+        return EvalResult(error, "error");
+    }
+
+    size_t count = args[0].size();
+    if (count == 0) {
+        return EvalResult::fromArray(std::vector<EvalResult>());
+    }
+    const ArrayData& items = *args[0].array;
+    size_t slices = sliceCountFor(count);
+    std::vector<std::vector<EvalResult>> kept(slices);
+    *errorOutput << runSlices(count, slices, [&](ExecutionEngine& engine, size_t begin, size_t end, size_t slice) {
+        for (size_t i = begin; i < end; ++i) {
+            // Like an if condition, anything but true rejects the element
+            if (callInSlice(engine, *func, { items.at(i) }).asBool()) {
+                kept[slice].push_back(items.at(i));
+            }
+        }
+    });
+
+    std::vector<EvalResult> results;
+    for (std::vector<EvalResult>& part : kept) {
+        std::move(part.begin(), part.end(), std::back_inserter(results));
+    }
+    return EvalResult::fromArray(std::move(results));
+}
+
+/**
+ * @brief preduce(a, f, init): f(...f(f(init, a[0]), a[1])..., a[n-1]), computed in parallel.
+ * Every slice is folded on its own, starting from its first element, and the slices' results
+ * are then folded in order starting from init. That gives the sequential result as long as f
+ * is associative, like + or max.
+ */
+EvalResult ExecutionEngine::builtinParallelReduce(const std::vector<EvalResult>& args) {
+    if (args.size() != 3 || args[0].type != "array") {
+        return EvalResult("preduce() expects an array, a function and an initial value", "error");
+    }
+    std::string error;
+    const Function* func = findPureFunction(args[1], "preduce", 2, error);
+    if (func == nullptr) {
+        return EvalResult(error, "error");
+    }
+
+    size_t count = args[0].size();
+    if (count == 0) {
+        return args[2];
+    }
+    const ArrayData& items = *args[0].array;
+    size_t slices = sliceCountFor(count);
+    std::vector<EvalResult> partials(slices);
+    *errorOutput << runSlices(count, slices, [&](ExecutionEngine& engine, size_t begin, size_t end, size_t slice) {
+        EvalResult accumulator = items.at(begin);
+        for (size_t i = begin + 1; i < end; ++i) {
+            accumulator = callInSlice(engine, *func, { accumulator, items.at(i) });
+        }
+        partials[slice] = std::move(accumulator);
+    });
+
+    std::ostringstream combineOutput;
+    std::istringstream combineInput;
+    ExecutionEngine engine(program);
+    engine.reportedNameErrors = reportedNameErrors;
+    engine.setOutput(combineOutput);
+    engine.setErrorOutput(*errorOutput);
+    engine.setInput(combineInput);
+    EvalResult result = args[2];
+    for (const EvalResult& partial : partials) {
+        result = callInSlice(engine, *func, { result, partial });
+    }
+    return result;
+}
+
+// --- Tables ---
+
+static const size_t BULK_SLICE_SIZE = 1 << 16;  // Rows or elements per slice when grouping or sorting on several cores
+
+static size_t bulkSlices(size_t rows) {
+    if (rows < 2 * BULK_SLICE_SIZE) {
+        return 1;
+    }
+    return std::max<size_t>(1, std::min(rows / BULK_SLICE_SIZE, parallelTaskPool().threadCount()));
+}
+
+static void runBulkSlices(size_t slices, const std::function<void(size_t)>& body) {
+    if (slices == 1) {
+        body(0);
+    } else {
+        runOnPool(slices, body);
+    }
+}
+
+// The indexes of the columns named by args[first...]
+bool ExecutionEngine::findColumns(const TableData& table, const std::vector<EvalResult>& names, size_t first,
+                                  std::vector<size_t>& columns, std::string& error) const {
+    for (size_t i = first; i < names.size(); ++i) {
+        int column = names[i].type == "string" ? table.findColumn(names[i].asString()) : -1;
+        if (column < 0) {
+            error = "The table has no column " + (names[i].type == "string" ? '"' + names[i].asString() + '"' : names[i].value);
+            return false;
+        }
+        columns.push_back(static_cast<size_t>(column));
+    }
+    return true;
+}
+
+// table("name", array, "other", array2, ...): a table of those columns, which must have the same size
+EvalResult ExecutionEngine::builtinTable(const std::vector<EvalResult>& args) {
+    auto table = std::make_shared<TableData>();
+    for (size_t i = 0; i + 1 < args.size(); i += 2) {
+        if (args[i].type != "string" || args[i + 1].type != "array") {
+            return EvalResult("table() expects pairs of a column name and an array", "error");
+        }
+        if (i > 0 && args[i + 1].size() != table->rowCount()) {
+            return EvalResult("table() columns must have the same size", "error");
+        }
+        table->names.push_back(args[i].asString());
+        table->columns.push_back(args[i + 1].array);
+    }
+    if (args.empty() || args.size() % 2 != 0) {
+        return EvalResult("table() expects pairs of a column name and an array", "error");
+    }
+    return EvalResult::fromTable(std::move(table));
+}
+
+// readTable("sales.csv"): a CSV (or .tsv) file with a header row, as a table
+EvalResult ExecutionEngine::builtinReadTable(const std::vector<EvalResult>& args) {
+    if (args.size() != 1 || args[0].type != "string") {
+        return EvalResult("readTable() expects a file name", "error");
+    }
+    std::string filename = args[0].asString();
+    bool isTsv = filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".tsv") == 0;
+    try {
+        CsvReader reader(filename, isTsv ? '\t' : ',');
+        std::vector<ColumnBuilder> builders(reader.getColumnNames().size());
+        while (reader.readRecord()) {
+            for (size_t i = 0; i < builders.size(); ++i) {
+                builders[i].add(reader.typedField(i));
+            }
+        }
+        auto table = std::make_shared<TableData>();
+        table->names = reader.getColumnNames();
+        for (ColumnBuilder& builder : builders) {
+            table->columns.push_back(builder.finish());
+        }
+        return EvalResult::fromTable(std::move(table));
+    } catch (const std::exception& e) {
+        return EvalResult(e.what(), "error");
+    }
+}
+
+// column(t, "name"): one column of a table, as an array (like t["name"])
+EvalResult ExecutionEngine::builtinColumn(const std::vector<EvalResult>& args) {
+    if (args.size() != 2 || args[0].type != "table") {
+        return EvalResult("column() expects a table and a column name", "error");
+    }
+    std::vector<size_t> columns;
+    std::string error;
+    if (!findColumns(*args[0].table, args, 1, columns, error)) {
+        return EvalResult(error, "error");
+    }
+    return EvalResult::fromArray(args[0].table->columns[columns[0]]);
+}
+
+// select(t, "a", "b", ...): a table of only those columns, in that order
+EvalResult ExecutionEngine::builtinSelect(const std::vector<EvalResult>& args) {
+    if (args.size() < 2 || args[0].type != "table") {
+        return EvalResult("select() expects a table and column names", "error");
+    }
+    std::vector<size_t> columns;
+    std::string error;
+    if (!findColumns(*args[0].table, args, 1, columns, error)) {
+        return EvalResult(error, "error");
+    }
+    auto table = std::make_shared<TableData>();
+    for (size_t column : columns) {
+        table->names.push_back(args[0].table->names[column]);
+        table->columns.push_back(args[0].table->columns[column]);
+    }
+    return EvalResult::fromTable(std::move(table));
+}
+
+// groupBy(t, "a", ...): the same table, with sum, avg and count then giving one row per group
+EvalResult ExecutionEngine::builtinGroupBy(const std::vector<EvalResult>& args) {
+    if (args.size() < 2 || args[0].type != "table") {
+        return EvalResult("groupBy() expects a table and column names", "error");
+    }
+    auto table = std::make_shared<TableData>(*args[0].table);
+    table->groupKeys.clear();
+    std::string error;
+    if (!findColumns(*table, args, 1, table->groupKeys, error)) {
+        return EvalResult(error, "error");
+    }
+    return EvalResult::fromTable(std::move(table));
+}
+
+// count(t): the number of rows, or after groupBy() the rows per group. count(a) is len(a).
+EvalResult ExecutionEngine::builtinCount(const std::vector<EvalResult>& args) {
+    if (args.size() == 1 && args[0].type == "array") {
+        return EvalResult::fromInt(static_cast<long long>(args[0].size()));
+    }
+    if (args.empty() || args[0].type != "table") {
+        return EvalResult("count() expects a table or an array", "error");
+    }
+    return aggregateTable(args, "count");
+}
+
+// avg(t, "c") on a table, like sum; avg(a) is mean(a)
+EvalResult ExecutionEngine::builtinAvg(const std::vector<EvalResult>& args) {
+    if (!args.empty() && args[0].type == "table") {
+        return aggregateTable(args, "avg");
+    }
+    return builtinMean(args);
+}
+
+/**
+ * @brief sum(t, "c"), avg(t, "c") and count(t).
+ * Without groupBy() they give one value over all rows. After groupBy() they give a table with one
+ * row per group: the key columns, then the result, named after the column (or "count"), or
+ * sum_column (avg_column, count_count) when a key column has that name.
+ * Rows are grouped with hash tables and then added up, one slice of rows per core for large tables.
+ */
+EvalResult ExecutionEngine::aggregateTable(const std::vector<EvalResult>& args, const std::string& name) {
+    const TableData& table = *args[0].table;
+    bool needsColumn = name != "count";
+    std::vector<size_t> columns;
+    std::string error;
+    if (args.size() != (needsColumn ? 2 : 1)) {
+        return EvalResult(needsColumn ? name + "() expects a table and a column name" : "count() expects a table", "error");
+    }
+    if (!findColumns(table, args, 1, columns, error)) {
+        return EvalResult(error, "error");
+    }
+
+    if (table.groupKeys.empty()) {
+        if (!needsColumn) {
+            return EvalResult::fromInt(static_cast<long long>(table.rowCount()));
+        }
+        std::vector<EvalResult> column = { EvalResult::fromArray(table.columns[columns[0]]) };
+        return name == "sum" ? builtinSum(column) : builtinMean(column);
+    }
+
+    const ArrayData* values = needsColumn ? table.columns[columns[0]].get() : nullptr;
+    bool intSums = values != nullptr && values->kind == ArrayData::Kind::Int && name == "sum";
+    std::vector<double> storage;
+    const double* floats = nullptr;
+    if (values != nullptr && !intSums && !floatElements(*values, storage, floats)) {
+        return EvalResult(name + "() needs a numeric column", "error");
+    }
+
+    size_t rows = table.rowCount();
+    size_t slices = bulkSlices(rows);
+    Grouping grouping = groupByColumns(table, table.groupKeys, slices, runBulkSlices);
+    size_t groups = grouping.groupCount();
+
+    // Every slice adds up its rows on its own; the partial results are then added in slice order
+    std::vector<std::vector<long long>> counts(slices, std::vector<long long>(groups));
+    std::vector<std::vector<unsigned long long>> intTotals(intSums ? slices : 0, std::vector<unsigned long long>(groups));
+    std::vector<std::vector<double>> floatTotals(floats != nullptr ? slices : 0, std::vector<double>(groups));
+    runBulkSlices(slices, [&](size_t slice) {
+        for (size_t row = rows * slice / slices; row < rows * (slice + 1) / slices; ++row) {
+            uint32_t group = grouping.groupOf[row];
+            counts[slice][group]++;
+            if (intSums) intTotals[slice][group] += static_cast<unsigned long long>(values->ints[row]);
+            else if (floats != nullptr) floatTotals[slice][group] += floats[row];
+        }
+    });
+
+    auto result = std::make_shared<TableData>();
+    for (size_t key : table.groupKeys) {
+        ColumnBuilder builder;
+        for (size_t row : grouping.firstRow) {
+            builder.add(table.columns[key]->at(row));
+        }
+        result->names.push_back(table.names[key]);
+        result->columns.push_back(builder.finish());
+    }
+
+    auto aggregate = std::make_shared<ArrayData>();
+    for (size_t group = 0; group < groups; ++group) {
+        long long count = 0;
+        unsigned long long intTotal = 0;
+        double floatTotal = 0;
+        for (size_t slice = 0; slice < slices; ++slice) {
+            count += counts[slice][group];
+            if (intSums) intTotal += intTotals[slice][group];
+            else if (floats != nullptr) floatTotal += floatTotals[slice][group];
+        }
+        if (name == "count") aggregate->ints.push_back(count);
+        else if (intSums) aggregate->ints.push_back(static_cast<long long>(intTotal));
+        else if (name == "sum") aggregate->floats.push_back(floatTotal);
+        else aggregate->floats.push_back(floatTotal / static_cast<double>(count));
+    }
+    aggregate->kind = name == "count" || intSums ? ArrayData::Kind::Int : ArrayData::Kind::Float;
+    // Named after the column, unless a key column has that name already: then sum_amount, say
+    std::string aggregateName = needsColumn ? table.names[columns[0]] : "count";
+    if (std::find(result->names.begin(), result->names.end(), aggregateName) != result->names.end()) {
+        aggregateName = name + "_" + aggregateName;
+    }
+    result->names.push_back(aggregateName);
+    result->columns.push_back(std::move(aggregate));
+    return EvalResult::fromTable(std::move(result));
+}
+
+// --- Sorting ---
+
+/**
+ * @brief sort(a): the elements of a in ascending order. sort(t, "a", ...): the rows of t ordered by
+ * those columns. Equal elements or rows keep their order. Numbers sort before strings.
+ */
+EvalResult ExecutionEngine::builtinSort(const std::vector<EvalResult>& args) {
+    if (args.size() == 1 && args[0].type == "array") {
+        const ArrayData& items = *args[0].array;
+        std::vector<SortKey> keys = { SortKey(items) };
+        return EvalResult::fromArray(items.gathered(sortedOrder(keys, items.size(), bulkSlices(items.size()), runBulkSlices)));
+    }
+    if (args.size() < 2 || args[0].type != "table") {
+        return EvalResult("sort() expects an array, or a table and column names", "error");
+    }
+    const TableData& table = *args[0].table;
+    std::vector<size_t> columns;
+    std::string error;
+    if (!findColumns(table, args, 1, columns, error)) {
+        return EvalResult(error, "error");
+    }
+    std::vector<SortKey> keys;
+    for (size_t column : columns) {
+        keys.emplace_back(*table.columns[column]);
+    }
+    size_t rows = table.rowCount();
+    return EvalResult::fromTable(table.gathered(sortedOrder(keys, rows, bulkSlices(rows), runBulkSlices)));
+}
+
+/**
+ * @brief sortBy(a, f): the elements of a, ordered by f(element).
+ * f is called once per element, in parallel like pmap, and the array is then sorted by the results,
+ * so a slow key function costs n calls rather than one per comparison.
+ */
+EvalResult ExecutionEngine::builtinSortBy(const std::vector<EvalResult>& args) {
+    if (args.size() != 2 || args[0].type != "array") {
+        return EvalResult("sortBy() expects an array and a function", "error");
+    }
+    std::string error;
+    const Function* func = findPureFunction(args[1], "sortBy", 1, error);
+    if (func == nullptr) {
+        return EvalResult(error, "error");
+    }
+
+    const ArrayData& items = *args[0].array;
+    size_t count = items.size();
+    if (count == 0) {
+        return args[0];
+    }
+    std::vector<EvalResult> results(count);
+    *errorOutput << runSlices(count, sliceCountFor(count), [&](ExecutionEngine& engine, size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; ++i) {
+            results[i] = callInSlice(engine, *func, { items.at(i) });
+        }
+    });
+    std::shared_ptr<const ArrayData> sortKeys = ArrayData::fromItems(std::move(results));
+    std::vector<SortKey> keys = { SortKey(*sortKeys) };
+    return EvalResult::fromArray(items.gathered(sortedOrder(keys, count, bulkSlices(count), runBulkSlices)));
+}
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <charconv>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+#include "evaluator.hpp"
+
+/**
+ * @brief One step of a printf-style format string: literal text, or one value formatted with
+ * %s (any value), %d (ints), %f and %e (numbers) or %x and %X (ints, in hex).
+ * Flags are '-' (left align), '0' (pad numbers with zeros) and '+' (always show the sign),
+ * followed by an optional width and an optional precision after a '.'.
+ */
+struct FormatOp {
+    char conversion = 0;  // 0 for literal text
+    std::string text;
+    int width = 0;
+    int precision = -1;  // -1: the default (6 for %f and %e, everything for %s)
+    bool leftAlign = false;
+    bool zeroPad = false;
+    bool plusSign = false;
+};
+
+// A parsed format string
+struct FormatSpec {
+    std::vector<FormatOp> ops;
+    size_t literalLength = 0;  // Length of all literal text together
+    size_t valueCount = 0;
+    std::string error;  // Set when the format string has an unknown or unfinished conversion
+};
+
+// Parses a format string; %% stands for '%'
+inline FormatSpec parseFormat(std::string_view format) {
+    static const int MAX_WIDTH = 1000;
+    FormatSpec spec;
+    std::string literal;
+    auto flushLiteral = [&]() {
+        if (!literal.empty()) {
+            spec.literalLength += literal.length();
+            FormatOp op;
+            op.text = std::move(literal);
+            spec.ops.push_back(std::move(op));
+            literal.clear();
+        }
+    };
+    auto number = [&](size_t& i) {
+        int value = 0;
+        while (i < format.length() && format[i] >= '0' && format[i] <= '9' && value <= MAX_WIDTH) {
+            value = value * 10 + (format[i++] - '0');
+        }
+        return value;
+    };
+
+    size_t i = 0;
+    while (i < format.length()) {
+        if (format[i] != '%') {
+            literal += format[i++];
+            continue;
+        }
+        size_t start = i++;
+        if (i < format.length() && format[i] == '%') {
+            literal += '%';
+            i++;
+            continue;
+        }
+
+        FormatOp op;
+        for (; i < format.length(); ++i) {
+            if (format[i] == '-') op.leftAlign = true;
+            else if (format[i] == '0') op.zeroPad = true;
+            else if (format[i] == '+') op.plusSign = true;
+            else break;
+        }
+        op.width = number(i);
+        if (i < format.length() && format[i] == '.') {
+            i++;
+            op.precision = number(i);
+        }
+        if (i == format.length() || std::string_view("sdfexX").find(format[i]) == std::string_view::npos
+            || op.width > MAX_WIDTH || op.precision > MAX_WIDTH) {
+            size_t end = std::min(i + 1, format.length());
+            spec.error = "Invalid conversion '" + std::string(format.substr(start, end - start)) + "' in format string";
+            return spec;
+        }
+        op.conversion = format[i++];
+        flushLiteral();
+        spec.ops.push_back(std::move(op));
+        spec.valueCount++;
+    }
+    flushLiteral();
+    return spec;
+}
+
+/**
+ * @brief Appends 'value' formatted by 'op' to 'out'. Numbers are written into a buffer on the
+ * stack, so nothing is allocated besides 'out' growing.
+ * @return false, with 'error' set, if the value doesn't fit the conversion.
+ */
+inline bool appendFormatted(std::string& out, const FormatOp& op, const EvalResult& value, std::string& error) {
+    char buffer[1100];  // A double with MAX_WIDTH decimals and its sign
+    std::string_view text;
+    bool isNumber = value.type == "int" || value.type == "float";
+    bool numeric = op.conversion != 's';
+
+    if (!numeric) {
+        if (value.type == "array" || value.type == "table") {
+            error = "%s can't format a " + value.type;
+            return false;
+        }
+        text = value.type == "string" ? value.stringView() : std::string_view(value.value);
+        if (op.precision >= 0 && static_cast<size_t>(op.precision) < text.length()) {
+            text = text.substr(0, op.precision);
+        }
+    } else {
+        if (!isNumber) {
+            error = std::string("%") + op.conversion + " expects a number, not a " + value.type;
+            return false;
+        }
+        char* begin = buffer + 1;  // Room for a '+'
+        char* end = buffer + sizeof(buffer);
+        std::to_chars_result written{};
+        if (op.conversion == 'd' || op.conversion == 'x' || op.conversion == 'X') {
+            double truncated = value.type == "int" ? 0 : std::strtod(value.value.c_str(), nullptr);
+            if (!(truncated > -9.2e18 && truncated < 9.2e18)) {
+                error = std::string("%") + op.conversion + " can't format " + value.value + " as an integer";
+                return false;
+            }
+            long long integer = value.type == "int" ? value.asInt() : static_cast<long long>(truncated);
+            if (op.conversion == 'd') {
+                written = std::to_chars(begin, end, integer);
+            } else {
+                written = std::to_chars(begin, end, static_cast<uint64_t>(integer), 16);
+                if (op.conversion == 'X') {
+                    for (char* p = begin; p < written.ptr; ++p) {
+                        if (*p >= 'a' && *p <= 'f') *p = static_cast<char>(*p - 'a' + 'A');
+                    }
+                }
+            }
+        } else {
+            double number = std::strtod(value.value.c_str(), nullptr);
+            int precision = op.precision < 0 ? 6 : op.precision;
+            written = std::to_chars(begin, end, number,
+                                    op.conversion == 'f' ? std::chars_format::fixed : std::chars_format::scientific, precision);
+        }
+        if (written.ec != std::errc()) {
+            error = "The number is too long to format";
+            return false;
+        }
+        if (op.plusSign && *begin != '-' && op.conversion != 'x' && op.conversion != 'X') {
+            *--begin = '+';
+        }
+        text = std::string_view(begin, static_cast<size_t>(written.ptr - begin));
+    }
+
+    size_t padding = static_cast<size_t>(op.width) > text.length() ? op.width - text.length() : 0;
+    if (op.leftAlign) {
+        out += text;
+        out.append(padding, ' ');
+    } else if (op.zeroPad && numeric) {
+        // Zeros go between the sign and the digits
+        size_t sign = !text.empty() && (text[0] == '-' || text[0] == '+') ? 1 : 0;
+        out += text.substr(0, sign);
+        out.append(padding, '0');
+        out += text.substr(sign);
+    } else {
+        out.append(padding, ' ');
+        out += text;
+    }
+    return true;
+}
+
+/**
+ * @brief Formats 'values' (starting at 'first') with 'spec' into 'out', which is reserved once
+ * for the literal text and an estimate of the values' lengths.
+ * @return false, with 'error' set, on a wrong number or type of values.
+ */
+inline bool formatInto(std::string& out, const FormatSpec& spec, const std::vector<EvalResult>& values, size_t first,
+                       std::string& error) {
+    if (!spec.error.empty()) {
+        error = spec.error;
+        return false;
+    }
+    if (values.size() - first != spec.valueCount) {
+        error = "The format string takes " + std::to_string(spec.valueCount) + (spec.valueCount == 1 ? " value" : " values")
+              + ", not " + std::to_string(values.size() - first);
+        return false;
+    }
+
+    size_t length = out.length() + spec.literalLength;
+    size_t next = first;
+    for (const FormatOp& op : spec.ops) {
+        if (op.conversion != 0) {
+            const EvalResult& value = values[next++];
+            length += std::max<size_t>(op.width, value.type == "string" ? value.stringView().length() : value.value.length());
+        }
+    }
+    out.reserve(length);
+
+    next = first;
+    for (const FormatOp& op : spec.ops) {
+        if (op.conversion == 0) {
+            out += op.text;
+        } else if (!appendFormatted(out, op, values[next++], error)) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -5,24 +5,47 @@
 #include <vector>
 #include <fstream>
 #include <cctype>
-#include <regex>
 #include <map>
+#include <functional>
+#include <set>
 
 #include "evaluator.hpp"
 #include "variable.hpp"
 #include "helpers.hpp"
 
-// TODO: Allow expressions in return statements
-
 struct Function {
     std::string name;
     std::vector<std::string> parameters;
     int startingLine;
 
+    // Set by the compiler. A pure function only reads its parameters and locals, writes only its
+    // locals and does no I/O, so it can run on any thread in an engine of its own.
+    std::string impurity;  // Why it isn't pure, e.g. "prints on line 4"; empty if it is
+    std::set<std::string> hostCalls;  // Natives and built-ins it (or a function it calls) uses; the engine checks these
+
     Function(const std::string& funcName, const std::vector<std::string>& params, int line)
         : name(funcName), parameters(params), startingLine(line) {}
 };
 
+// A C++ function callable from scripts. Arguments arrive already evaluated.
+using NativeFunction = std::function<EvalResult(const std::vector<EvalResult>&)>;
+
+// One entry of the call stack
+struct CallFrame {
+    int returnLine;
+    std::string assignTarget;  // Variable receiving the return value ("" if discarded)
+    bool declareTarget = false;  // The target is declared by this call (var x = f())
+    bool hostCall = false;  // Called from C++ through ExecutionEngine::call()
+    bool taskRoot = false;  // Bottom frame of a spawned task; returning from it finishes the task
+};
+
+// Pre-resolved function, obtained once with ExecutionEngine::getFunction()
+struct FunctionHandle {
+    const Function* function = nullptr;
+
+    explicit operator bool() const { return function != nullptr; }
+};
+
 // PLAN:
 /*
 Have a "function" struct that holds:
@@ -5,144 +5,204 @@
 #include <vector>
 #include <fstream>
 #include <cctype>
-#include <regex>
 #include <map>
+#include <string_view>
 
 #include "evaluator.hpp"
 #include "executionengine.hpp"
 #include "variable.hpp"
+#include "lexer.hpp"
+
+// Function to split and trim arguments for function calls.
+// Commas inside string literals, nested parentheses or array literals don't split.
+std::vector<std::string> splitAndTrimArgs(const std::string& paramsString) {
+    std::vector<std::string> args;
+    bool inStringLiteral = false;
+    int depth = 0;
+    size_t start = 0;
+
+    // Adds the argument in [start, end), without the spaces around it
+    auto pushSegment = [&](size_t end) {
+        size_t first = paramsString.find_first_not_of(' ', start);
+        if (first < end) {
+            size_t last = paramsString.find_last_not_of(' ', end - 1);
+            args.push_back(paramsString.substr(first, last - first + 1));
+        }
+    };
+
+    for (size_t i = 0; i < paramsString.length(); ++i) {
+        char c = paramsString[i];
+        if (c == '"') inStringLiteral = !inStringLiteral;
+        if (inStringLiteral) continue;
+        if (c == '(' || c == '[') depth++;
+        else if (c == ')' || c == ']') depth--;
+        else if (c == ',' && depth == 0) {
+            pushSegment(i);
+            start = i + 1;
+        }
+    }
+    pushSegment(paramsString.length());
+    return args;
+}
+
+// Position of the bracket closing the '(' or '[' at 'open', skipping string literals; npos if there's none
+size_t findClosing(const std::string& text, size_t open) {
+    char opening = text[open];
+    char closing = opening == '(' ? ')' : ']';
+    int depth = 0;
+    bool inStringLiteral = false;
+    for (size_t i = open; i < text.length(); ++i) {
+        if (text[i] == '"') inStringLiteral = !inStringLiteral;
+        if (inStringLiteral) continue;
+        if (text[i] == opening) depth++;
+        if (text[i] == closing && --depth == 0) return i;
+    }
+    return std::string::npos;
+}
+
+// Position of 'token' at 'from' or later, outside string literals, parentheses and brackets; npos if there's none
+size_t findTopLevel(const std::string& text, const std::string& token, size_t from = 0) {
+    int depth = 0;
+    bool inStringLiteral = false;
+    for (size_t i = 0; i < text.length(); ++i) {
+        char c = text[i];
+        if (c == '"') inStringLiteral = !inStringLiteral;
+        if (inStringLiteral) continue;
+        if (c == '(' || c == '[') depth++;
+        else if (c == ')' || c == ']') depth--;
+        else if (depth == 0 && i >= from && text.compare(i, token.length(), token) == 0) return i;
+    }
+    return std::string::npos;
+}
+
+std::string trimmed(const std::string& text) {
+    size_t first = text.find_first_not_of(" \t");
+    if (first == std::string::npos) {
+        return "";
+    }
+    return text.substr(first, text.find_last_not_of(" \t") - first + 1);
+}
+
+// Replaces identifiers that are keys of 'replacements' outside string literals; longer identifiers containing them stay
+std::string replaceIdentifiers(const std::string& text, const std::map<std::string, std::string>& replacements) {
+    std::string result;
+    bool inStringLiteral = false;
+    size_t i = 0;
+    while (i < text.length()) {
+        char c = text[i];
+        if (c == '"') inStringLiteral = !inStringLiteral;
+        if (inStringLiteral || !(std::isalpha(c) || c == '_')) {
+            result += c;
+            i++;
+            continue;
+        }
+        size_t start = i;
+        while (i < text.length() && (std::isalnum(text[i]) || text[i] == '_')) i++;
+        std::string identifier = text.substr(start, i - start);
+        auto replacement = replacements.find(identifier);
+        result += replacement == replacements.end() ? identifier : replacement->second;
+    }
+    return result;
+}
 
 // --- Variable Substitution Logic ---
 
 /**
  * @brief Checks if a token is a valid variable name (alphanumeric, starts with letter/underscore).
- * Note: This must be synchronized with the name regexes used in main.
+ * Keywords (like true, false, var) are looked up in the Lexer's perfect hash table.
  */
-bool isVariableName(const std::string& token) {
-    if (token.empty() || !std::isalpha(token[0]) && token[0] != '_') {
-        return false;
-    }
-    // Check if the name is a reserved keyword (like true, false, var)
-    if (token == "true" || token == "false" || token == "var" || token == "print" || token == "println" || token == "input"
-        || token == "func" || token == "return" || token == "if" || token == "else" || token == "while" || token == "import"
-        || token == "END" || token == "GOTO" || token == "end" || token == "STYLE") {
+bool isVariableName(std::string_view token) {
+    if (token.empty() || !(std::isalpha(static_cast<unsigned char>(token[0])) || token[0] == '_')) {
         return false;
     }
     for (char c : token) {
-        if (!std::isalnum(c) && c != '_') {
+        if (!isWordChar(c)) {
             return false;
         }
     }
-    return true;
+    return keywordOf(token) == Keyword::None;
+}
+
+/**
+ * @brief Checks if a token can name a called function: any variable name, and also select, which is
+ * a keyword for the channel statement but the table built-in when it is called.
+ */
+bool isFunctionName(std::string_view token) {
+    return isVariableName(token) || token == "select";
+}
+
+/**
+ * @brief Text that evaluates back to the value inside an expression.
+ * Strings, arrays and tables are added to 'operands', when given, and referenced as $k, so their
+ * contents are neither copied nor parsed again. Otherwise they're written as a string literal.
+ */
+std::string literalText(const EvalResult& result, std::vector<EvalResult>* operands = nullptr) {
+    if (result.type != "string" && result.type != "array" && result.type != "table") {
+        return result.value;
+    }
+    if (operands != nullptr) {
+        operands->push_back(result);
+        return "$" + std::to_string(operands->size() - 1);
+    }
+    std::string text = "\"";
+    for (char c : result.asString()) {
+        if (c == '"' || c == '\\') text += '\\';
+        text += c;
+    }
+    return text + '"';
+}
+
+std::string literalText(const Variable& var, std::vector<EvalResult>* operands = nullptr) {
+    bool literal = var.type != "string" && var.type != "array" && var.type != "table";
+    return literal ? var.value : literalText(var.getAsResult(), operands);
 }
 
 /**
  * @brief Scans a line, finds variables, and replaces them with their stored values.
- * MODIFIED to handle ${} string interpolation inside string literals.
+ * String literals are copied unchanged; their ${} interpolations are rendered before this
+ * (see InterpolationTemplate).
+ * Arrays are added to 'operands', when given (see literalText).
  */
-std::string findAndReplaceVariables(const std::string& line, const std::map<std::string, Variable>& vars) {
+std::string findAndReplaceVariables(const std::string& line, const std::map<std::string, Variable>& vars, std::ostream& errors = std::cerr,
+                                    std::vector<EvalResult>* operands = nullptr) {
     std::string substitutedLine;
-    std::string currentToken;
+    substitutedLine.reserve(line.length());
     bool inStringLiteral = false;
-    
-    // We will build the new string character by character
-    for (size_t i = 0; i < line.length(); ++i) {
-        char c = line[i];
-        
-        // --- 1. STRING INTERPOLATION CHECK ---
-        // Check for the start of interpolation: "${"
-        if (inStringLiteral && c == '$' && i + 1 < line.length() && line[i+1] == '{') {
-            i += 2; // Skip '$' and '{'
-            std::string varName;
-            
-            // Collect the variable name until '}' is found
-            while (i < line.length() && line[i] != '}') {
-                varName += line[i];
-                i++;
-            }
-            
-            // Check for the closing brace '}'
-            if (i == line.length()) {
-                std::cerr << "Syntax Error: Unterminated string interpolation sequence starting at " << line.substr(i-2) << std::endl;
-                // Append the raw failed sequence for the evaluator to deal with
-                substitutedLine += "${" + varName;
-                break; 
-            }
-            
-            // Substitution for interpolated variable
-            if (vars.count(varName)) {
-                // Append the value, but wrap it in quotes if it's not a string (since we are *inside* a string literal)
-                // This is a crucial step to correctly escape numbers/bools back into the literal.
-                if (vars.at(varName).type == "string") {
-                    // If it's already a string literal (e.g., "\"hello\""), use the unquoted asString()
-                    // The overall Evaluator tokenizer will handle the final quotes of the containing string.
-                    substitutedLine += vars.at(varName).asString(); 
-                } else {
-                    // For numbers/bools, just use the raw value.
-                    substitutedLine += vars.at(varName).value;
-                }
-            } else {
-                std::cerr << "Substitution Error: Undefined variable '" << varName << "' used in interpolation." << std::endl;
-                substitutedLine += "0"; // Use default value
-            }
-            
-            // Continue to the next character after '}'
-            continue; 
-        }
 
-        // --- 2. String Literal Boundary Check ---
+    size_t i = 0;
+    while (i < line.length()) {
+        char c = line[i];
         if (c == '"') {
             inStringLiteral = !inStringLiteral;
         }
-
-        // --- 3. Normal Variable/Token Processing ---
-        // If we are INSIDE a string literal and NOT processing interpolation, just append the character.
-        if (inStringLiteral) {
+        // Inside string literals, and between words, characters are copied as they are
+        if (inStringLiteral || !isWordChar(c)) {
             substitutedLine += c;
+            i++;
             continue;
         }
-        
-        // If we are OUTSIDE a string literal, process variable names as before.
-        if (std::isalnum(c) || c == '_') {
-            currentToken += c;
-        } else {
-            // End of a token or variable name (OUTSIDE of quotes)
-            if (!currentToken.empty()) {
-                if (isVariableName(currentToken)) {
-                    if (vars.count(currentToken)) {
-                        substitutedLine += vars.at(currentToken).value;
-                    } else {
-                        std::cerr << "Substitution Error: Undefined variable '" << currentToken << "'" << std::endl;
-                        substitutedLine += "0"; 
-                    }
-                } else {
-                    substitutedLine += currentToken;
-                }
-                currentToken.clear();
-            }
-            substitutedLine += c;
+
+        // A whole word: numbers and keywords are copied, names are replaced by their values
+        size_t start = i;
+        while (i < line.length() && isWordChar(line[i])) i++;
+        std::string_view token(line.data() + start, i - start);
+        if (!isVariableName(token)) {
+            substitutedLine += token;
+            continue;
         }
-    }
-    
-    // Handle the last token if the line ended with a variable name (OUTSIDE of quotes)
-    if (!currentToken.empty()) {
-        if (isVariableName(currentToken)) {
-            if (vars.count(currentToken)) {
-                substitutedLine += vars.at(currentToken).value;
-            } else {
-                std::cerr << "Substitution Error: Undefined variable '" << currentToken << "'" << std::endl;
-                substitutedLine += "0";
-            }
+        auto it = vars.find(std::string(token));
+        if (it != vars.end()) {
+            substitutedLine += literalText(it->second, operands);
         } else {
-            substitutedLine += currentToken;
+            errors << "Substitution Error: Undefined variable '" << token << "'" << std::endl;
+            substitutedLine += "0";
         }
     }
-    
     return substitutedLine;
 }
 
 // --- New Helper Function Definition ---
-std::string handleInputCall(const std::string& line, const std::map<std::string, Variable>& vars) {
+std::string handleInputCall(const std::string& line, const std::map<std::string, Variable>& vars, std::istream& input = std::cin) {
     std::string processedLine = line;
     std::string::size_type pos = 0;
     const std::string INPUT_KEYWORD = "input";
@@ -171,7 +231,7 @@ std::string handleInputCall(const std::string& line, const std::map<std::string,
         
         // 2. Get User Input (No prompt evaluation needed)
         std::string user_input;
-        std::getline(std::cin, user_input);
+        std::getline(input, user_input);
         
         // 3. Replace the 'input' keyword with the result (quoted string literal)
         // This makes the result a valid string token for the Evaluator.
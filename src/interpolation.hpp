@@ -0,0 +1,107 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "helpers.hpp"
+
+/**
+ * @brief A string literal with ${} interpolations, parsed once.
+ * Literal segments hold their text with escapes already processed; expression segments hold
+ * the source of the expression between the braces. Rendering evaluates the expressions and
+ * appends everything to one buffer, sized from 'literalLength' and the values' lengths.
+ */
+struct InterpolationTemplate {
+    struct Segment {
+        std::string text;  // Literal text, or the expression's source
+        bool isExpression = false;
+        bool isVariable = false;  // The expression is a bare variable name, looked up directly
+    };
+
+    std::vector<Segment> segments;
+    size_t literalLength = 0;  // Length of all literal segments together
+    size_t expressionCount = 0;
+    std::string error;  // Set when an interpolation is empty or never closed
+};
+
+// Position of the quote that closes the string literal opening at 'open', or npos
+inline size_t findStringEnd(std::string_view text, size_t open) {
+    for (size_t i = open + 1; i < text.length(); ++i) {
+        if (text[i] == '\\') {
+            i++;
+        } else if (text[i] == '"') {
+            return i;
+        }
+    }
+    return std::string_view::npos;
+}
+
+// The character an escape stands for, given the character after the backslash (the Evaluator's escapes)
+inline char escapedChar(char next) {
+    return next == 'n' ? '\n' : next == 't' ? '\t' : next;
+}
+
+// The value of a string literal without interpolations, given the text between its quotes
+inline std::string unescapedLiteral(std::string_view body) {
+    std::string text;
+    text.reserve(body.length());
+    for (size_t i = 0; i < body.length(); ++i) {
+        if (body[i] == '\\' && i + 1 < body.length()) {
+            text += escapedChar(body[++i]);
+        } else {
+            text += body[i];
+        }
+    }
+    return text;
+}
+
+/**
+ * @brief Parses the text between a string literal's quotes.
+ * Escapes are processed like the Evaluator does (see escapedChar).
+ * An interpolation ends at the first '}', so its expression can't hold braces or string literals.
+ */
+inline InterpolationTemplate parseInterpolation(std::string_view body) {
+    InterpolationTemplate result;
+    std::string literal;
+    auto flushLiteral = [&]() {
+        if (!literal.empty()) {
+            result.literalLength += literal.length();
+            result.segments.push_back({ std::move(literal), false, false });
+            literal.clear();
+        }
+    };
+
+    size_t i = 0;
+    while (i < body.length()) {
+        char c = body[i];
+        if (c == '\\' && i + 1 < body.length()) {
+            literal += escapedChar(body[i + 1]);
+            i += 2;
+            continue;
+        }
+        if (c != '$' || i + 1 == body.length() || body[i + 1] != '{') {
+            literal += c;
+            i++;
+            continue;
+        }
+
+        size_t close = body.find('}', i + 2);
+        if (close == std::string_view::npos) {
+            result.error = "Syntax Error: Unterminated string interpolation sequence starting at " + std::string(body.substr(i));
+            return result;
+        }
+        std::string expression = trimmed(std::string(body.substr(i + 2, close - i - 2)));
+        if (expression.empty()) {
+            result.error = "Syntax Error: Empty string interpolation";
+            return result;
+        }
+        flushLiteral();
+        bool isVariable = isVariableName(expression);
+        result.segments.push_back({ std::move(expression), true, isVariable });
+        result.expressionCount++;
+        i = close + 1;
+    }
+    flushLiteral();
+    return result;
+}
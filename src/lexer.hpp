@@ -0,0 +1,221 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+// Whitespace, as the statement syntax sees it
+inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+inline bool isWordChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+inline std::string_view trimRight(std::string_view text) {
+    size_t end = text.length();
+    while (end > 0 && isSpace(text[end - 1])) end--;
+    return text.substr(0, end);
+}
+
+enum class Keyword : uint8_t {
+    None, True, False, Var, Print, Println, Input, Func, Return, If, Else, While, Import, End, Goto, EndBlock,
+    Style, Csv, Read, Snapshot, Spawn, Parallel, Send, Recv, Select, Close, Await, Sleep
+};
+
+struct KeywordEntry {
+    std::string_view text;
+    Keyword keyword = Keyword::None;
+};
+
+// The reserved words; none of them can name a variable
+constexpr KeywordEntry KEYWORDS[] = {
+    { "true", Keyword::True }, { "false", Keyword::False }, { "var", Keyword::Var }, { "print", Keyword::Print },
+    { "println", Keyword::Println }, { "input", Keyword::Input }, { "func", Keyword::Func }, { "return", Keyword::Return },
+    { "if", Keyword::If }, { "else", Keyword::Else }, { "while", Keyword::While }, { "import", Keyword::Import },
+    { "END", Keyword::End }, { "GOTO", Keyword::Goto }, { "end", Keyword::EndBlock }, { "STYLE", Keyword::Style },
+    { "csv", Keyword::Csv }, { "read", Keyword::Read }, { "snapshot", Keyword::Snapshot }, { "spawn", Keyword::Spawn },
+    { "parallel", Keyword::Parallel }, { "send", Keyword::Send }, { "recv", Keyword::Recv }, { "select", Keyword::Select },
+    { "close", Keyword::Close }, { "await", Keyword::Await }, { "sleep", Keyword::Sleep },
+};
+
+/**
+ * @brief A perfect hash of the keywords, built by the compiler.
+ * A word's slot comes from its first and last characters and its length; the length's factor is
+ * searched for at compile time so that no two keywords share a slot. Recognizing a word then
+ * takes one hash and at most one comparison.
+ */
+struct KeywordTable {
+    static constexpr size_t SIZE = 64;
+
+    static constexpr size_t slot(std::string_view word, size_t lengthFactor) {
+        return (static_cast<unsigned char>(word.front()) + 2 * static_cast<size_t>(static_cast<unsigned char>(word.back()))
+                + lengthFactor * word.length()) % SIZE;
+    }
+
+    // The first factor that gives every keyword its own slot, or SIZE if there's none
+    static constexpr size_t findLengthFactor() {
+        for (size_t factor = 0; factor < SIZE; ++factor) {
+            bool used[SIZE] = {};
+            bool perfect = true;
+            for (const KeywordEntry& entry : KEYWORDS) {
+                size_t index = slot(entry.text, factor);
+                perfect = perfect && !used[index];
+                used[index] = true;
+            }
+            if (perfect) return factor;
+        }
+        return SIZE;
+    }
+
+    KeywordEntry slots[SIZE] = {};
+};
+
+constexpr size_t KEYWORD_LENGTH_FACTOR = KeywordTable::findLengthFactor();
+static_assert(KEYWORD_LENGTH_FACTOR < KeywordTable::SIZE, "The keywords have no perfect hash; change KeywordTable::slot()");
+
+constexpr KeywordTable buildKeywordTable() {
+    KeywordTable table;
+    for (const KeywordEntry& entry : KEYWORDS) {
+        table.slots[KeywordTable::slot(entry.text, KEYWORD_LENGTH_FACTOR)] = entry;
+    }
+    return table;
+}
+
+constexpr KeywordTable KEYWORD_TABLE = buildKeywordTable();
+
+// The keyword 'word' is, or Keyword::None
+constexpr Keyword keywordOf(std::string_view word) {
+    if (word.empty()) {
+        return Keyword::None;
+    }
+    const KeywordEntry& entry = KEYWORD_TABLE.slots[KeywordTable::slot(word, KEYWORD_LENGTH_FACTOR)];
+    return entry.text == word ? entry.keyword : Keyword::None;
+}
+
+static_assert(keywordOf("println") == Keyword::Println && keywordOf("end") == Keyword::EndBlock && keywordOf("x") == Keyword::None,
+              "Keyword lookup is broken");
+
+/**
+ * @brief A token of a source line, by its position in the line.
+ * Words are identifiers and keywords, which are recognized as they're read; numbers are runs of
+ * digits and dots. Strings include their quotes (an unterminated one runs to the end of the line).
+ * Anything else is a one-character symbol.
+ */
+struct Token {
+    enum class Kind { Word, Number, String, Symbol, End };
+
+    Kind kind = Kind::End;
+    size_t offset = 0;
+    size_t length = 0;
+    bool spaceBefore = false;  // Whitespace separates it from the previous token
+    Keyword keyword = Keyword::None;  // The keyword a word is, if any
+};
+
+/**
+ * @brief Splits one line into tokens, left to right, without copying it.
+ * Statements only tokenize their head (keywords, names and punctuation); the expressions after
+ * it are taken as they are with rest(), for the interpreter to evaluate.
+ */
+class Lexer {
+public:
+    explicit Lexer(std::string_view line) : line(line) {}
+
+    Token next() {
+        Token token;
+        size_t start = position;
+        while (position < line.length() && isSpace(line[position])) position++;
+        token.spaceBefore = position > start;
+        token.offset = position;
+        if (position == line.length()) {
+            return token;
+        }
+
+        char c = line[position];
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_') {
+            token.kind = Token::Kind::Word;
+            while (position < line.length() && isWordChar(line[position])) position++;
+            token.keyword = keywordOf(line.substr(token.offset, position - token.offset));
+        } else if ((c >= '0' && c <= '9') || c == '.') {
+            token.kind = Token::Kind::Number;
+            while (position < line.length() && ((line[position] >= '0' && line[position] <= '9') || line[position] == '.')) position++;
+        } else if (c == '"') {
+            token.kind = Token::Kind::String;
+            position++;
+            while (position < line.length() && line[position] != '"') {
+                position += line[position] == '\\' ? 2 : 1;
+            }
+            position = position < line.length() ? position + 1 : line.length();
+        } else {
+            token.kind = Token::Kind::Symbol;
+            position++;
+        }
+        token.length = position - token.offset;
+        return token;
+    }
+
+    Token peek() const {
+        Lexer copy = *this;
+        return copy.next();
+    }
+
+    std::string_view text(const Token& token) const { return line.substr(token.offset, token.length); }
+
+    bool isWord(const Token& token, std::string_view word) const {
+        return token.kind == Token::Kind::Word && text(token) == word;
+    }
+
+    bool isSymbol(const Token& token, char symbol) const {
+        return token.kind == Token::Kind::Symbol && line[token.offset] == symbol;
+    }
+
+    // The next token, if it's the symbol; otherwise nothing is consumed
+    bool accept(char symbol) {
+        if (!isSymbol(peek(), symbol)) {
+            return false;
+        }
+        next();
+        return true;
+    }
+
+    // True if whitespace follows the last token
+    bool spaceAhead() const { return position < line.length() && isSpace(line[position]); }
+
+    // True if nothing but whitespace is left
+    bool atEnd() const { return peek().kind == Token::Kind::End; }
+
+    size_t offset() const { return position; }
+
+    // Everything after the last token and the whitespace that follows it
+    std::string_view rest() const {
+        size_t start = position;
+        while (start < line.length() && isSpace(line[start])) start++;
+        return line.substr(start);
+    }
+
+    /**
+     * @brief rest(), for a statement that needs a non-empty operand after at least one space.
+     * When only whitespace is left, the operand is the last of it, provided one space still
+     * separates it from the keyword; otherwise there is none and this returns false.
+     */
+    bool nonEmptyRest(std::string_view& operand) const {
+        if (!spaceAhead()) {
+            return false;
+        }
+        operand = rest();
+        if (!operand.empty()) {
+            return true;
+        }
+        if (line.length() - position < 2) {
+            return false;
+        }
+        operand = line.substr(line.length() - 1);
+        return true;
+    }
+
+private:
+    std::string_view line;
+    size_t position = 0;
+};
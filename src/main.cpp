@@ -1,5 +1,5 @@
-// TODO: Add while loops, dictionaries, arrays, piping, filters. Add return values in function.hpp.
-// Add "filters" and "piping (->)"
+// TODO: Add while loops, dictionaries, filter blocks.
+// Add "filters" as pipe stages ("->" already pipes into filter(condition) and native or built-in functions)
 // Filter example (end style):
 // filter MyFilter
 //     201+ => 200
@@ -17,9 +17,6 @@
 //    age: 30,
 //    isStudent: false
 // }
-//
-// Array example:
-// arr numbers = [1, 2, 3, 4, 5]
 
 #include <iostream>
 #include <string>
@@ -30,11 +27,93 @@
 #include "executionengine.hpp"
 #include "variable.hpp"
 #include "helpers.hpp"
+#include "benchmark.hpp"
+#include "batchrunner.hpp"
+
+// Usage: sphynx [script.sph] [--bench-create N] [--bench-batch N] [--bench-vector N] [--bench-parse N] [--resume file.snap] [--dump-ast]
+//        sphynx --batch [--threads N] a.sph b.sph ...
+int main(int argc, char* argv[]) {
+    std::string scriptFilename = "script.sph";
+    int benchCreateIterations = 0;
+    std::string snapshotFilename;
+    int benchBatchCount = 0;
+    size_t benchVectorCount = 0;
+    size_t benchParseLines = 0;
+    bool dumpAst = false;
+    bool batchMode = false;
+    size_t batchThreads = 0;
+    std::vector<std::string> batchFiles;
 
-int main() {
-    const std::string scriptFilename = "script.sph";
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--bench-create" && i + 1 < argc) {
+            benchCreateIterations = std::stoi(argv[++i]);
+        } else if (arg == "--bench-batch" && i + 1 < argc) {
+            benchBatchCount = std::stoi(argv[++i]);
+        } else if (arg == "--bench-vector" && i + 1 < argc) {
+            benchVectorCount = std::stoul(argv[++i]);
+        } else if (arg == "--bench-parse" && i + 1 < argc) {
+            benchParseLines = std::stoul(argv[++i]);
+        } else if (arg == "--resume" && i + 1 < argc) {
+            snapshotFilename = argv[++i];
+        } else if (arg == "--dump-ast") {
+            dumpAst = true;
+        } else if (arg == "--batch") {
+            batchMode = true;
+        } else if (arg == "--threads" && i + 1 < argc) {
+            batchThreads = std::stoul(argv[++i]);
+        } else if (batchMode) {
+            batchFiles.push_back(arg);
+        } else {
+            scriptFilename = arg;
+        }
+    }
 
     try {
+        if (benchCreateIterations > 0) {
+            benchmarkEngineCreation(scriptFilename, benchCreateIterations);
+            return 0;
+        }
+        if (benchBatchCount > 0) {
+            benchmarkBatch(scriptFilename, benchBatchCount);
+            return 0;
+        }
+        if (benchVectorCount > 0) {
+            benchmarkVectorKernels(benchVectorCount);
+            return 0;
+        }
+        if (benchParseLines > 0) {
+            benchmarkParse(benchParseLines);
+            return 0;
+        }
+
+        // Print the script's syntax tree instead of running it
+        if (dumpAst) {
+            Program::fromFile(scriptFilename)->syntaxTree().dump(std::cout);
+            return 0;
+        }
+
+        // Run every script concurrently, then print their outputs in argument order
+        if (batchMode) {
+            BatchRunner runner(batchThreads);
+            for (const std::string& file : batchFiles) {
+                runner.addFile(file);
+            }
+            std::vector<BatchResult> results = runner.run();
+            BatchRunner::writeResults(results, std::cout, std::cerr);
+            for (const BatchResult& result : results) {
+                if (result.failed) return 1;
+            }
+            return 0;
+        }
+
+        // Continue from a snapshot instead of running the script's initialization again
+        if (!snapshotFilename.empty()) {
+            std::unique_ptr<ExecutionEngine> engine = ExecutionEngine::loadSnapshot(snapshotFilename);
+            engine->run();
+            return 0;
+        }
+
         ExecutionEngine engine(scriptFilename);
         engine.run();
     } catch (const std::runtime_error& e) {
@@ -0,0 +1,830 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <set>
+#include <memory>
+#include <stdexcept>
+#include <cctype>
+#include <charconv>
+
+#include "function.hpp"
+#include "helpers.hpp"
+#include "lexer.hpp"
+#include "interpolation.hpp"
+#include "format.hpp"
+#include "snapshot.hpp"
+#include "statement.hpp"
+#include "ast.hpp"
+#include "resolver.hpp"
+#include "typeinference.hpp"
+#include "typedcode.hpp"
+
+/**
+ * @brief A compiled script.
+ * Immutable once built, so one Program can be shared by any number of ExecutionEngines.
+ */
+class Program {
+public:
+    // Syntax errors found while compiling are reported to 'errors'
+    static std::shared_ptr<const Program> fromFile(const std::string& filename, std::ostream& errors = std::cerr) {
+        std::ifstream file(filename);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open script file: " + filename);
+        }
+        std::stringstream contents;
+        contents << file.rdbuf();
+        return fromString(contents.str(), filename, errors);
+    }
+
+    static std::shared_ptr<const Program> fromString(const std::string& source, const std::string& name = "<string>",
+                                                     std::ostream& errors = std::cerr) {
+        return fromBuffer(source.data(), source.size(), name, errors);
+    }
+
+    static std::shared_ptr<const Program> fromBuffer(const char* data, size_t size, const std::string& name = "<buffer>",
+                                                     std::ostream& errors = std::cerr) {
+        std::shared_ptr<Program> program(new Program());
+        program->name = name;
+
+        // Add a dummy empty line at index 0 so line 1 is at index 1
+        std::vector<std::string> lines;
+        lines.push_back("");
+
+        size_t start = 0;
+        while (start < size) {
+            size_t end = start;
+            while (end < size && data[end] != '\n') end++;
+            size_t lineEnd = end;
+            if (lineEnd > start && data[lineEnd - 1] == '\r') lineEnd--;
+            lines.emplace_back(data + start, lineEnd - start);
+            start = end + 1;
+        }
+
+        // Add a dummy empty line at the end
+        lines.push_back("");
+
+        program->compile(lines, errors);
+        return program;
+    }
+
+    const std::string& getName() const { return name; }
+
+    // Number of lines, including the padding lines at both ends
+    int size() const { return static_cast<int>(statements.size()); }
+
+    const Statement& at(int line) const { return statements[line]; }
+
+    const Function* findFunction(const std::string& funcName) const {
+        auto it = functions.find(funcName);
+        return it == functions.end() ? nullptr : &it->second;
+    }
+
+    // The template of an interpolated string literal in the script, by the text between its quotes
+    const InterpolationTemplate* findInterpolation(std::string_view body) const {
+        auto it = interpolations.find(body);
+        return it == interpolations.end() ? nullptr : &it->second;
+    }
+
+    // The parsed form of a format string given as a literal to format() or printf() in the script
+    const FormatSpec* findFormat(std::string_view format) const {
+        auto it = formats.find(format);
+        return it == formats.end() ? nullptr : &it->second;
+    }
+
+    // The syntax tree, with every name resolved and every type inferred
+    const SyntaxTree& syntaxTree() const { return *tree; }
+
+    // The names no declaration in the script binds. The engine reports the ones its host didn't define either.
+    const std::vector<NameError>& nameErrors() const { return unresolvedNames; }
+
+    // The typed code of a line, or nullptr if it's evaluated as text
+    const TypedCode* typedCode(int line) const {
+        if (line < 0 || static_cast<size_t>(line) >= typedLines.size()) {
+            return nullptr;
+        }
+        const TypedCode& code = typedLines[line];
+        return code.type == ValueType::Unknown ? nullptr : &code;
+    }
+
+    // Writes the compiled statements and function table, so loading them needs no parsing
+    void save(SnapshotWriter& out) const {
+        out.str(name);
+        out.u32(static_cast<uint32_t>(statements.size()));
+        for (const Statement& statement : statements) {
+            out.u32(static_cast<uint32_t>(statement.kind));
+            out.str(statement.text);
+            out.strings32(statement.args);
+            out.str(statement.callee);
+            out.strings32(statement.callArgs);
+            out.i32(statement.blockEnd);
+            out.flag(statement.isSpawn);
+            out.flag(statement.isolated);
+            out.flag(statement.isAwait);
+            out.flag(statement.isRecv);
+            out.flag(statement.readsInput);
+        }
+
+        out.u32(static_cast<uint32_t>(functions.size()));
+        for (const auto& entry : functions) {
+            out.str(entry.second.name);
+            out.strings32(entry.second.parameters);
+            out.i32(entry.second.startingLine);
+        }
+    }
+
+    static std::shared_ptr<const Program> load(SnapshotReader& in) {
+        std::shared_ptr<Program> program(new Program());
+        program->name = std::string(in.str());
+
+        program->statements.resize(in.u32());
+        for (Statement& statement : program->statements) {
+            uint32_t kind = in.u32();
+            if (kind > static_cast<uint32_t>(StatementKind::Unknown)) {
+                throw std::runtime_error("Snapshot Error: Unknown statement kind");
+            }
+            statement.kind = static_cast<StatementKind>(kind);
+            statement.text = std::string(in.str());
+            statement.args = in.strings32();
+            statement.callee = std::string(in.str());
+            statement.callArgs = in.strings32();
+            statement.blockEnd = in.i32();
+            statement.isSpawn = in.flag();
+            statement.isolated = in.flag();
+            statement.isAwait = in.flag();
+            statement.isRecv = in.flag();
+            statement.readsInput = in.flag();
+        }
+
+        uint32_t functionCount = in.u32();
+        for (uint32_t i = 0; i < functionCount; ++i) {
+            std::string funcName(in.str());
+            std::vector<std::string> parameters = in.strings32();
+            int startingLine = in.i32();
+            program->functions.emplace(funcName, Function(funcName, parameters, startingLine));
+        }
+        program->analyzeFunctions();
+        program->parseInterpolations();
+        program->parseFormats();
+        program->buildSyntaxTree();
+        program->unresolvedNames = NameResolver::check(*program->tree);
+        return program;
+    }
+
+private:
+    std::string name;
+    std::vector<Statement> statements;
+    std::map<std::string, Function> functions;
+    std::map<std::string, InterpolationTemplate, std::less<>> interpolations;
+    std::map<std::string, FormatSpec, std::less<>> formats;
+    std::unique_ptr<const SyntaxTree> tree;
+    std::vector<TypedCode> typedLines;  // By line
+    std::vector<NameError> unresolvedNames;  // By line
+
+    Program() = default;
+
+    /**
+     * @brief Classifies every line (see parseStatement).
+     * STYLE lines switch the style for the lines that follow them.
+     */
+    void compile(const std::vector<std::string>& lines, std::ostream& errors) {
+        statements.resize(lines.size());
+        std::vector<bool> lineIsBrackets(lines.size(), false);
+        bool isBrackets = false;  // "end" is the default style
+
+        for (size_t i = 1; i + 1 < lines.size(); ++i) {
+            const std::string& line = lines[i];
+            Statement& statement = statements[i];
+            std::vector<std::string> parameters;
+
+            statement.text = line;
+            parseStatement(line, isBrackets, statement, &parameters);
+
+            switch (statement.kind) {
+            case StatementKind::Style:
+                if (statement.args[0] == "brackets") isBrackets = true;
+                if (statement.args[0] == "end") isBrackets = false;
+                break;
+            case StatementKind::FunctionDef:
+                functions.emplace(statement.args[0], Function(statement.args[0], std::move(parameters), static_cast<int>(i)));
+                break;
+            case StatementKind::Send:
+                if (statement.args.size() != 2) {
+                    errors << "Syntax Error on line " << i << ": Expected 'send channel, value'." << std::endl;
+                    statement.kind = StatementKind::Unknown;
+                }
+                break;
+            case StatementKind::Declaration:
+            case StatementKind::Assignment:
+                parseValue(statement);
+                break;
+            default:
+                break;
+            }
+
+            statement.readsInput = containsWord(line, "input");
+            lineIsBrackets[i] = isBrackets;
+        }
+
+        for (size_t i = 1; i + 1 < lines.size(); ++i) {
+            if (statements[i].kind == StatementKind::If || statements[i].kind == StatementKind::FunctionDef) {
+                statements[i].blockEnd = findBlockEnd(lines, static_cast<int>(i) + 1, lineIsBrackets[i], errors);
+            }
+        }
+
+        analyzeFunctions();
+        parseInterpolations();
+        parseFormats();
+        buildSyntaxTree();
+        unresolvedNames = NameResolver::check(*tree);
+    }
+
+    // Builds the syntax tree, infers its types and compiles the lines they make typed
+    void buildSyntaxTree() {
+        std::unique_ptr<SyntaxTree> built = SyntaxTree::build(statements, functions);
+        TypeInference::run(*built);
+        typedLines = TypedCompiler::compile(*built, statements.size());
+        tree = std::move(built);
+    }
+
+    // Parses every string literal with a ${} interpolation once, so running a line only renders it
+    void parseInterpolations() {
+        for (const Statement& statement : statements) {
+            std::string_view text = statement.text;
+            size_t open = text.find('"');
+            while (open != std::string_view::npos && text.find("${", open) != std::string_view::npos) {
+                size_t close = findStringEnd(text, open);
+                if (close == std::string_view::npos) {
+                    break;
+                }
+                std::string_view body = text.substr(open + 1, close - open - 1);
+                if (body.find("${") != std::string_view::npos && interpolations.find(body) == interpolations.end()) {
+                    interpolations.emplace(std::string(body), parseInterpolation(body));
+                }
+                open = text.find('"', close + 1);
+            }
+        }
+    }
+
+    /**
+     * @brief Works out which functions are pure (see Function::impurity).
+     * A function is checked on its own first, then impurity and host calls are passed from
+     * callees to callers until nothing changes, so recursion needs no special case.
+     */
+    void analyzeFunctions() {
+        std::map<std::string, std::set<std::string>> scriptCalls;
+        for (auto& entry : functions) {
+            checkFunctionBody(entry.second, scriptCalls[entry.first]);
+        }
+
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (auto& entry : functions) {
+                Function& func = entry.second;
+                for (const std::string& calleeName : scriptCalls[entry.first]) {
+                    const Function& callee = functions.at(calleeName);
+                    if (func.impurity.empty() && !callee.impurity.empty()) {
+                        func.impurity = "calls '" + calleeName + "', which " + callee.impurity;
+                        changed = true;
+                    }
+                    for (const std::string& host : callee.hostCalls) {
+                        changed = func.hostCalls.insert(host).second || changed;
+                    }
+                }
+            }
+        }
+    }
+
+    // Checks the statements of one function, collecting the script functions it calls
+    void checkFunctionBody(Function& func, std::set<std::string>& scriptCalls) const {
+        int end = statements[func.startingLine].blockEnd;
+        if (end == -1) {
+            func.impurity = "has no end";
+            return;
+        }
+
+        std::set<std::string> locals(func.parameters.begin(), func.parameters.end());
+        for (int line = func.startingLine + 1; line < end; ++line) {
+            if (statements[line].kind == StatementKind::Declaration) {
+                locals.insert(statements[line].args[0]);
+            }
+        }
+
+        for (int line = func.startingLine + 1; line < end && func.impurity.empty(); ++line) {
+            const Statement& statement = statements[line];
+            std::string where = " on line " + std::to_string(line);
+
+            switch (statement.kind) {
+            case StatementKind::Empty:
+            case StatementKind::Comment:
+            case StatementKind::Style:
+            case StatementKind::CloseBlock:
+            case StatementKind::Return:
+                continue;
+            case StatementKind::Goto: {
+                const std::string& text = statement.args[0];
+                int target = 0;
+                auto parsed = std::from_chars(text.data(), text.data() + text.length(), target);
+                if (parsed.ec != std::errc() || parsed.ptr != text.data() + text.length()
+                    || target <= func.startingLine || target >= end) {
+                    func.impurity = "jumps out of its body" + where;
+                }
+                continue;
+            }
+            case StatementKind::If:
+            case StatementKind::ReturnValue:
+            case StatementKind::Call:
+            case StatementKind::Declaration:
+                break;
+            case StatementKind::Assignment:
+                if (locals.count(statement.args[0]) == 0) {
+                    func.impurity = "writes the global '" + statement.args[0] + "'" + where;
+                }
+                break;
+            case StatementKind::Print:
+            case StatementKind::Println:
+                func.impurity = "prints" + where;
+                break;
+            case StatementKind::Exec:
+                func.impurity = "runs a command" + where;
+                break;
+            case StatementKind::CsvOpen:
+            case StatementKind::CsvRead:
+                func.impurity = "reads a CSV file" + where;
+                break;
+            case StatementKind::Snapshot:
+                func.impurity = "writes a snapshot" + where;
+                break;
+            case StatementKind::Spawn:
+            case StatementKind::Await:
+            case StatementKind::Sleep:
+                func.impurity = "uses tasks" + where;
+                break;
+            case StatementKind::Send:
+            case StatementKind::Recv:
+            case StatementKind::Select:
+            case StatementKind::Close:
+                func.impurity = "uses channels" + where;
+                break;
+            case StatementKind::End:
+            case StatementKind::FunctionDef:
+            case StatementKind::Unknown:
+                func.impurity = "has an unsupported statement" + where;
+                break;
+            }
+            if (func.impurity.empty() && (statement.isSpawn || statement.isAwait)) {
+                func.impurity = "uses tasks" + where;
+            } else if (func.impurity.empty() && statement.isRecv) {
+                func.impurity = "uses channels" + where;
+            } else if (func.impurity.empty() && statement.readsInput) {
+                func.impurity = "reads input" + where;
+            }
+            if (!func.impurity.empty()) {
+                break;
+            }
+
+            // Every name the line uses must be a local, a function or a host call
+            for (const auto& name : referencedNames(statement.text)) {
+                if (functions.count(name.first) > 0) {
+                    scriptCalls.insert(name.first);
+                } else if (name.second) {
+                    func.hostCalls.insert(name.first);
+                } else if (locals.count(name.first) == 0) {
+                    func.impurity = "reads the global '" + name.first + "'" + where;
+                    break;
+                }
+            }
+        }
+    }
+
+    // Parses the literal format strings of format() and printf() calls once, so calls only format their values
+    void parseFormats() {
+        for (const Statement& statement : statements) {
+            std::string_view text = statement.text;
+            for (std::string_view callee : { std::string_view("format"), std::string_view("printf") }) {
+                for (size_t at = text.find(callee); at != std::string_view::npos; at = text.find(callee, at + 1)) {
+                    size_t open = text.find_first_not_of(' ', at + callee.length());
+                    if ((at > 0 && (std::isalnum(text[at - 1]) || text[at - 1] == '_')) || open == std::string_view::npos || text[open] != '(') {
+                        continue;
+                    }
+                    size_t quote = text.find_first_not_of(' ', open + 1);
+                    size_t close = quote == std::string_view::npos || text[quote] != '"' ? quote : findStringEnd(text, quote);
+                    if (close == std::string_view::npos || text[quote] != '"') {
+                        continue;
+                    }
+                    std::string_view body = text.substr(quote + 1, close - quote - 1);
+                    if (body.find("${") == std::string_view::npos) {
+                        std::string format = unescapedLiteral(body);
+                        if (formats.find(format) == formats.end()) {
+                            FormatSpec spec = parseFormat(format);
+                            formats.emplace(std::move(format), std::move(spec));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Identifiers in a line, outside string literals but including ${} interpolations,
+    // each with whether it's followed by '(' (a call)
+    static std::vector<std::pair<std::string, bool>> referencedNames(const std::string& line) {
+        std::vector<std::pair<std::string, bool>> names;
+        bool inStringLiteral = false;
+        size_t i = 0;
+        while (i < line.length()) {
+            char c = line[i];
+            if (c == '"') {
+                inStringLiteral = !inStringLiteral;
+                i++;
+                continue;
+            }
+            if (inStringLiteral) {
+                if (c == '$' && i + 1 < line.length() && line[i + 1] == '{') {
+                    size_t close = line.find('}', i + 2);
+                    if (close == std::string::npos) break;
+                    for (auto& name : referencedNames(line.substr(i + 2, close - i - 2))) {
+                        names.push_back(std::move(name));
+                    }
+                    i = close + 1;
+                } else {
+                    i++;
+                }
+                continue;
+            }
+            if (!(std::isalpha(c) || c == '_')) {
+                i++;
+                continue;
+            }
+
+            size_t start = i;
+            while (i < line.length() && (std::isalnum(line[i]) || line[i] == '_')) i++;
+            std::string name = line.substr(start, i - start);
+            if (!isVariableName(name)) {
+                continue;
+            }
+            size_t next = line.find_first_not_of(' ', i);
+            names.emplace_back(name, next != std::string::npos && line[next] == '(');
+        }
+        return names;
+    }
+
+    /**
+     * @brief Classifies one line and splits it into the statement's parts, in a single pass over
+     * its head. The forms are tried in a fixed order, so "print = 1" is an assignment and
+     * "x == 1" assigns "= 1". Function parameters go to 'parameters', when given.
+     */
+    static void parseStatement(std::string_view line, bool isBrackets, Statement& statement,
+                               std::vector<std::string>* parameters = nullptr) {
+        Lexer lexer(line);
+        Token first = lexer.next();
+        std::string_view word = first.kind == Token::Kind::Word ? lexer.text(first) : std::string_view();
+        Keyword keyword = first.keyword;
+        auto set = [&](StatementKind kind, std::initializer_list<std::string_view> args) {
+            statement.kind = kind;
+            statement.args.assign(args.begin(), args.end());
+        };
+
+        // Forms that come before assignments
+        if (!line.empty() && line[0] == '#') {
+            statement.kind = StatementKind::Comment;
+            return;
+        }
+        if (first.kind == Token::Kind::End) {
+            statement.kind = StatementKind::Empty;
+            return;
+        }
+        if (keyword == Keyword::Style && parseStyle(lexer, statement)) {
+            return;
+        }
+        if ((keyword == Keyword::End || (keyword == Keyword::EndBlock && !isBrackets) || (isBrackets && lexer.isSymbol(first, '}'))) && lexer.atEnd()) {
+            statement.kind = keyword == Keyword::End ? StatementKind::End : StatementKind::CloseBlock;
+            return;
+        }
+        if (keyword == Keyword::Return) {
+            std::string_view value = trimRight(lexer.rest());
+            if (value.empty() || value == ";") {
+                statement.kind = StatementKind::Return;
+                return;
+            }
+            if (lexer.spaceAhead()) {
+                set(StatementKind::ReturnValue, { value.back() == ';' ? value.substr(0, value.length() - 1) : value });
+                return;
+            }
+        }
+        if (keyword == Keyword::Func && lexer.spaceAhead()) {
+            Lexer definition = lexer;
+            Token name = definition.next();
+            std::string_view params;
+            if (name.kind == Token::Kind::Word && definition.accept('(') && closesAtEnd(line, definition.offset(), isBrackets, params)) {
+                set(StatementKind::FunctionDef, { definition.text(name) });
+                if (parameters != nullptr) {
+                    *parameters = splitAndTrimArgs(std::string(params));
+                }
+                return;
+            }
+        }
+        if (keyword == Keyword::Goto && lexer.spaceAhead()) {
+            Lexer jump = lexer;
+            Token target = jump.next();
+            std::string_view digits = jump.text(target);
+            if (target.kind == Token::Kind::Number && digits.find('.') == std::string_view::npos && jump.atEnd()) {
+                set(StatementKind::Goto, { digits });
+                return;
+            }
+        }
+        if (keyword == Keyword::If && lexer.spaceAhead()) {
+            std::string_view condition = lexer.rest();
+            if (!isBrackets) {
+                set(StatementKind::If, { condition });
+                return;
+            }
+            std::string_view head = trimRight(condition);
+            if (!head.empty() && head.back() == '{') {
+                set(StatementKind::If, { head.substr(0, head.length() - 1) });
+                return;
+            }
+        }
+        if (keyword == Keyword::Var && lexer.spaceAhead()) {
+            Lexer declaration = lexer;
+            Token name = declaration.next();
+            if (name.kind == Token::Kind::Word && declaration.accept('=')) {
+                set(StatementKind::Declaration, { declaration.text(name), declaration.rest() });
+                return;
+            }
+        }
+        if (first.kind == Token::Kind::Word) {
+            Lexer assignment = lexer;
+            if (assignment.accept('=')) {
+                set(StatementKind::Assignment, { word, assignment.rest() });
+                return;
+            }
+        }
+
+        // Keyword statements
+        std::string_view operand;
+        if ((keyword == Keyword::Print || keyword == Keyword::Println || keyword == Keyword::Snapshot
+             || keyword == Keyword::Await || keyword == Keyword::Sleep || word == "exec") && lexer.spaceAhead()) {
+            StatementKind kind = keyword == Keyword::Print ? StatementKind::Print
+                               : keyword == Keyword::Println ? StatementKind::Println
+                               : keyword == Keyword::Snapshot ? StatementKind::Snapshot
+                               : keyword == Keyword::Await ? StatementKind::Await
+                               : keyword == Keyword::Sleep ? StatementKind::Sleep : StatementKind::Exec;
+            set(kind, { lexer.rest() });
+            return;
+        }
+        if ((keyword == Keyword::Spawn || keyword == Keyword::Parallel) && lexer.spaceAhead()) {
+            statement.kind = StatementKind::Spawn;
+            statement.isolated = keyword == Keyword::Parallel;
+            parseCall(lexer.rest(), statement);
+            return;
+        }
+        if ((keyword == Keyword::Send || keyword == Keyword::Recv || keyword == Keyword::Close) && lexer.nonEmptyRest(operand)) {
+            if (keyword == Keyword::Send) {
+                statement.kind = StatementKind::Send;
+                statement.args = splitAndTrimArgs(std::string(operand));
+            } else {
+                set(keyword == Keyword::Recv ? StatementKind::Recv : StatementKind::Close, { operand });
+            }
+            return;
+        }
+        if (keyword == Keyword::Csv && lexer.spaceAhead() && parseCsv(lexer, statement)) {
+            return;
+        }
+        if (keyword == Keyword::Read && lexer.spaceAhead()) {
+            Token name = lexer.next();
+            if (name.kind == Token::Kind::Word && lexer.atEnd()) {
+                set(StatementKind::CsvRead, { lexer.text(name), "" });
+                return;
+            }
+            bool into = name.kind == Token::Kind::Word && lexer.spaceAhead() && lexer.isWord(lexer.peek(), "into");
+            Lexer target = lexer;
+            if (into && (target.next(), target.spaceAhead())) {
+                set(StatementKind::CsvRead, { lexer.text(name), trimRight(target.rest()) });
+                return;
+            }
+        }
+        if (keyword == Keyword::Select && lexer.spaceAhead() && parseSelect(lexer, statement)) {
+            return;
+        }
+
+        std::vector<std::string> args;
+        std::string_view callee;
+        if (matchCall(line, callee, args)) {
+            statement.kind = StatementKind::Call;
+            statement.callee = std::string(callee);
+            statement.callArgs = std::move(args);
+            return;
+        }
+        statement.kind = StatementKind::Unknown;
+    }
+
+    // STYLE = end, STYLE = "brackets": the lexer is just after STYLE
+    static bool parseStyle(Lexer lexer, Statement& statement) {
+        if (!lexer.accept('=')) {
+            return false;
+        }
+        std::string_view style = trimRight(lexer.rest());
+        if (!style.empty() && (style.front() == '"' || style.front() == '\'')) style.remove_prefix(1);
+        if (!style.empty() && (style.back() == '"' || style.back() == '\'')) style.remove_suffix(1);
+        if (style.empty() || style.find_first_not_of("abcdefghijklmnopqrstuvwxyz") != std::string_view::npos) {
+            return false;
+        }
+        statement.kind = StatementKind::Style;
+        statement.args = { std::string(style) };
+        return true;
+    }
+
+    /**
+     * @brief The inside of a parenthesis opened just before 'from', when it closes at the end of
+     * the line (before a final '{' in the brackets style). The closing parenthesis is the last one.
+     */
+    static bool closesAtEnd(std::string_view line, size_t from, bool beforeBrace, std::string_view& inside) {
+        std::string_view head = trimRight(line);
+        if (beforeBrace) {
+            if (head.empty() || head.back() != '{') return false;
+            head = trimRight(head.substr(0, head.length() - 1));
+        }
+        if (head.length() <= from || head.back() != ')') {
+            return false;
+        }
+        inside = line.substr(from, head.length() - 1 - from);
+        return true;
+    }
+
+    // name(args) up to the end of the text; the arguments run to the last ')'
+    static bool matchCall(std::string_view text, std::string_view& callee, std::vector<std::string>& args) {
+        Lexer lexer(text);
+        Token name = lexer.next();
+        std::string_view inside;
+        if (name.kind != Token::Kind::Word || !lexer.accept('(') || !closesAtEnd(text, lexer.offset(), false, inside)) {
+            return false;
+        }
+        callee = lexer.text(name);
+        args = splitAndTrimArgs(std::string(inside));
+        return true;
+    }
+
+    // csv name = path [as types]: the path ends at the first " as " followed only by type names
+    static bool parseCsv(Lexer lexer, Statement& statement) {
+        Token name = lexer.next();
+        if (name.kind != Token::Kind::Word || !lexer.accept('=')) {
+            return false;
+        }
+        std::string_view rest = lexer.rest();
+        std::string_view path = trimRight(rest);
+        std::string_view types;
+        for (size_t p = 0; p < path.length(); ++p) {
+            if (!isSpace(rest[p])) continue;
+            size_t as = p;
+            while (as < rest.length() && isSpace(rest[as])) as++;
+            if (rest.compare(as, 2, "as") != 0 || as + 3 >= rest.length() || !isSpace(rest[as + 2])) continue;
+            std::string_view list = rest.substr(as + 2);
+            if (list.find_first_not_of("abcdefghijklmnopqrstuvwxyz, \t\r\n\v\f") != std::string_view::npos) continue;
+            size_t start = 0;
+            while (start < list.length() && isSpace(list[start])) start++;
+            types = start < list.length() ? list.substr(start) : list.substr(list.length() - 1);
+            path = rest.substr(0, p);
+            break;
+        }
+        statement.kind = StatementKind::CsvOpen;
+        statement.args = { std::string(lexer.text(name)), std::string(path), std::string(types) };
+        return true;
+    }
+
+    // select index, value from channels [timeout ms]: the channels end at the first " timeout "
+    static bool parseSelect(Lexer lexer, Statement& statement) {
+        Token index = lexer.next();
+        if (index.kind != Token::Kind::Word || !lexer.accept(',')) return false;
+        Token value = lexer.next();
+        if (value.kind != Token::Kind::Word || !lexer.spaceAhead() || !lexer.isWord(lexer.next(), "from")) return false;
+        std::string_view channels;
+        if (!lexer.nonEmptyRest(channels)) return false;
+
+        std::string_view timeout;
+        for (size_t p = 1; p < channels.length(); ++p) {
+            if (!isSpace(channels[p])) continue;
+            Lexer after(channels.substr(p));
+            if (after.isWord(after.next(), "timeout") && after.nonEmptyRest(timeout)) {
+                channels = channels.substr(0, p);
+                break;
+            }
+        }
+        statement.kind = StatementKind::Select;
+        statement.args = { std::string(lexer.text(index)), std::string(lexer.text(value)), std::string(channels), std::string(timeout) };
+        return true;
+    }
+
+    // The value of a declaration or assignment may start with spawn, await or recv, or be exactly one call
+    static void parseValue(Statement& statement) {
+        std::string_view value = statement.args[1];
+        Lexer lexer(value);
+        Token first = lexer.next();
+        std::string_view operand;
+        if ((first.keyword == Keyword::Spawn || first.keyword == Keyword::Parallel) && lexer.spaceAhead()) {
+            statement.isSpawn = true;
+            statement.isolated = first.keyword == Keyword::Parallel;
+            parseCall(lexer.rest(), statement);
+        } else if (first.keyword == Keyword::Await && lexer.spaceAhead()) {
+            statement.isAwait = true;
+            statement.args[1] = std::string(lexer.rest());
+        } else if (first.keyword == Keyword::Recv && lexer.nonEmptyRest(operand)) {
+            statement.isRecv = true;
+            statement.args[1] = std::string(operand);
+        } else {
+            parseCall(value, statement);
+        }
+    }
+
+    // Splits "f(a, b)" into the statement's callee and call arguments; leaves callee empty otherwise
+    static void parseCall(std::string_view call, Statement& statement) {
+        std::vector<std::string> args;
+        std::string_view callee;
+        if (matchCall(call, callee, args) && isSingleCall(std::string(call))) {
+            statement.callee = std::string(callee);
+            statement.callArgs = std::move(args);
+        }
+    }
+
+    // True if 'word' appears in the line as a whole word, outside string literals
+    static bool containsWord(const std::string& line, const std::string& word) {
+        bool inStringLiteral = false;
+        for (size_t i = 0; i < line.length(); ++i) {
+            if (line[i] == '"') inStringLiteral = !inStringLiteral;
+            if (inStringLiteral || line.compare(i, word.length(), word) != 0) continue;
+            bool startsWord = i == 0 || !(std::isalnum(line[i - 1]) || line[i - 1] == '_');
+            size_t after = i + word.length();
+            bool endsWord = after == line.length() || !(std::isalnum(line[after]) || line[after] == '_');
+            if (startsWord && endsWord) return true;
+        }
+        return false;
+    }
+
+    // True if the parenthesis after the callee closes at the end of the expression
+    static bool isSingleCall(const std::string& expression) {
+        size_t open = expression.find('(');
+        int depth = 0;
+        bool inStringLiteral = false;
+        for (size_t i = open; i < expression.length(); ++i) {
+            char c = expression[i];
+            if (c == '"') inStringLiteral = !inStringLiteral;
+            if (inStringLiteral) continue;
+            if (c == '(') depth++;
+            if (c == ')' && --depth == 0) {
+                return expression.find_first_not_of(" \t;", i + 1) == std::string::npos;
+            }
+        }
+        return false;
+    }
+
+    int findBlockEnd(const std::vector<std::string>& lines, int startLine, bool isBrackets, std::ostream& errors) const {
+        int currentLine = startLine;
+        int nestedLevel = 1; // We assume we are inside the block already
+        int lineCount = static_cast<int>(lines.size());
+
+        // Loop through the source lines
+        while (currentLine < lineCount && nestedLevel > 0) {
+            const std::string& line = lines[currentLine];
+
+            // Brace Counting Logic
+            if (isBrackets) {
+                for (char c : line) {
+                    if (c == '{') {
+                        nestedLevel++;
+                    } else if (c == '}') {
+                        nestedLevel--;
+                        if (nestedLevel == 0) {
+                            return currentLine;
+                        }
+                    }
+                }
+            } else {
+                Statement statement;
+                parseStatement(line, false, statement);
+
+                // Detect block openers
+                if (statement.kind == StatementKind::FunctionDef || statement.kind == StatementKind::If) {
+                    nestedLevel++;
+                }
+                // Detect block close
+                else if (statement.kind == StatementKind::CloseBlock) {
+                    nestedLevel--;
+
+                    if (nestedLevel == 0) {
+                        return currentLine;
+                    }
+                }
+            }
+
+            currentLine++;
+        }
+
+        errors << "Syntax Error: Unmatched opening brace starting near line " << startLine - 1 << std::endl;
+        return -1;
+    }
+};
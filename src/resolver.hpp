@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <set>
+#include <utility>
+#include <algorithm>
+
+#include "ast.hpp"
+
+// A name the syntax tree couldn't bind to a declaration
+struct NameError {
+    int line = 0;
+    std::string name;
+    std::string message;
+};
+
+/**
+ * @brief Finds every variable that is read or assigned where no declaration of it is visible,
+ * under the engine's scope rules (see Binding). Each name is reported once per line, so a loop
+ * over a bad line is reported once, before the script runs.
+ * The names are only candidates: a host can define globals the script never declares, so the
+ * engine drops those before it reports the rest (see ExecutionEngine::reportNameErrors).
+ * Calls aren't checked: native functions are only registered when an engine is made.
+ */
+class NameResolver {
+public:
+    static std::vector<NameError> check(const SyntaxTree& tree) {
+        NameResolver resolver;
+        resolver.checkBlock(tree.body);
+        for (const FunctionNode& node : tree.functions) {
+            resolver.checkBlock(node.body);
+        }
+        std::stable_sort(resolver.errors.begin(), resolver.errors.end(),
+                         [](const NameError& a, const NameError& b) { return a.line < b.line; });
+        return std::move(resolver.errors);
+    }
+
+private:
+    std::vector<NameError> errors;
+    std::set<std::pair<int, std::string>> reported;
+
+    void report(int line, const std::string& name, const std::string& message) {
+        if (reported.emplace(line, name).second) {
+            errors.push_back(NameError{ line, name, "Name Error on line " + std::to_string(line) + ": " + message });
+        }
+    }
+
+    void checkBlock(const std::vector<Stmt>& block) {
+        for (const Stmt& stmt : block) {
+            if (stmt.kind() == StatementKind::Assignment && stmt.targets[0] == nullptr) {
+                const std::string& name = stmt.statement->args[0];
+                report(stmt.line, name, "Variable '" + name + "' is assigned before it's declared.");
+            }
+            for (const auto& expr : stmt.exprs) {
+                checkExpression(*expr, stmt.line);
+            }
+            checkBlock(stmt.body);
+        }
+    }
+
+    void checkExpression(const Expr& expr, int line) {
+        if (expr.kind == Expr::Kind::Variable && expr.binding == nullptr) {
+            report(line, expr.text, "Undefined variable '" + expr.text + "'.");
+        }
+        for (const auto& child : expr.children) {
+            checkExpression(*child, line);
+        }
+    }
+};
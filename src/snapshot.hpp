@@ -0,0 +1,202 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SPHYNX_HAS_MMAP 1
+#endif
+
+/*
+Snapshot file layout:
+- SnapshotHeader
+- Records: a flat array of 32-bit words (numbers, and strings as offset/length pairs)
+- Strings: every string of the snapshot, concatenated
+
+Loading maps the file and "fixes up" each offset/length pair into a view of the
+mapped string area, so nothing is parsed and the file is never copied as a whole.
+*/
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t wordCount;
+    uint64_t stringsSize;
+};
+
+static const char SNAPSHOT_MAGIC[8] = { 'S', 'P', 'H', 'X', 'S', 'N', 'A', 'P' };
+static const uint32_t SNAPSHOT_VERSION = 8;
+
+class SnapshotWriter {
+public:
+    void u32(uint32_t value) { words.push_back(value); }
+    void i32(int32_t value) { words.push_back(static_cast<uint32_t>(value)); }
+    void flag(bool value) { words.push_back(value ? 1 : 0); }
+    void u64(uint64_t value) {
+        words.push_back(static_cast<uint32_t>(value));
+        words.push_back(static_cast<uint32_t>(value >> 32));
+    }
+
+    void str(std::string_view value) {
+        if (strings.size() + value.size() > UINT32_MAX) {
+            throw std::runtime_error("Snapshot Error: State is too large for a snapshot");
+        }
+        words.push_back(static_cast<uint32_t>(strings.size()));
+        words.push_back(static_cast<uint32_t>(value.size()));
+        strings += value;
+    }
+
+    void strings32(const std::vector<std::string>& values) {
+        u32(static_cast<uint32_t>(values.size()));
+        for (const std::string& value : values) {
+            str(value);
+        }
+    }
+
+    void writeToFile(const std::string& filename) const {
+        std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            throw std::runtime_error("Snapshot Error: Failed to create " + filename);
+        }
+
+        SnapshotHeader header;
+        std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+        header.version = SNAPSHOT_VERSION;
+        header.wordCount = static_cast<uint32_t>(words.size());
+        header.stringsSize = strings.size();
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(words.data()), words.size() * sizeof(uint32_t));
+        file.write(strings.data(), strings.size());
+        if (!file) {
+            throw std::runtime_error("Snapshot Error: Failed to write " + filename);
+        }
+    }
+
+private:
+    std::vector<uint32_t> words;
+    std::string strings;
+};
+
+/**
+ * @brief Read-only view of a snapshot file, mapped into memory where mmap is available.
+ * Values are read back in the order the SnapshotWriter wrote them.
+ */
+class SnapshotReader {
+public:
+    explicit SnapshotReader(const std::string& filename) {
+#ifdef SPHYNX_HAS_MMAP
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Snapshot Error: Failed to open " + filename);
+        }
+        struct stat info;
+        if (::fstat(fd, &info) != 0 || info.st_size == 0) {
+            ::close(fd);
+            throw std::runtime_error("Snapshot Error: Failed to read " + filename);
+        }
+        size = static_cast<size_t>(info.st_size);
+        void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED) {
+            throw std::runtime_error("Snapshot Error: Failed to map " + filename);
+        }
+        data = static_cast<const char*>(mapping);
+#else
+        std::ifstream file(filename, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Snapshot Error: Failed to open " + filename);
+        }
+        fallback.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        data = fallback.data();
+        size = fallback.size();
+#endif
+
+        SnapshotHeader header;
+        if (size < sizeof(header)) {
+            release();
+            throw std::runtime_error("Snapshot Error: " + filename + " is not a snapshot");
+        }
+        std::memcpy(&header, data, sizeof(header));
+        if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 || header.version != SNAPSHOT_VERSION) {
+            release();
+            throw std::runtime_error("Snapshot Error: " + filename + " is not a snapshot of this version");
+        }
+        if (sizeof(header) + header.wordCount * sizeof(uint32_t) + header.stringsSize != size) {
+            release();
+            throw std::runtime_error("Snapshot Error: " + filename + " is truncated");
+        }
+
+        words = reinterpret_cast<const uint32_t*>(data + sizeof(header));
+        wordCount = header.wordCount;
+        strings = data + sizeof(header) + wordCount * sizeof(uint32_t);
+        stringsSize = header.stringsSize;
+    }
+
+    ~SnapshotReader() { release(); }
+
+    SnapshotReader(const SnapshotReader&) = delete;
+    SnapshotReader& operator=(const SnapshotReader&) = delete;
+
+    uint32_t u32() {
+        if (position >= wordCount) {
+            throw std::runtime_error("Snapshot Error: Unexpected end of snapshot");
+        }
+        return words[position++];
+    }
+
+    int32_t i32() { return static_cast<int32_t>(u32()); }
+    bool flag() { return u32() != 0; }
+    uint64_t u64() {
+        uint64_t low = u32();
+        return low | static_cast<uint64_t>(u32()) << 32;
+    }
+
+    // Fixup: turns an offset/length pair into a view of the mapped string area
+    std::string_view str() {
+        uint32_t offset = u32();
+        uint32_t length = u32();
+        if (static_cast<uint64_t>(offset) + length > stringsSize) {
+            throw std::runtime_error("Snapshot Error: Corrupt string reference");
+        }
+        return std::string_view(strings + offset, length);
+    }
+
+    std::vector<std::string> strings32() {
+        std::vector<std::string> values(u32());
+        for (std::string& value : values) {
+            value = std::string(str());
+        }
+        return values;
+    }
+
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+    const uint32_t* words = nullptr;
+    size_t wordCount = 0;
+    size_t position = 0;
+    const char* strings = nullptr;
+    uint64_t stringsSize = 0;
+#ifndef SPHYNX_HAS_MMAP
+    std::vector<char> fallback;
+#endif
+
+    void release() {
+#ifdef SPHYNX_HAS_MMAP
+        if (data != nullptr) {
+            ::munmap(const_cast<char*>(data), size);
+        }
+#endif
+        data = nullptr;
+    }
+};
@@ -0,0 +1,265 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "evaluator.hpp"
+#include "table.hpp"
+
+/**
+ * @brief Orders values of different types: numbers (and bools, as 0 and 1) first, by value, then
+ * strings, then anything else by its text.
+ * @return < 0, 0 or > 0, like strcmp.
+ */
+inline int compareValues(const EvalResult& a, const EvalResult& b) {
+    auto rank = [](const EvalResult& value) {
+        if (value.type == "int" || value.type == "float" || value.type == "bool") return 0;
+        return value.type == "string" ? 1 : 2;
+    };
+    int rankA = rank(a);
+    int rankB = rank(b);
+    if (rankA != rankB) {
+        return rankA < rankB ? -1 : 1;
+    }
+    if (rankA == 0) {
+        if (a.type == "int" && b.type == "int") {
+            long long x = a.asInt();
+            long long y = b.asInt();
+            return x < y ? -1 : (y < x ? 1 : 0);
+        }
+        auto number = [](const EvalResult& value) {
+            return value.type == "bool" ? (value.asBool() ? 1.0 : 0.0) : std::strtod(value.value.c_str(), nullptr);
+        };
+        double x = number(a);
+        double y = number(b);
+        return x < y ? -1 : (y < x ? 1 : 0);
+    }
+    return a.asString().compare(b.asString());
+}
+
+/**
+ * @brief The sort keys of one column, by the original position of every element.
+ * Ints, floats and bools become unsigned integers with the same order, which are radix sorted
+ * eight bits at a time. Strings are radix sorted byte by byte from the front. Anything else is
+ * compared with compareValues().
+ */
+class SortKey {
+public:
+    explicit SortKey(const ArrayData& column) : values(&column) {
+        size_t count = column.size();
+        switch (column.kind) {
+        case ArrayData::Kind::Int:
+            bits.resize(count);
+            for (size_t i = 0; i < count; ++i) bits[i] = static_cast<uint64_t>(column.ints[i]) ^ SIGN_BIT;
+            break;
+        case ArrayData::Kind::Float:
+            bits.resize(count);
+            for (size_t i = 0; i < count; ++i) {
+                // Negative floats reverse their order; positive ones just go above them
+                uint64_t raw;
+                std::memcpy(&raw, &column.floats[i], sizeof(raw));
+                bits[i] = (raw & SIGN_BIT) ? ~raw : raw | SIGN_BIT;
+            }
+            break;
+        case ArrayData::Kind::Bool:
+            bits.assign(column.bools.begin(), column.bools.end());
+            break;
+        case ArrayData::Kind::Mixed: {
+            bool strings = true;
+            for (size_t i = 0; strings && i < count; ++i) {
+                strings = column.items[i].type == "string";
+            }
+            if (strings) {
+                text.resize(count);
+                for (size_t i = 0; i < count; ++i) {
+                    text[i] = column.items[i].stringView();
+                }
+            }
+            break;
+        }
+        }
+    }
+
+    int compare(uint32_t a, uint32_t b) const {
+        if (!bits.empty()) return bits[a] < bits[b] ? -1 : (bits[b] < bits[a] ? 1 : 0);
+        if (!text.empty()) return text[a].compare(text[b]);
+        return compareValues(values->items[a], values->items[b]);
+    }
+
+    // Sorts the positions in [begin, end) by this key, keeping the order of equal keys
+    void sortStable(uint32_t* begin, uint32_t* end, std::vector<uint32_t>& scratch) const {
+        if (end - begin < 2) {
+            return;
+        }
+        scratch.resize(std::max(scratch.size(), static_cast<size_t>(end - begin)));
+        if (!bits.empty()) {
+            radixSortBits(begin, end, scratch.data());
+        } else if (!text.empty()) {
+            radixSortText(begin, end, 0, scratch.data());
+        } else {
+            std::stable_sort(begin, end, [this](uint32_t a, uint32_t b) { return compare(a, b) < 0; });
+        }
+    }
+
+private:
+    static constexpr uint64_t SIGN_BIT = uint64_t(1) << 63;
+    static const size_t SMALL_BUCKET = 32;  // Fewer strings than this are sorted by comparing them
+    static const size_t MAX_TEXT_DEPTH = 64;  // Longer common prefixes are compared, not recursed into
+
+    const ArrayData* values;
+    std::vector<uint64_t> bits;
+    std::vector<std::string_view> text;
+
+    // Least significant digit first: 8 passes of 8 bits, skipping digits that are the same for every key
+    void radixSortBits(uint32_t* begin, uint32_t* end, uint32_t* scratch) const {
+        size_t count = static_cast<size_t>(end - begin);
+        std::vector<size_t> histograms(8 * 256);
+        for (uint32_t* p = begin; p < end; ++p) {
+            uint64_t key = bits[*p];
+            for (size_t digit = 0; digit < 8; ++digit) {
+                histograms[digit * 256 + ((key >> (digit * 8)) & 0xFF)]++;
+            }
+        }
+
+        uint32_t* from = begin;
+        uint32_t* to = scratch;
+        for (size_t digit = 0; digit < 8; ++digit) {
+            size_t* histogram = &histograms[digit * 256];
+            if (histogram[(bits[*from] >> (digit * 8)) & 0xFF] == count) {
+                continue;
+            }
+            size_t offset = 0;
+            for (size_t bucket = 0; bucket < 256; ++bucket) {
+                size_t size = histogram[bucket];
+                histogram[bucket] = offset;
+                offset += size;
+            }
+            for (size_t i = 0; i < count; ++i) {
+                to[histogram[(bits[from[i]] >> (digit * 8)) & 0xFF]++] = from[i];
+            }
+            std::swap(from, to);
+        }
+        if (from != begin) {
+            std::copy(from, from + count, begin);
+        }
+    }
+
+    // Most significant byte first: one bucket per byte value at 'depth', after the strings that end there
+    void radixSortText(uint32_t* begin, uint32_t* end, size_t depth, uint32_t* scratch) const {
+        size_t count = static_cast<size_t>(end - begin);
+        if (count < SMALL_BUCKET || depth > MAX_TEXT_DEPTH) {
+            std::stable_sort(begin, end, [this](uint32_t a, uint32_t b) { return text[a] < text[b]; });
+            return;
+        }
+
+        auto bucketOf = [&](uint32_t i) {
+            return depth < text[i].length() ? static_cast<size_t>(static_cast<unsigned char>(text[i][depth])) + 1 : 0;
+        };
+        size_t starts[258] = {};
+        for (uint32_t* p = begin; p < end; ++p) {
+            starts[bucketOf(*p) + 1]++;
+        }
+        for (size_t bucket = 1; bucket < 258; ++bucket) {
+            starts[bucket] += starts[bucket - 1];
+        }
+        size_t next[257];
+        std::copy(starts, starts + 257, next);
+        for (uint32_t* p = begin; p < end; ++p) {
+            scratch[next[bucketOf(*p)]++] = *p;
+        }
+        std::copy(scratch, scratch + count, begin);
+
+        // Bucket 0 holds strings that end here, which are all equal
+        for (size_t bucket = 1; bucket < 257; ++bucket) {
+            if (starts[bucket + 1] - starts[bucket] > 1) {
+                radixSortText(begin + starts[bucket], begin + starts[bucket + 1], depth + 1, scratch);
+            }
+        }
+    }
+};
+
+/**
+ * @brief The positions 0 to count - 1, sorted by 'keys' (the first key first), keeping the order of
+ * equal rows. Every slice of positions is radix sorted on its own, one per core; the sorted slices
+ * are then merged pairwise, every merge split into pieces that also run in parallel.
+ */
+inline std::vector<uint32_t> sortedOrder(const std::vector<SortKey>& keys, size_t count, size_t slices, const SliceRunner& run) {
+    std::vector<uint32_t> order(count);
+    for (size_t i = 0; i < count; ++i) {
+        order[i] = static_cast<uint32_t>(i);
+    }
+    slices = std::max<size_t>(1, std::min(slices, count));
+
+    // Sorting by the last key first, then stably by the ones before it, sorts by all of them
+    run(slices, [&](size_t slice) {
+        std::vector<uint32_t> scratch;
+        uint32_t* begin = order.data() + count * slice / slices;
+        uint32_t* end = order.data() + count * (slice + 1) / slices;
+        for (size_t k = keys.size(); k-- > 0;) {
+            keys[k].sortStable(begin, end, scratch);
+        }
+    });
+
+    auto less = [&keys](uint32_t a, uint32_t b) {
+        for (const SortKey& key : keys) {
+            int result = key.compare(a, b);
+            if (result != 0) return result < 0;
+        }
+        return false;
+    };
+
+    std::vector<size_t> runs;  // Start of every sorted run, then count
+    for (size_t slice = 0; slice <= slices; ++slice) {
+        runs.push_back(count * slice / slices);
+    }
+    std::vector<uint32_t> merged(count);
+    while (runs.size() > 2) {
+        size_t pairs = (runs.size() - 1) / 2;
+        size_t pieces = std::max<size_t>(1, slices / pairs);
+        std::vector<size_t> nextRuns;
+        for (size_t i = 0; i < runs.size() - 1; i += 2) {
+            nextRuns.push_back(runs[i]);
+        }
+        nextRuns.push_back(count);
+
+        run(pairs * pieces + (runs.size() - 1) % 2, [&](size_t task) {
+            size_t pair = task / pieces;
+            if (pair == pairs) {
+                // A run without a partner is copied as it is
+                std::copy(order.begin() + runs[2 * pairs], order.end(), merged.begin() + runs[2 * pairs]);
+                return;
+            }
+            const uint32_t* a = order.data() + runs[2 * pair];
+            const uint32_t* b = order.data() + runs[2 * pair + 1];
+            size_t sizeA = runs[2 * pair + 1] - runs[2 * pair];
+            size_t sizeB = runs[2 * pair + 2] - runs[2 * pair + 1];
+
+            // How many of the first k merged elements come from a; equal elements take a's first
+            auto split = [&](size_t k) {
+                size_t low = k > sizeB ? k - sizeB : 0;
+                size_t high = std::min(k, sizeA);
+                while (low < high) {
+                    size_t i = (low + high) / 2;
+                    if (!less(b[k - i - 1], a[i])) low = i + 1;
+                    else high = i;
+                }
+                return low;
+            };
+            size_t piece = task % pieces;
+            size_t first = (sizeA + sizeB) * piece / pieces;
+            size_t last = (sizeA + sizeB) * (piece + 1) / pieces;
+            size_t firstA = split(first);
+            size_t lastA = split(last);
+            std::merge(a + firstA, a + lastA, b + (first - firstA), b + (last - lastA),
+                       merged.begin() + runs[2 * pair] + first, less);
+        });
+        order.swap(merged);
+        runs.swap(nextRuns);
+    }
+    return order;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+enum class StatementKind {
+    Empty,
+    Comment,
+    Style,
+    End,
+    CloseBlock,
+    Return,
+    ReturnValue,
+    FunctionDef,
+    Goto,
+    If,
+    Declaration,
+    Assignment,
+    Print,
+    Println,
+    Exec,
+    CsvOpen,
+    CsvRead,
+    Snapshot,
+    Spawn,
+    Await,
+    Sleep,
+    Send,
+    Recv,
+    Select,
+    Close,
+    Call,
+    Unknown
+};
+
+/**
+ * @brief One source line, classified once at compile time.
+ * 'args' holds the parts of the statement, e.g. {name, expression} for a declaration. When the statement is a call, or its expression is exactly a call, 'callee'
+ * and 'callArgs' hold the already split call.
+ */
+struct Statement {
+    StatementKind kind = StatementKind::Empty;
+    std::string text;
+    std::vector<std::string> args;
+    std::string callee;
+    std::vector<std::string> callArgs;
+    int blockEnd = -1;  // Closing line of an if/func block
+    bool isSpawn = false;  // Declaration/assignment of 'spawn f(...)': callee is the spawned function
+    bool isolated = false;  // Spawn with 'parallel': the task runs on another core with its own variables
+    bool isAwait = false;  // Declaration/assignment of 'await <expr>': args[1] is the awaited expression
+    bool isRecv = false;  // Declaration/assignment of 'recv <channel>': args[1] is the channel expression
+    bool readsInput = false;  // Uses the 'input' keyword (a scheduling point for tasks)
+};
+
+// The kind's name, as --dump-ast prints it
+inline const char* statementKindName(StatementKind kind) {
+    static const char* const NAMES[] = {
+        "empty", "comment", "style", "end", "close block", "return", "return value", "func", "goto", "if",
+        "var", "assign", "print", "println", "exec", "csv", "read", "snapshot", "spawn", "await", "sleep",
+        "send", "recv", "select", "close", "call", "unknown"
+    };
+    static_assert(sizeof(NAMES) / sizeof(NAMES[0]) == static_cast<size_t>(StatementKind::Unknown) + 1,
+                  "Every statement kind needs a name");
+    return NAMES[static_cast<size_t>(kind)];
+}
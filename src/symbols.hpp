@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <functional>
+
+/**
+ * @brief An interned string. There is one Symbol per distinct text, so two interned strings are
+ * equal exactly when their Symbols are the same object, and the hash is computed only once.
+ */
+struct Symbol {
+    std::string text;
+    size_t hash;
+};
+
+// Hashes a Symbol pointer by its cached hash
+struct SymbolHash {
+    size_t operator()(const Symbol* symbol) const { return symbol->hash; }
+};
+
+// A reference to an interned string; the Symbol is freed with its last reference
+using SymbolRef = std::shared_ptr<const Symbol>;
+
+/**
+ * @brief The process-wide table of interned strings, shared by all engines and threads.
+ * It is split into shards with a lock each, so threads interning different strings rarely wait
+ * for each other. The table only watches its Symbols: one is removed when the last value holding
+ * it is gone, so strings read at runtime (table cells, array elements) don't pile up.
+ */
+class SymbolTable {
+public:
+    static SymbolTable& global() {
+        // Never destroyed, so values outliving other statics can still release their Symbols
+        static SymbolTable* table = new SymbolTable();
+        return *table;
+    }
+
+    SymbolRef intern(std::string_view text) {
+        size_t hash = std::hash<std::string_view>()(text);
+        Shard& shard = shards[hash % SHARDS];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto found = shard.symbols.find(text);
+        if (found != shard.symbols.end()) {
+            if (SymbolRef existing = found->second.ref.lock()) {
+                return existing;
+            }
+            // Its last reference is being dropped; the release sees the new entry and leaves it
+            shard.symbols.erase(found);
+        }
+        SymbolRef symbol(new Symbol{ std::string(text), hash }, [this](const Symbol* s) { release(s); });
+        // The key views the Symbol's own text, which lives until the entry is erased
+        shard.symbols.emplace(std::string_view(symbol->text), Entry{ symbol.get(), symbol });
+        return symbol;
+    }
+
+private:
+    static const size_t SHARDS = 16;
+
+    struct Entry {
+        const Symbol* symbol;
+        std::weak_ptr<const Symbol> ref;
+    };
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<std::string_view, Entry> symbols;
+    };
+    Shard shards[SHARDS];
+
+    void release(const Symbol* symbol) {
+        {
+            Shard& shard = shards[symbol->hash % SHARDS];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto found = shard.symbols.find(std::string_view(symbol->text));
+            if (found != shard.symbols.end() && found->second.symbol == symbol) {
+                shard.symbols.erase(found);
+            }
+        }
+        delete symbol;
+    }
+};
+
+inline SymbolRef intern(std::string_view text) {
+    return SymbolTable::global().intern(text);
+}
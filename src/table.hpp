@@ -0,0 +1,264 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include "evaluator.hpp"
+
+/**
+ * @brief Columns of a "table" value.
+ * Every column is an array with one element per row, stored unboxed when it holds a single type.
+ * Like arrays, tables are never modified in place, so copies share them.
+ */
+struct TableData {
+    std::vector<std::string> names;
+    std::vector<std::shared_ptr<const ArrayData>> columns;
+    std::vector<size_t> groupKeys;  // Set by groupBy(): the columns the next aggregation groups by
+
+    size_t rowCount() const { return columns.empty() ? 0 : columns[0]->size(); }
+
+    // Index of the column, or -1
+    int findColumn(const std::string& name) const {
+        for (size_t i = 0; i < names.size(); ++i) {
+            if (names[i] == name) return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    // The rows whose byte in 'mask' (one per row, 0 or 1) is 1
+    std::shared_ptr<const TableData> filtered(const uint8_t* mask) const {
+        auto result = std::make_shared<TableData>();
+        result->names = names;
+        result->groupKeys = groupKeys;
+        for (const std::shared_ptr<const ArrayData>& column : columns) {
+            result->columns.push_back(column->filtered(mask));
+        }
+        return result;
+    }
+
+    // The rows at the positions in 'order', in that order
+    std::shared_ptr<const TableData> gathered(const std::vector<uint32_t>& order) const {
+        auto result = std::make_shared<TableData>();
+        result->names = names;
+        result->groupKeys = groupKeys;
+        for (const std::shared_ptr<const ArrayData>& column : columns) {
+            result->columns.push_back(column->gathered(order));
+        }
+        return result;
+    }
+};
+
+// Tables print as aligned columns; long tables only show their first rows
+inline std::string tableText(const TableData& table) {
+    static const size_t SHOWN_ROWS = 20;
+    size_t rows = std::min(table.rowCount(), SHOWN_ROWS);
+    std::vector<std::vector<std::string>> cells(table.columns.size());
+    std::vector<size_t> widths(table.columns.size());
+    for (size_t c = 0; c < table.columns.size(); ++c) {
+        widths[c] = table.names[c].length();
+        for (size_t r = 0; r < rows; ++r) {
+            cells[c].push_back(table.columns[c]->at(r).asString());
+            widths[c] = std::max(widths[c], cells[c].back().length());
+        }
+    }
+
+    auto line = [&](const std::function<std::string(size_t)>& cell) {
+        std::string text;
+        for (size_t c = 0; c < table.columns.size(); ++c) {
+            std::string value = cell(c);
+            if (c > 0) text += " | ";
+            text += value;
+            if (c + 1 < table.columns.size()) text.append(widths[c] - value.length(), ' ');
+        }
+        return text;
+    };
+    std::string text = line([&](size_t c) { return table.names[c]; });
+    for (size_t r = 0; r < rows; ++r) {
+        text += '\n' + line([&](size_t c) { return cells[c][r]; });
+    }
+    if (rows < table.rowCount()) {
+        text += "\n... (" + std::to_string(table.rowCount()) + " rows)";
+    }
+    return text;
+}
+
+/**
+ * @brief Builds a column one value at a time.
+ * Values stay unboxed while they all have the column's first type; the first value of another
+ * type boxes the column.
+ */
+class ColumnBuilder {
+public:
+    void add(const EvalResult& value) {
+        if (column->kind == ArrayData::Kind::Mixed && column->items.empty() && !boxed) {
+            if (value.type == "int") column->kind = ArrayData::Kind::Int;
+            else if (value.type == "float") column->kind = ArrayData::Kind::Float;
+            else if (value.type == "bool") column->kind = ArrayData::Kind::Bool;
+            else boxed = true;
+        }
+        try {
+            if (column->kind == ArrayData::Kind::Int && value.type == "int") {
+                column->ints.push_back(std::stoll(value.value));
+                return;
+            }
+            if (column->kind == ArrayData::Kind::Float && value.type == "float") {
+                column->floats.push_back(std::stod(value.value));
+                return;
+            }
+        } catch (...) {
+            // Out of range: boxed below
+        }
+        if (column->kind == ArrayData::Kind::Bool && value.type == "bool") {
+            column->bools.push_back(value.asBool() ? 1 : 0);
+            return;
+        }
+        box();
+        // Strings are interned, so grouping and comparing them doesn't need their text
+        column->items.push_back(value.interned());
+    }
+
+    std::shared_ptr<const ArrayData> finish() { return std::move(column); }
+
+private:
+    std::shared_ptr<ArrayData> column = std::make_shared<ArrayData>();
+    bool boxed = false;
+
+    void box() {
+        if (column->kind != ArrayData::Kind::Mixed) {
+            for (size_t i = 0; i < column->size(); ++i) {
+                column->items.push_back(column->at(i));
+            }
+            column->ints.clear();
+            column->floats.clear();
+            column->bools.clear();
+            column->kind = ArrayData::Kind::Mixed;
+        }
+        boxed = true;
+    }
+};
+
+// Runs body(slice) for slices 0 to count - 1, possibly in parallel
+using SliceRunner = std::function<void(size_t count, const std::function<void(size_t)>& body)>;
+
+/**
+ * @brief The groups of a table's rows, by the values of some key columns.
+ * Groups are numbered in the order they first appear.
+ */
+struct Grouping {
+    std::vector<uint32_t> groupOf;  // Group of every row
+    std::vector<size_t> firstRow;   // First row of every group
+
+    size_t groupCount() const { return firstRow.size(); }
+};
+
+/**
+ * @brief Hash grouping, one slice of rows per core.
+ * Every slice numbers the keys it sees with its own hash table. The slices' keys are then numbered
+ * globally, slice by slice in row order, and every slice renumbers its rows.
+ */
+template <typename Key, typename Hash = std::hash<Key>>
+Grouping groupKeys(const std::vector<Key>& keys, size_t slices, const SliceRunner& run) {
+    size_t rows = keys.size();
+    std::vector<std::vector<uint32_t>> localFirst(slices);  // Per slice: first row of every local group
+    Grouping grouping;
+    grouping.groupOf.resize(rows);
+
+    run(slices, [&](size_t slice) {
+        std::unordered_map<Key, uint32_t, Hash> local;
+        for (size_t row = rows * slice / slices; row < rows * (slice + 1) / slices; ++row) {
+            auto inserted = local.emplace(keys[row], static_cast<uint32_t>(localFirst[slice].size()));
+            if (inserted.second) {
+                localFirst[slice].push_back(static_cast<uint32_t>(row));
+            }
+            grouping.groupOf[row] = inserted.first->second;
+        }
+    });
+
+    std::unordered_map<Key, uint32_t, Hash> global;
+    std::vector<std::vector<uint32_t>> renumber(slices);
+    for (size_t slice = 0; slice < slices; ++slice) {
+        for (uint32_t row : localFirst[slice]) {
+            auto inserted = global.emplace(keys[row], static_cast<uint32_t>(grouping.firstRow.size()));
+            if (inserted.second) {
+                grouping.firstRow.push_back(row);
+            }
+            renumber[slice].push_back(inserted.first->second);
+        }
+    }
+
+    run(slices, [&](size_t slice) {
+        for (size_t row = rows * slice / slices; row < rows * (slice + 1) / slices; ++row) {
+            grouping.groupOf[row] = renumber[slice][grouping.groupOf[row]];
+        }
+    });
+    return grouping;
+}
+
+// A boxed value as a group key: its type and its text
+struct ValueKey {
+    std::string_view type;
+    std::string_view text;
+
+    bool operator==(const ValueKey& other) const { return type == other.type && text == other.text; }
+};
+
+struct ValueKeyHash {
+    size_t operator()(const ValueKey& key) const {
+        return std::hash<std::string_view>()(key.text) * 31 + std::hash<std::string_view>()(key.type);
+    }
+};
+
+// Groups rows by one column. Numbers and bools hash their bits, interned strings their Symbol, and other values their type and text.
+inline Grouping groupByColumn(const ArrayData& column, size_t slices, const SliceRunner& run) {
+    std::vector<uint64_t> bits(column.kind == ArrayData::Kind::Mixed ? 0 : column.size());
+    switch (column.kind) {
+    case ArrayData::Kind::Int:
+        for (size_t i = 0; i < bits.size(); ++i) bits[i] = static_cast<uint64_t>(column.ints[i]);
+        break;
+    case ArrayData::Kind::Float:
+        for (size_t i = 0; i < bits.size(); ++i) {
+            double value = column.floats[i] == 0 ? 0.0 : column.floats[i];  // -0 and 0 are one key
+            std::memcpy(&bits[i], &value, sizeof(value));
+        }
+        break;
+    case ArrayData::Kind::Bool:
+        for (size_t i = 0; i < bits.size(); ++i) bits[i] = column.bools[i];
+        break;
+    case ArrayData::Kind::Mixed: {
+        std::vector<const Symbol*> symbols(column.size());
+        bool interned = true;
+        for (size_t i = 0; interned && i < symbols.size(); ++i) {
+            symbols[i] = column.items[i].symbol.get();
+            interned = symbols[i] != nullptr;
+        }
+        if (interned) {
+            return groupKeys<const Symbol*, SymbolHash>(symbols, slices, run);
+        }
+        std::vector<ValueKey> values(column.size());
+        for (size_t i = 0; i < values.size(); ++i) values[i] = ValueKey{ column.items[i].type, column.items[i].stringView() };
+        return groupKeys<ValueKey, ValueKeyHash>(values, slices, run);
+    }
+    }
+    return groupKeys(bits, slices, run);
+}
+
+// Groups rows by several columns: each column is grouped on its own, then the group numbers are combined
+inline Grouping groupByColumns(const TableData& table, const std::vector<size_t>& keyColumns, size_t slices, const SliceRunner& run) {
+    Grouping grouping = groupByColumn(*table.columns[keyColumns[0]], slices, run);
+    for (size_t k = 1; k < keyColumns.size(); ++k) {
+        Grouping next = groupByColumn(*table.columns[keyColumns[k]], slices, run);
+        std::vector<uint64_t> combined(grouping.groupOf.size());
+        for (size_t row = 0; row < combined.size(); ++row) {
+            combined[row] = static_cast<uint64_t>(grouping.groupOf[row]) << 32 | next.groupOf[row];
+        }
+        grouping = groupKeys(combined, slices, run);
+    }
+    return grouping;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <future>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <functional>
+
+#include "evaluator.hpp"
+#include "variable.hpp"
+#include "function.hpp"
+#include "channel.hpp"
+
+/**
+ * @brief The work of a 'parallel' task: a function call run by its own engine on a pool thread.
+ * Whichever thread claims it first runs it, so a task that awaits a job nobody has started
+ * yet runs it itself instead of blocking a pool thread.
+ */
+struct ParallelJob {
+    std::function<void(ParallelJob&)> body;
+    std::atomic<bool> claimed{false};
+    std::atomic<bool> done{false};
+    std::atomic<bool> cancelled{false};  // Its owner stopped: the body's engine halts at its next scheduling point
+
+    // Set by the body, read by the owner once 'done' is true
+    EvalResult result;
+    std::string output;
+    std::string errors;
+    std::vector<std::shared_ptr<Channel>> channels;  // Keeps a returned channel alive until it's collected
+
+    // Runs the job unless another thread already claimed it
+    bool tryRun() {
+        if (claimed.exchange(true)) {
+            return false;
+        }
+        body(*this);
+        body = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            done.store(true, std::memory_order_release);
+        }
+        finished.notify_all();
+        return true;
+    }
+
+    bool isDone() const { return done.load(std::memory_order_acquire); }
+
+    // Blocks the calling thread until the job has run
+    void waitUntilDone() {
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this]() { return isDone(); });
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable finished;
+};
+
+/**
+ * @brief A green thread created with 'spawn', or a task created with 'parallel'.
+ * Green threads share the engine's globals. While one is suspended, its own execution state
+ * (line, scopes, call stack and local variables) is kept here; the running task's state
+ * lives in the engine itself.
+ */
+struct Task {
+    enum class Wait { None, Sleep, Command, Task, Channel };
+
+    int id = 0;
+    bool finished = false;
+    EvalResult result;
+
+    // A 'parallel' task runs elsewhere with its own variables; it's never scheduled here
+    std::shared_ptr<ParallelJob> job;
+
+    // Saved execution state
+    int programCounter = 0;
+    int scopeLevel = 0;
+    int functionDepth = 0;
+    std::vector<CallFrame> callStack;
+    std::vector<Variable> locals;
+    EvalResult returnValue;
+    bool hasReturnValue = false;
+
+    // What a blocked task is waiting for
+    Wait waitingFor = Wait::None;
+    std::chrono::steady_clock::time_point wakeTime;
+    std::future<std::string> command;  // An 'exec' running in the background; yields its captured output
+    int awaitedTask = 0;
+    std::vector<std::shared_ptr<Channel>> channels;  // Waiting for any of these to be ready
+    bool sending = false;  // ...for a send rather than a recv
+    bool hasDeadline = false;  // A channel wait gives up at wakeTime
+    bool timedOut = false;  // Woken by its deadline rather than a channel
+    bool resumingReceive = false;  // Suspended in a recv or select, which keeps its deadline when it runs again
+    EvalResult outgoing;  // The value of a blocked send, delivered as soon as there's room
+    std::string pendingOutput;  // Command output to write when the task resumes
+
+    // Another engine can still use one of the channels it's waiting on
+    bool waitsOnSharedChannel() const {
+        for (const std::shared_ptr<Channel>& channel : channels) {
+            if (channel->isShared()) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+
+/**
+ * @brief Work-stealing thread pool.
+ * Each worker owns a deque: it takes its own tasks from the back (most recent first, which
+ * keeps related work on one core) and, when it runs dry, steals the oldest task from the
+ * front of another worker's deque. Tasks submitted from a worker go to that worker's deque.
+ */
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(size_t threadCount = 0) {
+        if (threadCount == 0) {
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+        for (size_t i = 0; i < threadCount; ++i) {
+            workers.push_back(std::unique_ptr<Worker>(new Worker()));
+        }
+        for (size_t i = 0; i < threadCount; ++i) {
+            threads.emplace_back([this, i]() { workerLoop(i); });
+        }
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    size_t threadCount() const { return workers.size(); }
+
+    void submit(std::function<void()> task) {
+        // Outside the pool, spread tasks round-robin
+        size_t target = (currentPool == this) ? currentWorker : nextWorker++ % workers.size();
+        pending++;
+        queued++;
+        {
+            std::lock_guard<std::mutex> lock(workers[target]->mutex);
+            workers[target]->tasks.push_back(std::move(task));
+        }
+        {
+            // Sleeping workers check 'queued' under this lock, so the notification can't be missed
+            std::lock_guard<std::mutex> lock(sleepMutex);
+        }
+        wake.notify_one();
+    }
+
+    // Blocks until every submitted task has finished
+    void wait() {
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        idle.wait(lock, [this]() { return pending == 0; });
+    }
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::atomic<size_t> nextWorker{0};
+    std::atomic<size_t> pending{0};  // Submitted but not finished
+    std::atomic<size_t> queued{0};  // Waiting in a deque
+    bool stopping = false;
+
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+
+    // Identifies the pool and worker the current thread belongs to
+    inline static thread_local WorkStealingPool* currentPool = nullptr;
+    inline static thread_local size_t currentWorker = 0;
+
+    bool popLocal(size_t index, std::function<void()>& task) {
+        Worker& worker = *workers[index];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (worker.tasks.empty()) {
+            return false;
+        }
+        task = std::move(worker.tasks.back());
+        worker.tasks.pop_back();
+        queued--;
+        return true;
+    }
+
+    bool steal(size_t thief, std::function<void()>& task) {
+        for (size_t offset = 1; offset < workers.size(); ++offset) {
+            Worker& victim = *workers[(thief + offset) % workers.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                queued--;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void workerLoop(size_t index) {
+        currentPool = this;
+        currentWorker = index;
+
+        while (true) {
+            std::function<void()> task;
+            if (popLocal(index, task) || steal(index, task)) {
+                task();
+                if (--pending == 0) {
+                    std::lock_guard<std::mutex> lock(sleepMutex);
+                    idle.notify_all();
+                }
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this]() { return stopping || queued > 0; });
+            if (stopping && queued == 0) {
+                return;
+            }
+        }
+    }
+};
@@ -0,0 +1,327 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <charconv>
+#include <cmath>
+#include <cerrno>
+#include <cstdlib>
+#include <cstdint>
+
+#include "evaluator.hpp"
+#include "variable.hpp"
+#include "ast.hpp"
+
+// One instruction of typed code; operands are popped from the stack and the result pushed
+struct TypedOp {
+    enum class Code : uint8_t {
+        PushInt, PushFloat, PushBool, LoadInt, LoadFloat, LoadBool,
+        ToFloat,  // Converts the int on top of the stack, like the Evaluator reads an int operand as a float
+        AddInt, SubInt, MulInt, ModInt, AddFloat, SubFloat, MulFloat, DivFloat,
+        Less, Greater, LessEqual, GreaterEqual, Equal, NotEqual,  // Floats
+        EqualBool, NotEqualBool, And, Or, Not
+    };
+
+    Code code = Code::PushInt;
+    long long integer = 0;  // PushInt, PushBool
+    float number = 0;  // PushFloat
+    std::string name;  // Load: the variable
+};
+
+// The result of typed code: an int, a float or a bool (as 0 or 1)
+struct TypedValue {
+    ValueType type = ValueType::Unknown;
+    long long integer = 0;
+    float number = 0;
+
+    void storeIn(Variable& var) const {
+        if (type == ValueType::Int) var.setInt(integer);
+        else if (type == ValueType::Float) var.setFloat(number);
+        else var.setBool(integer != 0);
+    }
+};
+
+/**
+ * @brief Reads the variable's value unboxed, if it holds a value of 'type' whose text the
+ * Evaluator would read the same way. The text is parsed once; setValue() forgets the result.
+ */
+inline bool unbox(Variable& var, ValueType type) {
+    if (var.unboxedType != ValueType::Unknown) {
+        return var.unboxedType == type;
+    }
+    const std::string& text = var.value;
+    const char* end = text.data() + text.length();
+    if (type == ValueType::Int) {
+        if (var.type != "int" || std::from_chars(text.data(), end, var.unboxedInt).ptr != end) {
+            return false;
+        }
+    } else if (type == ValueType::Float) {
+        // Without a '.', the Evaluator would read it as an int; "inf" and "nan" aren't numbers to it
+        char* stop = nullptr;
+        errno = 0;
+        float number = std::strtof(text.c_str(), &stop);
+        if (var.type != "float" || text.find('.') == std::string::npos || stop != end || errno == ERANGE || !std::isfinite(number)) {
+            return false;
+        }
+        var.unboxedFloat = number;
+    } else {
+        if (var.type != "bool" || (text != "true" && text != "false")) {
+            return false;
+        }
+        var.unboxedInt = text == "true";
+    }
+    var.unboxedType = type;
+    return true;
+}
+
+/**
+ * @brief An expression compiled for the types inference proved, to postfix instructions on
+ * unboxed values. Every operation computes what the Evaluator computes for the same types
+ * (arithmetic in float, int results truncated), so the value and its text are the same.
+ * Types are only proven for the script; a variable may still hold another type at run time
+ * (set from C++, or left over after an error), so every load checks. When a load fails, or
+ * the expression fails (like a division by zero), run() returns false and the line is
+ * evaluated as text instead, which also reports the error.
+ */
+struct TypedCode {
+    static constexpr size_t MAX_STACK = 16;
+
+    std::vector<TypedOp> ops;
+    ValueType type = ValueType::Unknown;  // Of the result; Unknown for a line without typed code
+
+    bool run(std::map<std::string, Variable>& variables, TypedValue& result) const {
+        struct Slot {
+            long long integer;
+            float number;
+        };
+        Slot stack[MAX_STACK];
+        size_t top = 0;
+        using Code = TypedOp::Code;
+
+        for (const TypedOp& op : ops) {
+            Slot& a = stack[top >= 2 ? top - 2 : 0];
+            const Slot& b = stack[top >= 1 ? top - 1 : 0];
+            switch (op.code) {
+            case Code::PushInt:
+            case Code::PushBool: stack[top++].integer = op.integer; continue;
+            case Code::PushFloat: stack[top++].number = op.number; continue;
+            case Code::LoadInt:
+            case Code::LoadFloat:
+            case Code::LoadBool: {
+                ValueType wanted = op.code == Code::LoadInt ? ValueType::Int : op.code == Code::LoadFloat ? ValueType::Float : ValueType::Bool;
+                auto it = variables.find(op.name);
+                if (it == variables.end() || !unbox(it->second, wanted)) {
+                    return false;
+                }
+                stack[top].integer = it->second.unboxedInt;
+                stack[top++].number = it->second.unboxedFloat;
+                continue;
+            }
+            case Code::ToFloat: stack[top - 1].number = static_cast<float>(stack[top - 1].integer); continue;
+            case Code::Not: stack[top - 1].integer = !stack[top - 1].integer; continue;
+
+            case Code::AddInt: a.integer = static_cast<long long>(static_cast<float>(a.integer) + static_cast<float>(b.integer)); break;
+            case Code::SubInt: a.integer = static_cast<long long>(static_cast<float>(a.integer) - static_cast<float>(b.integer)); break;
+            case Code::MulInt: a.integer = static_cast<long long>(static_cast<float>(a.integer) * static_cast<float>(b.integer)); break;
+            case Code::ModInt:
+                if (b.integer == 0) return false;
+                a.integer = b.integer == -1 ? 0 : static_cast<long long>(static_cast<float>(a.integer % b.integer));  // The smallest int % -1 overflows
+                break;
+            case Code::AddFloat: a.number = a.number + b.number; break;
+            case Code::SubFloat: a.number = a.number - b.number; break;
+            case Code::MulFloat: a.number = a.number * b.number; break;
+            case Code::DivFloat:
+                if (b.number == 0) return false;
+                a.number = a.number / b.number;
+                break;
+            case Code::Less: a.integer = a.number < b.number; break;
+            case Code::Greater: a.integer = a.number > b.number; break;
+            case Code::LessEqual: a.integer = a.number <= b.number; break;
+            case Code::GreaterEqual: a.integer = a.number >= b.number; break;
+            case Code::Equal: a.integer = a.number == b.number; break;
+            case Code::NotEqual: a.integer = a.number != b.number; break;
+            case Code::EqualBool: a.integer = a.integer == b.integer; break;
+            case Code::NotEqualBool: a.integer = a.integer != b.integer; break;
+            case Code::And: a.integer = a.integer && b.integer; break;
+            case Code::Or: a.integer = a.integer || b.integer; break;
+            }
+            top--;  // Binary operators leave one value for two
+        }
+        result.type = type;
+        if (type == ValueType::Float) result.number = stack[0].number;
+        else result.integer = stack[0].integer;
+        return true;
+    }
+};
+
+/**
+ * @brief Compiles the lines whose types inference proved to TypedCode: declarations and
+ * assignments computing an int, float or bool into a variable of that type, and if conditions.
+ * Declarations and assignments only get it for an operator expression: a literal or a variable
+ * keeps its text as it's written (like 007 or 1.50), which the typed value wouldn't.
+ */
+class TypedCompiler {
+public:
+    // The typed code of every line, by line; most have none
+    static std::vector<TypedCode> compile(SyntaxTree& tree, size_t lineCount) {
+        TypedCompiler compiler;
+        compiler.code.resize(lineCount);
+        compiler.compileBlock(tree.body);
+        for (FunctionNode& node : tree.functions) {
+            compiler.compileBlock(node.body);
+        }
+        return std::move(compiler.code);
+    }
+
+private:
+    std::vector<TypedCode> code;
+
+    static bool isTyped(ValueType type) {
+        return type == ValueType::Int || type == ValueType::Float || type == ValueType::Bool;
+    }
+
+    void compileBlock(std::vector<Stmt>& block) {
+        for (Stmt& stmt : block) {
+            const Statement& statement = *stmt.statement;
+            const Expr* expr = stmt.exprs.empty() ? nullptr : stmt.exprs[0].get();
+            bool eligible = false;
+            if (stmt.kind() == StatementKind::Declaration || stmt.kind() == StatementKind::Assignment) {
+                eligible = !statement.isSpawn && !statement.isAwait && !statement.isRecv && statement.callee.empty()
+                        && stmt.targets[0] != nullptr && stmt.targets[0]->type == expr->type
+                        && (expr->kind == Expr::Kind::Binary || expr->kind == Expr::Kind::Unary);
+            } else if (stmt.kind() == StatementKind::If) {
+                eligible = expr->type == ValueType::Bool;
+            }
+
+            TypedCode typed;
+            size_t depth = 0;
+            if (eligible && isTyped(expr->type) && emit(*expr, typed.ops, depth)) {
+                typed.type = expr->type;
+                code[stmt.line] = std::move(typed);
+                stmt.typed = true;
+            }
+            compileBlock(stmt.body);
+        }
+    }
+
+    // Emits 'expr', leaving its value on the stack, which holds 'depth' values; false if it can't be typed
+    static bool emit(const Expr& expr, std::vector<TypedOp>& ops, size_t& depth) {
+        using Code = TypedOp::Code;
+        if (depth == TypedCode::MAX_STACK) {
+            return false;
+        }
+        TypedOp op;
+        switch (expr.kind) {
+        case Expr::Kind::Literal:
+            return emitLiteral(expr, ops, depth);
+        case Expr::Kind::Variable:
+            if (expr.binding == nullptr || !isTyped(expr.type)) {
+                return false;
+            }
+            op.code = expr.type == ValueType::Int ? Code::LoadInt : expr.type == ValueType::Float ? Code::LoadFloat : Code::LoadBool;
+            op.name = expr.text;
+            ops.push_back(std::move(op));
+            depth++;
+            return true;
+        case Expr::Kind::Unary: {
+            // The Evaluator can't read !!x, so a ! of a ! is left to it
+            const Expr& operand = *expr.children[0];
+            if (expr.text != "!" || operand.type != ValueType::Bool || operand.kind == Expr::Kind::Unary || !emit(operand, ops, depth)) {
+                return false;
+            }
+            op.code = Code::Not;
+            ops.push_back(op);
+            return true;
+        }
+        case Expr::Kind::Binary:
+            return emitBinary(expr, ops, depth);
+        default:
+            return false;
+        }
+    }
+
+    static bool emitLiteral(const Expr& expr, std::vector<TypedOp>& ops, size_t& depth) {
+        TypedOp op;
+        std::string_view text = expr.value.value;
+        if (expr.type == ValueType::Int) {
+            text = !text.empty() && text[0] == '+' ? text.substr(1) : text;
+            op.code = TypedOp::Code::PushInt;
+            if (std::from_chars(text.data(), text.data() + text.length(), op.integer).ptr != text.data() + text.length()) {
+                return false;  // Too long for an int
+            }
+        } else if (expr.type == ValueType::Float) {
+            op.code = TypedOp::Code::PushFloat;
+            errno = 0;
+            op.number = std::strtof(expr.value.value.c_str(), nullptr);
+            if (errno == ERANGE) {
+                return false;  // Not a number to the Evaluator
+            }
+        } else if (expr.type == ValueType::Bool) {
+            op.code = TypedOp::Code::PushBool;
+            op.integer = expr.value.asBool();
+        } else {
+            return false;
+        }
+        ops.push_back(op);
+        depth++;
+        return true;
+    }
+
+    static bool emitBinary(const Expr& expr, std::vector<TypedOp>& ops, size_t& depth) {
+        using Code = TypedOp::Code;
+        const Expr& lhs = *expr.children[0];
+        const Expr& rhs = *expr.children[1];
+        if (!isTyped(lhs.type) || !isTyped(rhs.type)) {
+            return false;
+        }
+        bool numbers = lhs.type != ValueType::Bool && rhs.type != ValueType::Bool;
+        bool bools = lhs.type == ValueType::Bool && rhs.type == ValueType::Bool;
+        bool floats = lhs.type == ValueType::Float || rhs.type == ValueType::Float;
+        const std::string& name = expr.text;
+
+        Code code;
+        bool inFloat = true;  // Operands are converted to float first
+        if (name == "&&" || name == "||") {
+            if (!bools) return false;
+            code = name == "&&" ? Code::And : Code::Or;
+            inFloat = false;
+        } else if ((name == "==" || name == "!=") && bools) {
+            code = name == "==" ? Code::EqualBool : Code::NotEqualBool;
+            inFloat = false;
+        } else if (!numbers) {
+            return false;
+        } else if (name == "==" || name == "!=" || name == "<" || name == ">" || name == "<=" || name == ">=") {
+            code = name == "==" ? Code::Equal : name == "!=" ? Code::NotEqual : name == "<" ? Code::Less
+                 : name == ">" ? Code::Greater : name == "<=" ? Code::LessEqual : Code::GreaterEqual;
+        } else if (name == "+" || name == "-" || name == "*") {
+            inFloat = floats;
+            code = name == "+" ? (floats ? Code::AddFloat : Code::AddInt)
+                 : name == "-" ? (floats ? Code::SubFloat : Code::SubInt)
+                 : (floats ? Code::MulFloat : Code::MulInt);
+        } else if (name == "/" && floats) {
+            code = Code::DivFloat;
+        } else if (name == "%" && !floats) {
+            code = Code::ModInt;
+            inFloat = false;
+        } else {
+            return false;
+        }
+
+        for (const Expr* operand : { &lhs, &rhs }) {
+            if (!emit(*operand, ops, depth)) {
+                return false;
+            }
+            if (inFloat && operand->type == ValueType::Int) {
+                TypedOp convert;
+                convert.code = Code::ToFloat;
+                ops.push_back(convert);
+            }
+        }
+        TypedOp op;
+        op.code = code;
+        ops.push_back(op);
+        depth--;
+        return true;
+    }
+};
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "ast.hpp"
+
+/**
+ * @brief Infers the type of every variable and expression of a SyntaxTree.
+ * A variable's type joins the types of all the values it's given, anywhere in the script; one
+ * that only ever holds ints, say, is an int variable. Values come from the statements that write
+ * variables (var, assignment, csv, read, select). Since a variable's values can depend on other
+ * variables (or on itself, in a loop), the statements are gone over until no type changes.
+ *
+ * The rules follow the Evaluator, and give a type only where it never depends on the values:
+ * int / int is an int or a float depending on whether it divides, and a string in arithmetic
+ * may be a number, so those are Mixed. Calls, parameters, columns, indexing and the values of
+ * await, recv and spawn are Mixed too.
+ */
+class TypeInference {
+public:
+    static void run(SyntaxTree& tree) {
+        TypeInference inference;
+        inference.collectBlock(tree.body);
+        for (FunctionNode& node : tree.functions) {
+            inference.collectBlock(node.body);
+        }
+        do {
+            inference.changed = false;
+            for (const auto& source : inference.computed) {
+                inference.assign(source.first, inference.infer(*source.second));
+            }
+        } while (inference.changed);
+
+        // What was never given a value has no known type; then every expression gets its final type
+        inference.finished = true;
+        for (Binding& binding : tree.allBindings) {
+            binding.type = inference.typeOf(&binding);
+        }
+        inference.inferBlock(tree.body);
+        for (FunctionNode& node : tree.functions) {
+            inference.inferBlock(node.body);
+        }
+    }
+
+    // One type for two values: the same one, or Mixed; Unknown adds nothing
+    static ValueType join(ValueType a, ValueType b) {
+        if (a == ValueType::Unknown) return b;
+        if (b == ValueType::Unknown || a == b) return a;
+        return ValueType::Mixed;
+    }
+
+private:
+    std::vector<std::pair<const Binding*, Expr*>> computed;  // Variables given the value of an expression
+    bool changed = false;
+    bool finished = false;
+
+    ValueType typeOf(const Binding* binding) const {
+        if (binding == nullptr) {
+            return ValueType::Mixed;
+        }
+        if (binding->kind != Binding::Kind::Global && binding->kind != Binding::Kind::Local) {
+            return ValueType::Mixed;  // Parameters, elements and columns can be anything
+        }
+        return binding->type == ValueType::Unknown ? (finished ? ValueType::Mixed : ValueType::Unknown) : binding->type;
+    }
+
+    void assign(const Binding* binding, ValueType type) {
+        if (binding == nullptr) {
+            return;
+        }
+        // The tree is ours to change; its expressions only point to bindings as const
+        ValueType& current = const_cast<Binding*>(binding)->type;
+        ValueType joined = join(current, type);
+        if (joined != current) {
+            current = joined;
+            changed = true;
+        }
+    }
+
+    // Gives the variables written with a type known up front theirs, and collects the rest
+    void collectBlock(std::vector<Stmt>& block) {
+        for (Stmt& stmt : block) {
+            const Statement& statement = *stmt.statement;
+            switch (stmt.kind()) {
+            case StatementKind::Declaration:
+            case StatementKind::Assignment:
+                if (statement.isSpawn || statement.isAwait || statement.isRecv) {
+                    assign(stmt.targets[0], ValueType::Mixed);
+                } else if (stmt.targets[0] != nullptr) {
+                    computed.emplace_back(stmt.targets[0], stmt.exprs[0].get());
+                }
+                break;
+            case StatementKind::CsvOpen:
+            case StatementKind::CsvRead:
+                // The reader tells whether a record was read; fields take the file's types
+                assign(stmt.targets[0], ValueType::Bool);
+                for (size_t i = 1; i < stmt.targets.size(); ++i) {
+                    assign(stmt.targets[i], ValueType::Mixed);
+                }
+                break;
+            case StatementKind::Select:
+                assign(stmt.targets[0], ValueType::Int);
+                assign(stmt.targets[1], ValueType::Mixed);
+                break;
+            default:
+                for (const Binding* target : stmt.targets) {
+                    assign(target, ValueType::Mixed);
+                }
+                break;
+            }
+            collectBlock(stmt.body);
+        }
+    }
+
+    void inferBlock(std::vector<Stmt>& block) {
+        for (Stmt& stmt : block) {
+            for (auto& expr : stmt.exprs) {
+                infer(*expr);
+            }
+            inferBlock(stmt.body);
+        }
+    }
+
+    static bool isNumber(ValueType type) { return type == ValueType::Int || type == ValueType::Float; }
+
+    ValueType infer(Expr& expr) {
+        for (auto& child : expr.children) {
+            infer(*child);
+        }
+        switch (expr.kind) {
+        case Expr::Kind::Literal:
+            expr.type = expr.value.type == "int" ? ValueType::Int
+                      : expr.value.type == "float" ? ValueType::Float
+                      : expr.value.type == "bool" ? ValueType::Bool
+                      : ValueType::String;
+            break;
+        case Expr::Kind::Interpolation:
+        case Expr::Kind::Input:
+            expr.type = ValueType::String;
+            break;
+        case Expr::Kind::Variable:
+            expr.type = typeOf(expr.binding);
+            break;
+        case Expr::Kind::Unary:
+            expr.type = expr.text == "!" ? logical(expr.children[0]->type, ValueType::Bool) : ValueType::Mixed;
+            break;
+        case Expr::Kind::Binary:
+            expr.type = binary(expr.text, expr.children[0]->type, expr.children[1]->type);
+            break;
+        default:
+            expr.type = ValueType::Mixed;
+            break;
+        }
+        return expr.type;
+    }
+
+    // Bool if both operands are; Unknown until they are known
+    static ValueType logical(ValueType lhs, ValueType rhs) {
+        if (lhs == ValueType::Unknown || rhs == ValueType::Unknown) {
+            return lhs == ValueType::Mixed || rhs == ValueType::Mixed ? ValueType::Mixed : ValueType::Unknown;
+        }
+        return lhs == ValueType::Bool && rhs == ValueType::Bool ? ValueType::Bool : ValueType::Mixed;
+    }
+
+    static ValueType binary(const std::string& op, ValueType lhs, ValueType rhs) {
+        if (lhs == ValueType::Mixed || rhs == ValueType::Mixed) {
+            return ValueType::Mixed;
+        }
+        if (lhs == ValueType::Unknown || rhs == ValueType::Unknown) {
+            return ValueType::Unknown;
+        }
+        bool numbers = isNumber(lhs) && isNumber(rhs);
+        ValueType arithmetic = lhs == ValueType::Float || rhs == ValueType::Float ? ValueType::Float : ValueType::Int;
+
+        if (op == "&&" || op == "||") {
+            return logical(lhs, rhs);
+        }
+        if (op == "==" || op == "!=") {
+            return numbers || lhs == rhs ? ValueType::Bool : ValueType::Mixed;
+        }
+        if (op == "<" || op == ">" || op == "<=" || op == ">=") {
+            return numbers ? ValueType::Bool : ValueType::Mixed;
+        }
+        if (!numbers) {
+            return ValueType::Mixed;  // Strings may hold numbers, which arithmetic reads
+        }
+        if (op == "/") {
+            return arithmetic == ValueType::Float ? ValueType::Float : ValueType::Mixed;
+        }
+        if (op == "%") {
+            return arithmetic == ValueType::Int ? ValueType::Int : ValueType::Mixed;
+        }
+        return arithmetic;  // + - *
+    }
+};
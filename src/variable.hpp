@@ -5,15 +5,29 @@
 #include <vector>
 #include <fstream>
 #include <cctype>
-#include <regex>
 #include <map>
+#include <memory>
+#include <charconv>
+#include <cmath>
 
 class Variable {
 public:
     std::string name;
     std::string value;
     std::string type;
+    std::shared_ptr<const ArrayData> array;  // Elements, if the value is an array
+    std::shared_ptr<const TableData> table;  // Columns, if the value is a table
+    std::shared_ptr<const std::string> text; // Text, if the value is a long string (see EvalResult::fromString)
+    SymbolRef symbol;                        // Set if the value is an interned string
     int scopeLevel = 0;
+    bool saved = false;  // The engine's undo log holds this variable's checkpoint value
+
+    // The value unboxed, for typed code (see TypedCode): stored along with the text by setInt(),
+    // setFloat() and setBool(), or read from the text on first use. Unknown when it isn't set;
+    // anything that writes 'value' or 'type' directly has to reset it.
+    ValueType unboxedType = ValueType::Unknown;
+    long long unboxedInt = 0;  // An int, or a bool as 0 or 1
+    float unboxedFloat = 0;
 
     Variable(const std::string n, int scope)
         : name(n), value(""), type("undefined"), scopeLevel(scope) {}
@@ -21,10 +35,51 @@ public:
     void setValue(const EvalResult& result) {
         value = result.value;
         type = result.type;
+        array = result.array;
+        table = result.table;
+        text = result.text;
+        symbol = result.symbol;
+        unboxedType = ValueType::Unknown;
+    }
+
+    // Takes over the result's buffers, e.g. for a value received from a channel
+    void setValue(EvalResult&& result) {
+        value = std::move(result.value);
+        type = std::move(result.type);
+        array = std::move(result.array);
+        table = std::move(result.table);
+        text = std::move(result.text);
+        symbol = std::move(result.symbol);
+        unboxedType = ValueType::Unknown;
+    }
+
+    // Stores a value computed by typed code, written as the Evaluator writes it
+    void setInt(long long number) {
+        char buffer[24];
+        value.assign(buffer, std::to_chars(buffer, buffer + sizeof(buffer), number).ptr);
+        setUnboxed("int", ValueType::Int);
+        unboxedInt = number;
+    }
+
+    void setFloat(float number) {
+        value = formatFloat(number);
+        setUnboxed("float", std::isfinite(number) ? ValueType::Float : ValueType::Unknown);  // "inf" doesn't read back
+        unboxedFloat = number;
+    }
+
+    void setBool(bool flag) {
+        value = flag ? "true" : "false";
+        setUnboxed("bool", ValueType::Bool);
+        unboxedInt = flag;
     }
 
     EvalResult getAsResult() const {
-        return EvalResult(value, type);
+        EvalResult result(value, type);
+        result.array = array;
+        result.table = table;
+        result.text = text;
+        result.symbol = symbol;
+        return result;
     }
 
     // Getters
@@ -41,10 +96,38 @@ public:
     }
 
     std::string asString() const {
-        if (type == "string" && value.length() >= 2 && value.front() == '"') {
-            return value.substr(1, value.length() - 2);
+        if (type == "array" || type == "table") {
+            return getAsResult().asString();
         }
-        // Return raw value if it's not a standard string literal
+        return std::string(stringView());
+    }
+
+    // Like EvalResult::stringView()
+    std::string_view stringView() const {
+        if (symbol != nullptr) return symbol->text;
+        if (text) return *text;
         return value;
     }
-};
\ No newline at end of file
+
+private:
+    void setUnboxed(const char* typeName, ValueType unboxed) {
+        if (type != typeName) type = typeName;
+        array.reset();
+        table.reset();
+        text.reset();
+        symbol.reset();
+        unboxedType = unboxed;
+    }
+};
+
+// Pre-resolved global variable, obtained once with ExecutionEngine::getGlobal().
+// Globals live in scope 0, which is never cleared, so the handle stays valid, except for a global
+// declared since the engine's checkpoint: reset() removes those. Its handle is only valid until the
+// next checkpoint() or reset(), which 'epoch' tells the engine.
+struct GlobalHandle {
+    Variable* variable = nullptr;
+    bool sinceCheckpoint = false;
+    unsigned long long epoch = 0;
+
+    explicit operator bool() const { return variable != nullptr; }
+};
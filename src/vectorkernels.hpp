@@ -0,0 +1,675 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define SPHYNX_HAS_X86_SIMD 1
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define SPHYNX_TARGET_AVX2
+#else
+#define SPHYNX_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+/*
+Kernels for numeric arrays.
+Every kernel has a scalar version. On x86-64 there are SSE2 versions (always available there)
+and AVX2 versions, and VectorKernels::best() picks the widest set the CPU supports, once per process.
+
+Element-wise kernels take each operand as a pointer and a stride: stride 1 walks an array,
+stride 0 repeats a single scalar. Reductions require at least one element.
+Int arithmetic wraps around on overflow; int division truncates and gives 0 for a zero divisor.
+
+Masks are arrays of bytes that are 0 or 1. The compaction kernels copy the elements whose mask
+byte is 1 without branching on it; their output needs room for countTrue(mask) + 4 elements.
+*/
+
+enum class VectorOp { Add, Sub, Mul, Div };
+enum class VectorCompare { Lt, Gt, Le, Ge, Eq, Ne };
+enum class MaskOp { And, Or };
+
+struct ScalarKernels {
+    static double sumFloat(const double* a, size_t n) {
+        double sum = 0;
+        for (size_t i = 0; i < n; ++i) sum += a[i];
+        return sum;
+    }
+
+    static long long sumInt(const long long* a, size_t n) {
+        unsigned long long sum = 0;
+        for (size_t i = 0; i < n; ++i) sum += static_cast<unsigned long long>(a[i]);
+        return static_cast<long long>(sum);
+    }
+
+    static double minFloat(const double* a, size_t n) { return *std::min_element(a, a + n); }
+    static double maxFloat(const double* a, size_t n) { return *std::max_element(a, a + n); }
+    static long long minInt(const long long* a, size_t n) { return *std::min_element(a, a + n); }
+    static long long maxInt(const long long* a, size_t n) { return *std::max_element(a, a + n); }
+
+    static double dotFloat(const double* a, const double* b, size_t n) {
+        double sum = 0;
+        for (size_t i = 0; i < n; ++i) sum += a[i] * b[i];
+        return sum;
+    }
+
+    static long long dotInt(const long long* a, const long long* b, size_t n) {
+        unsigned long long sum = 0;
+        for (size_t i = 0; i < n; ++i) {
+            sum += static_cast<unsigned long long>(a[i]) * static_cast<unsigned long long>(b[i]);
+        }
+        return static_cast<long long>(sum);
+    }
+
+    static void arithmeticFloat(VectorOp op, const double* a, size_t aStride, const double* b, size_t bStride, double* out, size_t n) {
+        switch (op) {
+        case VectorOp::Add: arithmeticLoop<VectorOp::Add>(a, aStride, b, bStride, out, n); break;
+        case VectorOp::Sub: arithmeticLoop<VectorOp::Sub>(a, aStride, b, bStride, out, n); break;
+        case VectorOp::Mul: arithmeticLoop<VectorOp::Mul>(a, aStride, b, bStride, out, n); break;
+        case VectorOp::Div: arithmeticLoop<VectorOp::Div>(a, aStride, b, bStride, out, n); break;
+        }
+    }
+
+    static void arithmeticInt(VectorOp op, const long long* a, size_t aStride, const long long* b, size_t bStride, long long* out, size_t n) {
+        switch (op) {
+        case VectorOp::Add: intLoop<VectorOp::Add>(a, aStride, b, bStride, out, n); break;
+        case VectorOp::Sub: intLoop<VectorOp::Sub>(a, aStride, b, bStride, out, n); break;
+        case VectorOp::Mul: intLoop<VectorOp::Mul>(a, aStride, b, bStride, out, n); break;
+        case VectorOp::Div: intLoop<VectorOp::Div>(a, aStride, b, bStride, out, n); break;
+        }
+    }
+
+    static void compareFloat(VectorCompare compare, const double* a, size_t aStride, const double* b, size_t bStride, uint8_t* out, size_t n) {
+        compareAny(compare, a, aStride, b, bStride, out, n);
+    }
+
+    static void compareInt(VectorCompare compare, const long long* a, size_t aStride, const long long* b, size_t bStride, uint8_t* out, size_t n) {
+        compareAny(compare, a, aStride, b, bStride, out, n);
+    }
+
+    static size_t countTrue(const uint8_t* mask, size_t n) {
+        size_t count = 0;
+        for (size_t i = 0; i < n; ++i) count += mask[i];
+        return count;
+    }
+
+    static void maskLogic(MaskOp op, const uint8_t* a, size_t aStride, const uint8_t* b, size_t bStride, uint8_t* out, size_t n) {
+        maskLoop(op, a, aStride, b, bStride, out, n);
+    }
+
+    static void maskNot(const uint8_t* a, uint8_t* out, size_t n) { maskNotLoop(a, out, n); }
+
+    static size_t compactInt(const long long* a, const uint8_t* mask, size_t n, long long* out) { return compactLoop(a, mask, n, out); }
+    static size_t compactFloat(const double* a, const uint8_t* mask, size_t n, double* out) { return compactLoop(a, mask, n, out); }
+
+    // Tails of the SIMD loops use these too
+    template <VectorOp Op>
+    static void arithmeticLoop(const double* a, size_t aStride, const double* b, size_t bStride, double* out, size_t n, size_t i = 0) {
+        for (; i < n; ++i) {
+            double x = a[i * aStride];
+            double y = b[i * bStride];
+            if constexpr (Op == VectorOp::Add) out[i] = x + y;
+            else if constexpr (Op == VectorOp::Sub) out[i] = x - y;
+            else if constexpr (Op == VectorOp::Mul) out[i] = x * y;
+            else out[i] = x / y;
+        }
+    }
+
+    template <VectorOp Op>
+    static void intLoop(const long long* a, size_t aStride, const long long* b, size_t bStride, long long* out, size_t n, size_t i = 0) {
+        for (; i < n; ++i) {
+            unsigned long long x = static_cast<unsigned long long>(a[i * aStride]);
+            unsigned long long y = static_cast<unsigned long long>(b[i * bStride]);
+            if constexpr (Op == VectorOp::Add) out[i] = static_cast<long long>(x + y);
+            else if constexpr (Op == VectorOp::Sub) out[i] = static_cast<long long>(x - y);
+            else if constexpr (Op == VectorOp::Mul) out[i] = static_cast<long long>(x * y);
+            else if (y == 0) out[i] = 0;
+            else if (b[i * bStride] == -1) out[i] = static_cast<long long>(0 - x);
+            else out[i] = a[i * aStride] / b[i * bStride];
+        }
+    }
+
+    static void maskLoop(MaskOp op, const uint8_t* a, size_t aStride, const uint8_t* b, size_t bStride, uint8_t* out, size_t n, size_t i = 0) {
+        for (; i < n; ++i) {
+            out[i] = op == MaskOp::And ? (a[i * aStride] & b[i * bStride]) : (a[i * aStride] | b[i * bStride]);
+        }
+    }
+
+    static void maskNotLoop(const uint8_t* a, uint8_t* out, size_t n, size_t i = 0) {
+        for (; i < n; ++i) out[i] = a[i] ^ 1;
+    }
+
+    // Every element is written; only the kept ones advance the output
+    template <typename T>
+    static size_t compactLoop(const T* a, const uint8_t* mask, size_t n, T* out, size_t i = 0, size_t kept = 0) {
+        for (; i < n; ++i) {
+            out[kept] = a[i];
+            kept += mask[i];
+        }
+        return kept;
+    }
+
+    template <typename T>
+    static void compareAny(VectorCompare compare, const T* a, size_t aStride, const T* b, size_t bStride, uint8_t* out, size_t n, size_t i = 0) {
+        for (; i < n; ++i) {
+            T x = a[i * aStride];
+            T y = b[i * bStride];
+            bool result;
+            switch (compare) {
+            case VectorCompare::Lt: result = x < y; break;
+            case VectorCompare::Gt: result = x > y; break;
+            case VectorCompare::Le: result = x <= y; break;
+            case VectorCompare::Ge: result = x >= y; break;
+            case VectorCompare::Eq: result = x == y; break;
+            default: result = x != y; break;
+            }
+            out[i] = result ? 1 : 0;
+        }
+    }
+};
+
+#ifdef SPHYNX_HAS_X86_SIMD
+
+// Two doubles or int64s per instruction. 64-bit int compares and multiplies need later
+// instruction sets, so those stay scalar.
+struct Sse2Kernels {
+    static double sumFloat(const double* a, size_t n) {
+        __m128d sum0 = _mm_setzero_pd();
+        __m128d sum1 = _mm_setzero_pd();
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            sum0 = _mm_add_pd(sum0, _mm_loadu_pd(a + i));
+            sum1 = _mm_add_pd(sum1, _mm_loadu_pd(a + i + 2));
+        }
+        double lanes[2];
+        _mm_storeu_pd(lanes, _mm_add_pd(sum0, sum1));
+        double sum = lanes[0] + lanes[1];
+        for (; i < n; ++i) sum += a[i];
+        return sum;
+    }
+
+    static long long sumInt(const long long* a, size_t n) {
+        __m128i sum = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 2 <= n; i += 2) {
+            sum = _mm_add_epi64(sum, _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+        }
+        long long lanes[2];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), sum);
+        return ScalarKernels::sumInt(lanes, 2) + ScalarKernels::sumInt(a + i, n - i);
+    }
+
+    static double minFloat(const double* a, size_t n) {
+        if (n < 2) return a[0];
+        __m128d result = _mm_loadu_pd(a);
+        size_t i = 2;
+        for (; i + 2 <= n; i += 2) result = _mm_min_pd(result, _mm_loadu_pd(a + i));
+        double lanes[2];
+        _mm_storeu_pd(lanes, result);
+        double min = std::min(lanes[0], lanes[1]);
+        for (; i < n; ++i) min = std::min(min, a[i]);
+        return min;
+    }
+
+    static double maxFloat(const double* a, size_t n) {
+        if (n < 2) return a[0];
+        __m128d result = _mm_loadu_pd(a);
+        size_t i = 2;
+        for (; i + 2 <= n; i += 2) result = _mm_max_pd(result, _mm_loadu_pd(a + i));
+        double lanes[2];
+        _mm_storeu_pd(lanes, result);
+        double max = std::max(lanes[0], lanes[1]);
+        for (; i < n; ++i) max = std::max(max, a[i]);
+        return max;
+    }
+
+    static double dotFloat(const double* a, const double* b, size_t n) {
+        __m128d sum = _mm_setzero_pd();
+        size_t i = 0;
+        for (; i + 2 <= n; i += 2) {
+            sum = _mm_add_pd(sum, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+        }
+        double lanes[2];
+        _mm_storeu_pd(lanes, sum);
+        return lanes[0] + lanes[1] + ScalarKernels::dotFloat(a + i, b + i, n - i);
+    }
+
+    static void arithmeticFloat(VectorOp op, const double* a, size_t aStride, const double* b, size_t bStride, double* out, size_t n) {
+        switch (op) {
+        case VectorOp::Add: arithmeticLoop<VectorOp::Add>(a, aStride, b, bStride, out, n); break;
+        case VectorOp::Sub: arithmeticLoop<VectorOp::Sub>(a, aStride, b, bStride, out, n); break;
+        case VectorOp::Mul: arithmeticLoop<VectorOp::Mul>(a, aStride, b, bStride, out, n); break;
+        case VectorOp::Div: arithmeticLoop<VectorOp::Div>(a, aStride, b, bStride, out, n); break;
+        }
+    }
+
+    static void arithmeticInt(VectorOp op, const long long* a, size_t aStride, const long long* b, size_t bStride, long long* out, size_t n) {
+        switch (op) {
+        case VectorOp::Add: intLoop<VectorOp::Add>(a, aStride, b, bStride, out, n); break;
+        case VectorOp::Sub: intLoop<VectorOp::Sub>(a, aStride, b, bStride, out, n); break;
+        default: ScalarKernels::arithmeticInt(op, a, aStride, b, bStride, out, n); break;
+        }
+    }
+
+    static void compareFloat(VectorCompare compare, const double* a, size_t aStride, const double* b, size_t bStride, uint8_t* out, size_t n) {
+        size_t i = 0;
+        for (; i + 2 <= n; i += 2) {
+            __m128d x = aStride ? _mm_loadu_pd(a + i) : _mm_set1_pd(*a);
+            __m128d y = bStride ? _mm_loadu_pd(b + i) : _mm_set1_pd(*b);
+            __m128d mask;
+            switch (compare) {
+            case VectorCompare::Lt: mask = _mm_cmplt_pd(x, y); break;
+            case VectorCompare::Gt: mask = _mm_cmpgt_pd(x, y); break;
+            case VectorCompare::Le: mask = _mm_cmple_pd(x, y); break;
+            case VectorCompare::Ge: mask = _mm_cmpge_pd(x, y); break;
+            case VectorCompare::Eq: mask = _mm_cmpeq_pd(x, y); break;
+            default: mask = _mm_cmpneq_pd(x, y); break;
+            }
+            int bits = _mm_movemask_pd(mask);
+            out[i] = bits & 1;
+            out[i + 1] = (bits >> 1) & 1;
+        }
+        ScalarKernels::compareAny(compare, a, aStride, b, bStride, out, n, i);
+    }
+
+    static void compareInt(VectorCompare compare, const long long* a, size_t aStride, const long long* b, size_t bStride, uint8_t* out, size_t n) {
+        ScalarKernels::compareAny(compare, a, aStride, b, bStride, out, n);
+    }
+
+    static long long minInt(const long long* a, size_t n) { return ScalarKernels::minInt(a, n); }
+    static long long maxInt(const long long* a, size_t n) { return ScalarKernels::maxInt(a, n); }
+    static long long dotInt(const long long* a, const long long* b, size_t n) { return ScalarKernels::dotInt(a, b, n); }
+
+    static size_t countTrue(const uint8_t* mask, size_t n) {
+        __m128i sums = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            sums = _mm_add_epi64(sums, _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(mask + i)), _mm_setzero_si128()));
+        }
+        long long lanes[2];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), sums);
+        return static_cast<size_t>(lanes[0] + lanes[1]) + ScalarKernels::countTrue(mask + i, n - i);
+    }
+
+    static void maskLogic(MaskOp op, const uint8_t* a, size_t aStride, const uint8_t* b, size_t bStride, uint8_t* out, size_t n) {
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            __m128i x = aStride ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)) : _mm_set1_epi8(static_cast<char>(*a));
+            __m128i y = bStride ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)) : _mm_set1_epi8(static_cast<char>(*b));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), op == MaskOp::And ? _mm_and_si128(x, y) : _mm_or_si128(x, y));
+        }
+        ScalarKernels::maskLoop(op, a, aStride, b, bStride, out, n, i);
+    }
+
+    static void maskNot(const uint8_t* a, uint8_t* out, size_t n) {
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_xor_si128(x, _mm_set1_epi8(1)));
+        }
+        ScalarKernels::maskNotLoop(a, out, n, i);
+    }
+
+    // SSE2 has no variable shuffle to do better than the branch-free scalar loop
+    static size_t compactInt(const long long* a, const uint8_t* mask, size_t n, long long* out) { return ScalarKernels::compactInt(a, mask, n, out); }
+    static size_t compactFloat(const double* a, const uint8_t* mask, size_t n, double* out) { return ScalarKernels::compactFloat(a, mask, n, out); }
+
+private:
+    template <VectorOp Op>
+    static void arithmeticLoop(const double* a, size_t aStride, const double* b, size_t bStride, double* out, size_t n) {
+        size_t i = 0;
+        for (; i + 2 <= n; i += 2) {
+            __m128d x = aStride ? _mm_loadu_pd(a + i) : _mm_set1_pd(*a);
+            __m128d y = bStride ? _mm_loadu_pd(b + i) : _mm_set1_pd(*b);
+            if constexpr (Op == VectorOp::Add) _mm_storeu_pd(out + i, _mm_add_pd(x, y));
+            else if constexpr (Op == VectorOp::Sub) _mm_storeu_pd(out + i, _mm_sub_pd(x, y));
+            else if constexpr (Op == VectorOp::Mul) _mm_storeu_pd(out + i, _mm_mul_pd(x, y));
+            else _mm_storeu_pd(out + i, _mm_div_pd(x, y));
+        }
+        ScalarKernels::arithmeticLoop<Op>(a, aStride, b, bStride, out, n, i);
+    }
+
+    template <VectorOp Op>
+    static void intLoop(const long long* a, size_t aStride, const long long* b, size_t bStride, long long* out, size_t n) {
+        size_t i = 0;
+        for (; i + 2 <= n; i += 2) {
+            __m128i x = aStride ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)) : _mm_set1_epi64x(*a);
+            __m128i y = bStride ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)) : _mm_set1_epi64x(*b);
+            __m128i result = Op == VectorOp::Add ? _mm_add_epi64(x, y) : _mm_sub_epi64(x, y);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), result);
+        }
+        ScalarKernels::intLoop<Op>(a, aStride, b, bStride, out, n, i);
+    }
+};
+
+// Four doubles or int64s per instruction. AVX2 has 64-bit int compares but no 64-bit multiply.
+struct Avx2Kernels {
+    SPHYNX_TARGET_AVX2 static double sumFloat(const double* a, size_t n) {
+        __m256d sum0 = _mm256_setzero_pd();
+        __m256d sum1 = _mm256_setzero_pd();
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            sum0 = _mm256_add_pd(sum0, _mm256_loadu_pd(a + i));
+            sum1 = _mm256_add_pd(sum1, _mm256_loadu_pd(a + i + 4));
+        }
+        double lanes[4];
+        _mm256_storeu_pd(lanes, _mm256_add_pd(sum0, sum1));
+        double sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+        for (; i < n; ++i) sum += a[i];
+        return sum;
+    }
+
+    SPHYNX_TARGET_AVX2 static long long sumInt(const long long* a, size_t n) {
+        __m256i sum = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            sum = _mm256_add_epi64(sum, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)));
+        }
+        long long lanes[4];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), sum);
+        return ScalarKernels::sumInt(lanes, 4) + ScalarKernels::sumInt(a + i, n - i);
+    }
+
+    SPHYNX_TARGET_AVX2 static double minFloat(const double* a, size_t n) {
+        if (n < 4) return ScalarKernels::minFloat(a, n);
+        __m256d result = _mm256_loadu_pd(a);
+        size_t i = 4;
+        for (; i + 4 <= n; i += 4) result = _mm256_min_pd(result, _mm256_loadu_pd(a + i));
+        double lanes[4];
+        _mm256_storeu_pd(lanes, result);
+        double min = ScalarKernels::minFloat(lanes, 4);
+        for (; i < n; ++i) min = std::min(min, a[i]);
+        return min;
+    }
+
+    SPHYNX_TARGET_AVX2 static double maxFloat(const double* a, size_t n) {
+        if (n < 4) return ScalarKernels::maxFloat(a, n);
+        __m256d result = _mm256_loadu_pd(a);
+        size_t i = 4;
+        for (; i + 4 <= n; i += 4) result = _mm256_max_pd(result, _mm256_loadu_pd(a + i));
+        double lanes[4];
+        _mm256_storeu_pd(lanes, result);
+        double max = ScalarKernels::maxFloat(lanes, 4);
+        for (; i < n; ++i) max = std::max(max, a[i]);
+        return max;
+    }
+
+    SPHYNX_TARGET_AVX2 static long long minInt(const long long* a, size_t n) {
+        if (n < 4) return ScalarKernels::minInt(a, n);
+        __m256i result = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a));
+        size_t i = 4;
+        for (; i + 4 <= n; i += 4) {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            result = _mm256_blendv_epi8(result, x, _mm256_cmpgt_epi64(result, x));
+        }
+        long long lanes[4];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), result);
+        long long min = ScalarKernels::minInt(lanes, 4);
+        for (; i < n; ++i) min = std::min(min, a[i]);
+        return min;
+    }
+
+    SPHYNX_TARGET_AVX2 static long long maxInt(const long long* a, size_t n) {
+        if (n < 4) return ScalarKernels::maxInt(a, n);
+        __m256i result = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a));
+        size_t i = 4;
+        for (; i + 4 <= n; i += 4) {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            result = _mm256_blendv_epi8(result, x, _mm256_cmpgt_epi64(x, result));
+        }
+        long long lanes[4];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), result);
+        long long max = ScalarKernels::maxInt(lanes, 4);
+        for (; i < n; ++i) max = std::max(max, a[i]);
+        return max;
+    }
+
+    SPHYNX_TARGET_AVX2 static double dotFloat(const double* a, const double* b, size_t n) {
+        __m256d sum = _mm256_setzero_pd();
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            sum = _mm256_add_pd(sum, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+        }
+        double lanes[4];
+        _mm256_storeu_pd(lanes, sum);
+        return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + ScalarKernels::dotFloat(a + i, b + i, n - i);
+    }
+
+    static long long dotInt(const long long* a, const long long* b, size_t n) { return ScalarKernels::dotInt(a, b, n); }
+
+    static void arithmeticFloat(VectorOp op, const double* a, size_t aStride, const double* b, size_t bStride, double* out, size_t n) {
+        switch (op) {
+        case VectorOp::Add: arithmeticLoop<VectorOp::Add>(a, aStride, b, bStride, out, n); break;
+        case VectorOp::Sub: arithmeticLoop<VectorOp::Sub>(a, aStride, b, bStride, out, n); break;
+        case VectorOp::Mul: arithmeticLoop<VectorOp::Mul>(a, aStride, b, bStride, out, n); break;
+        case VectorOp::Div: arithmeticLoop<VectorOp::Div>(a, aStride, b, bStride, out, n); break;
+        }
+    }
+
+    static void arithmeticInt(VectorOp op, const long long* a, size_t aStride, const long long* b, size_t bStride, long long* out, size_t n) {
+        switch (op) {
+        case VectorOp::Add: intLoop<VectorOp::Add>(a, aStride, b, bStride, out, n); break;
+        case VectorOp::Sub: intLoop<VectorOp::Sub>(a, aStride, b, bStride, out, n); break;
+        default: ScalarKernels::arithmeticInt(op, a, aStride, b, bStride, out, n); break;
+        }
+    }
+
+    static void compareFloat(VectorCompare compare, const double* a, size_t aStride, const double* b, size_t bStride, uint8_t* out, size_t n) {
+        switch (compare) {
+        case VectorCompare::Lt: compareFloatLoop<_CMP_LT_OQ>(a, aStride, b, bStride, out, n); break;
+        case VectorCompare::Gt: compareFloatLoop<_CMP_GT_OQ>(a, aStride, b, bStride, out, n); break;
+        case VectorCompare::Le: compareFloatLoop<_CMP_LE_OQ>(a, aStride, b, bStride, out, n); break;
+        case VectorCompare::Ge: compareFloatLoop<_CMP_GE_OQ>(a, aStride, b, bStride, out, n); break;
+        case VectorCompare::Eq: compareFloatLoop<_CMP_EQ_OQ>(a, aStride, b, bStride, out, n); break;
+        case VectorCompare::Ne: compareFloatLoop<_CMP_NEQ_UQ>(a, aStride, b, bStride, out, n); break;
+        }
+        if (n % 4 != 0) {
+            ScalarKernels::compareAny(compare, a, aStride, b, bStride, out, n, n - n % 4);
+        }
+    }
+
+    // x < y is y > x, and the "or equal" compares are the negated strict ones
+    SPHYNX_TARGET_AVX2 static void compareInt(VectorCompare compare, const long long* a, size_t aStride, const long long* b, size_t bStride,
+                                              uint8_t* out, size_t n) {
+        bool swap = compare == VectorCompare::Lt || compare == VectorCompare::Ge;
+        bool equality = compare == VectorCompare::Eq || compare == VectorCompare::Ne;
+        int negate = (compare == VectorCompare::Le || compare == VectorCompare::Ge || compare == VectorCompare::Ne) ? 0xF : 0;
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            __m256i x = aStride ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)) : _mm256_set1_epi64x(*a);
+            __m256i y = bStride ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)) : _mm256_set1_epi64x(*b);
+            __m256i mask = equality ? _mm256_cmpeq_epi64(x, y) : swap ? _mm256_cmpgt_epi64(y, x) : _mm256_cmpgt_epi64(x, y);
+            int bits = _mm256_movemask_pd(_mm256_castsi256_pd(mask)) ^ negate;
+            for (int k = 0; k < 4; ++k) out[i + k] = (bits >> k) & 1;
+        }
+        ScalarKernels::compareAny(compare, a, aStride, b, bStride, out, n, i);
+    }
+
+    SPHYNX_TARGET_AVX2 static size_t countTrue(const uint8_t* mask, size_t n) {
+        __m256i sums = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+            __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mask + i));
+            sums = _mm256_add_epi64(sums, _mm256_sad_epu8(bytes, _mm256_setzero_si256()));
+        }
+        long long lanes[4];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), sums);
+        return static_cast<size_t>(lanes[0] + lanes[1] + lanes[2] + lanes[3]) + ScalarKernels::countTrue(mask + i, n - i);
+    }
+
+    SPHYNX_TARGET_AVX2 static void maskLogic(MaskOp op, const uint8_t* a, size_t aStride, const uint8_t* b, size_t bStride,
+                                             uint8_t* out, size_t n) {
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+            __m256i x = aStride ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)) : _mm256_set1_epi8(static_cast<char>(*a));
+            __m256i y = bStride ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)) : _mm256_set1_epi8(static_cast<char>(*b));
+            __m256i result = op == MaskOp::And ? _mm256_and_si256(x, y) : _mm256_or_si256(x, y);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), result);
+        }
+        ScalarKernels::maskLoop(op, a, aStride, b, bStride, out, n, i);
+    }
+
+    SPHYNX_TARGET_AVX2 static void maskNot(const uint8_t* a, uint8_t* out, size_t n) {
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_xor_si256(x, _mm256_set1_epi8(1)));
+        }
+        ScalarKernels::maskNotLoop(a, out, n, i);
+    }
+
+    static size_t compactInt(const long long* a, const uint8_t* mask, size_t n, long long* out) { return compactLoop(a, mask, n, out); }
+    static size_t compactFloat(const double* a, const uint8_t* mask, size_t n, double* out) { return compactLoop(a, mask, n, out); }
+
+private:
+    // For each 4-bit mask, the 32-bit lane indices that move the kept 64-bit elements to the front
+    struct CompactionTable {
+        uint32_t lanes[16][8];
+
+        CompactionTable() : lanes() {
+            for (int bits = 0; bits < 16; ++bits) {
+                int kept = 0;
+                for (int element = 0; element < 4; ++element) {
+                    if (bits & (1 << element)) {
+                        lanes[bits][2 * kept] = 2 * element;
+                        lanes[bits][2 * kept + 1] = 2 * element + 1;
+                        kept++;
+                    }
+                }
+            }
+        }
+    };
+
+    // Four elements at a time: shuffle the kept ones to the front, store all four, advance by the kept count
+    template <typename T>
+    SPHYNX_TARGET_AVX2 static size_t compactLoop(const T* a, const uint8_t* mask, size_t n, T* out) {
+        static_assert(sizeof(T) == 8, "compaction works on 64-bit elements");
+        static const CompactionTable table;
+        size_t kept = 0;
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            uint32_t bytes;
+            std::memcpy(&bytes, mask + i, sizeof(bytes));
+            uint32_t bits = (bytes & 1) | ((bytes >> 7) & 2) | ((bytes >> 14) & 4) | ((bytes >> 21) & 8);
+            __m256i shuffle = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(table.lanes[bits]));
+            __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + kept), _mm256_permutevar8x32_epi32(values, shuffle));
+            kept += mask[i] + mask[i + 1] + mask[i + 2] + mask[i + 3];
+        }
+        return ScalarKernels::compactLoop(a, mask, n, out, i, kept);
+    }
+
+    template <VectorOp Op>
+    SPHYNX_TARGET_AVX2 static void arithmeticLoop(const double* a, size_t aStride, const double* b, size_t bStride, double* out, size_t n) {
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            __m256d x = aStride ? _mm256_loadu_pd(a + i) : _mm256_set1_pd(*a);
+            __m256d y = bStride ? _mm256_loadu_pd(b + i) : _mm256_set1_pd(*b);
+            if constexpr (Op == VectorOp::Add) _mm256_storeu_pd(out + i, _mm256_add_pd(x, y));
+            else if constexpr (Op == VectorOp::Sub) _mm256_storeu_pd(out + i, _mm256_sub_pd(x, y));
+            else if constexpr (Op == VectorOp::Mul) _mm256_storeu_pd(out + i, _mm256_mul_pd(x, y));
+            else _mm256_storeu_pd(out + i, _mm256_div_pd(x, y));
+        }
+        ScalarKernels::arithmeticLoop<Op>(a, aStride, b, bStride, out, n, i);
+    }
+
+    template <VectorOp Op>
+    SPHYNX_TARGET_AVX2 static void intLoop(const long long* a, size_t aStride, const long long* b, size_t bStride, long long* out, size_t n) {
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            __m256i x = aStride ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)) : _mm256_set1_epi64x(*a);
+            __m256i y = bStride ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)) : _mm256_set1_epi64x(*b);
+            __m256i result = Op == VectorOp::Add ? _mm256_add_epi64(x, y) : _mm256_sub_epi64(x, y);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), result);
+        }
+        ScalarKernels::intLoop<Op>(a, aStride, b, bStride, out, n, i);
+    }
+
+    // Handles the whole groups of four; the caller does the tail
+    template <int Predicate>
+    SPHYNX_TARGET_AVX2 static void compareFloatLoop(const double* a, size_t aStride, const double* b, size_t bStride, uint8_t* out, size_t n) {
+        for (size_t i = 0; i + 4 <= n; i += 4) {
+            __m256d x = aStride ? _mm256_loadu_pd(a + i) : _mm256_set1_pd(*a);
+            __m256d y = bStride ? _mm256_loadu_pd(b + i) : _mm256_set1_pd(*b);
+            int bits = _mm256_movemask_pd(_mm256_cmp_pd(x, y, Predicate));
+            for (int k = 0; k < 4; ++k) out[i + k] = (bits >> k) & 1;
+        }
+    }
+};
+
+#endif
+
+/**
+ * @brief One set of kernels, as function pointers so the set can be chosen at runtime.
+ */
+struct VectorKernels {
+    const char* name;
+    double (*sumFloat)(const double*, size_t);
+    long long (*sumInt)(const long long*, size_t);
+    double (*minFloat)(const double*, size_t);
+    double (*maxFloat)(const double*, size_t);
+    long long (*minInt)(const long long*, size_t);
+    long long (*maxInt)(const long long*, size_t);
+    double (*dotFloat)(const double*, const double*, size_t);
+    long long (*dotInt)(const long long*, const long long*, size_t);
+    void (*arithmeticFloat)(VectorOp, const double*, size_t, const double*, size_t, double*, size_t);
+    void (*arithmeticInt)(VectorOp, const long long*, size_t, const long long*, size_t, long long*, size_t);
+    void (*compareFloat)(VectorCompare, const double*, size_t, const double*, size_t, uint8_t*, size_t);
+    void (*compareInt)(VectorCompare, const long long*, size_t, const long long*, size_t, uint8_t*, size_t);
+    size_t (*countTrue)(const uint8_t*, size_t);
+    void (*maskLogic)(MaskOp, const uint8_t*, size_t, const uint8_t*, size_t, uint8_t*, size_t);
+    void (*maskNot)(const uint8_t*, uint8_t*, size_t);
+    size_t (*compactInt)(const long long*, const uint8_t*, size_t, long long*);
+    size_t (*compactFloat)(const double*, const uint8_t*, size_t, double*);
+
+    // The widest set this CPU supports, chosen on first use
+    static const VectorKernels& best() {
+        static const VectorKernels& chosen = *available().back();
+        return chosen;
+    }
+
+    // Every set this CPU can run, narrowest first
+    static std::vector<const VectorKernels*> available() {
+        static const VectorKernels scalar = make<ScalarKernels>("scalar");
+        std::vector<const VectorKernels*> sets = { &scalar };
+#ifdef SPHYNX_HAS_X86_SIMD
+        static const VectorKernels sse2 = make<Sse2Kernels>("sse2");
+        static const VectorKernels avx2 = make<Avx2Kernels>("avx2");
+        sets.push_back(&sse2);
+        if (cpuHasAvx2()) {
+            sets.push_back(&avx2);
+        }
+#endif
+        return sets;
+    }
+
+private:
+    template <typename Impl>
+    static VectorKernels make(const char* name) {
+        return VectorKernels{ name, &Impl::sumFloat, &Impl::sumInt, &Impl::minFloat, &Impl::maxFloat, &Impl::minInt, &Impl::maxInt,
+                              &Impl::dotFloat, &Impl::dotInt, &Impl::arithmeticFloat, &Impl::arithmeticInt,
+                              &Impl::compareFloat, &Impl::compareInt, &Impl::countTrue, &Impl::maskLogic, &Impl::maskNot,
+                              &Impl::compactInt, &Impl::compactFloat };
+    }
+
+#ifdef SPHYNX_HAS_X86_SIMD
+    // Also checks that the OS saves the AVX registers
+    static bool cpuHasAvx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid(info, 1);
+        bool osSavesAvx = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+        __cpuidex(info, 7, 0);
+        return osSavesAvx && (info[1] & (1 << 5)) != 0;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif
+};